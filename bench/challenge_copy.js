@@ -0,0 +1,40 @@
+'use strict';
+
+// Measures the main thread cost of handing a base64 token to a worker, as `step`, `wrap` and
+// `unwrap` do with their challenge, for the sizes of typical Kerberos tokens: transcoding it with
+// `Nan::Utf8String` into a `std::string` captured by the worker closures, versus copying the
+// one-byte string once into a pooled buffer shared by the closures. Needs no KDC.
+//
+// usage: node bench/challenge_copy.js [iterations]
+// needs the addon built with `node-gyp rebuild -- -Dkerberos_bench=true`
+
+const crypto = require('crypto');
+const native = require('bindings')('kerberos');
+
+if (typeof native._benchmarkChallenge !== 'function') {
+  console.error('bench/challenge_copy.js needs the addon built with -Dkerberos_bench=true');
+  process.exit(1);
+}
+
+const iterations = parseInt(process.argv[2], 10) || 100000;
+const sizes = [1024, 2048, 4096, 8192, 12288];
+
+sizes.forEach(size => {
+  const token = crypto.randomBytes(size).toString('base64');
+
+  // warm up the pool and the allocator
+  native._benchmarkChallenge(token, 1000);
+  const result = native._benchmarkChallenge(token, iterations);
+  if (!result.consistent) throw new Error('the copies differ in length');
+
+  console.log(
+    JSON.stringify({
+      tokenBytes: size,
+      base64Bytes: token.length,
+      iterations,
+      utf8Ns: +result.utf8Ns.toFixed(1),
+      oneByteNs: +result.oneByteNs.toFixed(1),
+      speedup: +(result.utf8Ns / result.oneByteNs).toFixed(2)
+    })
+  );
+});
@@ -0,0 +1,90 @@
+'use strict';
+
+// Compares the V8 heap, RSS and GC cost of holding many contexts as `KerberosServer` objects
+// versus as handles in the native context table. Server contexts initialized without a service
+// name never contact a KDC, so this runs on any machine with the addon built.
+//
+// usage: node --expose-gc bench/context_handles.js [count]
+
+const kerberos = require('..');
+const PerformanceObserver = require('perf_hooks').PerformanceObserver;
+
+const count = parseInt(process.argv[2], 10) || 100000;
+const batchSize = 1000;
+
+let gcTime = 0;
+let gcCount = 0;
+const observer = new PerformanceObserver(list => {
+  list.getEntries().forEach(entry => {
+    gcTime += entry.duration;
+    gcCount++;
+  });
+});
+observer.observe({ entryTypes: ['gc'] });
+
+function snapshot() {
+  if (global.gc) global.gc();
+  const mem = process.memoryUsage();
+  return { heapUsed: mem.heapUsed, rss: mem.rss, gcTime, gcCount };
+}
+
+function diff(before, after) {
+  return {
+    heapUsedMB: ((after.heapUsed - before.heapUsed) / 1048576).toFixed(1),
+    rssMB: ((after.rss - before.rss) / 1048576).toFixed(1),
+    gcMs: (after.gcTime - before.gcTime).toFixed(1),
+    gcCount: after.gcCount - before.gcCount
+  };
+}
+
+function allocate(init, total) {
+  const results = [];
+  function batch(remaining) {
+    if (remaining === 0) return Promise.resolve(results);
+    const n = Math.min(batchSize, remaining);
+    const pending = [];
+    for (let i = 0; i < n; ++i) pending.push(init(''));
+    return Promise.all(pending).then(contexts => {
+      contexts.forEach(context => results.push(context));
+      return batch(remaining - n);
+    });
+  }
+
+  return batch(total);
+}
+
+function run(name, init, release) {
+  const before = snapshot();
+  const start = process.hrtime();
+  return allocate(init, count).then(contexts => {
+    const elapsed = process.hrtime(start);
+    const held = snapshot();
+    contexts.forEach(release);
+    contexts.length = 0;
+
+    const released = snapshot();
+    const seconds = elapsed[0] + elapsed[1] / 1e9;
+    console.log(
+      JSON.stringify({
+        name,
+        count,
+        opsPerSec: Math.round(count / seconds),
+        held: diff(before, held),
+        afterRelease: diff(before, released)
+      })
+    );
+  });
+}
+
+run('objects', kerberos.initializeServer, () => {})
+  .then(() =>
+    run('handles', kerberos.initializeServerHandle, handle => kerberos.releaseHandle(handle))
+  )
+  .then(() => {
+    console.log(JSON.stringify({ handleTable: kerberos.handleTableStats() }));
+    observer.disconnect();
+  })
+  .catch(err => {
+    console.error(err);
+    process.exit(1);
+  });
@@ -0,0 +1,34 @@
+'use strict';
+
+// Runs the native GSS core benchmark (`bench/native/kerberos_gss_bench.cc`) against a throwaway
+// local realm, see `realm.js`. Build it first with `node-gyp rebuild -- -Dkerberos_bench=true`.
+//
+// usage: node bench/kdc/native.js [iterations]
+
+const childProcess = require('child_process');
+const fs = require('fs');
+const path = require('path');
+const realm = require('./realm');
+
+const binary = path.join(__dirname, '..', '..', 'build', 'Release', 'kerberos_bench');
+if (!fs.existsSync(binary)) {
+  console.error(`${binary} not found, build it with \`node-gyp rebuild -- -Dkerberos_bench=true\``);
+  process.exit(1);
+}
+
+const iterations = process.argv[2] || '1000';
+realm
+  .start()
+  .then(env => {
+    const result = childProcess.spawnSync(binary, [env.service, iterations], {
+      env: process.env,
+      stdio: 'inherit'
+    });
+
+    env.stop();
+    process.exit(result.status);
+  })
+  .catch(err => {
+    console.error(err);
+    process.exit(1);
+  });
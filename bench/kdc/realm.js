@@ -0,0 +1,183 @@
+'use strict';
+
+// Bootstraps a throwaway MIT Kerberos realm in a temporary directory: a KDC listening on
+// loopback, a user principal with a password, an `HTTP/localhost` service principal in a keytab,
+// and a krb5.conf pointing at all of it. The process environment is updated so that the addon
+// (and any child process) uses this realm instead of the system configuration.
+//
+// Requires the MIT KDC tools (`krb5kdc`, `kdb5_util`, `kadmin.local`, `kinit`), e.g. from the
+// `krb5-kdc`, `krb5-admin-server` and `krb5-user` packages on Debian/Ubuntu or `krb5` on
+// Homebrew. Set `KRB5_SBIN` if they are installed outside of the usual locations.
+
+const childProcess = require('child_process');
+const fs = require('fs');
+const net = require('net');
+const os = require('os');
+const path = require('path');
+
+const REALM = 'BENCH.LOCAL';
+const HOSTNAME = 'localhost';
+const USERNAME = 'bench';
+const PASSWORD = 'bench-password';
+const SEARCH_PATH = [
+  '/usr/sbin',
+  '/usr/local/sbin',
+  '/usr/local/opt/krb5/sbin',
+  '/usr/local/opt/krb5/bin',
+  '/opt/homebrew/opt/krb5/sbin',
+  '/opt/homebrew/opt/krb5/bin'
+];
+
+function findTool(name) {
+  const dirs = (process.env.KRB5_SBIN ? [process.env.KRB5_SBIN] : [])
+    .concat(SEARCH_PATH)
+    .concat((process.env.PATH || '').split(path.delimiter));
+  for (const dir of dirs) {
+    const candidate = path.join(dir, name);
+    if (fs.existsSync(candidate)) return candidate;
+  }
+
+  throw new Error(
+    `Unable to find \`${name}\`, install the MIT Kerberos KDC tools or set KRB5_SBIN`
+  );
+}
+
+function freePort() {
+  return new Promise((resolve, reject) => {
+    const server = net.createServer();
+    server.unref();
+    server.on('error', reject);
+    server.listen(0, '127.0.0.1', () => {
+      const port = server.address().port;
+      server.close(() => resolve(port));
+    });
+  });
+}
+
+function waitForPort(port, timeoutMs) {
+  const deadline = Date.now() + timeoutMs;
+  return new Promise((resolve, reject) => {
+    function attempt() {
+      const socket = net.connect(port, '127.0.0.1');
+      socket.once('connect', () => {
+        socket.destroy();
+        resolve();
+      });
+      socket.once('error', err => {
+        socket.destroy();
+        if (Date.now() > deadline) return reject(err);
+        setTimeout(attempt, 50);
+      });
+    }
+
+    attempt();
+  });
+}
+
+function run(env, tool, args, input) {
+  const result = childProcess.spawnSync(findTool(tool), args, { env, input, encoding: 'utf8' });
+  if (result.status !== 0) {
+    throw new Error(`\`${tool} ${args.join(' ')}\` failed: ${result.stderr || result.error}`);
+  }
+
+  return result.stdout;
+}
+
+/**
+ * Creates the realm and starts its KDC.
+ *
+ * @return {Promise<object>} the realm, with a `stop()` method which kills the KDC and removes
+ *   the temporary directory
+ */
+function start() {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'kerberos-bench-'));
+  const file = name => path.join(dir, name);
+
+  return freePort().then(port => {
+    fs.writeFileSync(
+      file('krb5.conf'),
+      [
+        '[libdefaults]',
+        `    default_realm = ${REALM}`,
+        '    dns_lookup_realm = false',
+        '    dns_lookup_kdc = false',
+        '    dns_canonicalize_hostname = false',
+        '    rdns = false',
+        '[realms]',
+        `    ${REALM} = {`,
+        `        kdc = 127.0.0.1:${port}`,
+        '    }',
+        '[domain_realm]',
+        `    ${HOSTNAME} = ${REALM}`,
+        ''
+      ].join('\n')
+    );
+
+    fs.writeFileSync(
+      file('kdc.conf'),
+      [
+        '[kdcdefaults]',
+        `    kdc_ports = ${port}`,
+        `    kdc_tcp_ports = ${port}`,
+        '[realms]',
+        `    ${REALM} = {`,
+        `        database_name = ${file('principal')}`,
+        `        key_stash_file = ${file('stash')}`,
+        '    }',
+        '[logging]',
+        `    kdc = FILE:${file('kdc.log')}`,
+        ''
+      ].join('\n')
+    );
+
+    const env = Object.assign({}, process.env, {
+      KRB5_CONFIG: file('krb5.conf'),
+      KRB5_KDC_PROFILE: file('kdc.conf'),
+      KRB5_KTNAME: `FILE:${file('service.keytab')}`,
+      KRB5CCNAME: `FILE:${file('ccache')}`
+    });
+
+    const service = `HTTP/${HOSTNAME}@${REALM}`;
+    const principal = `${USERNAME}@${REALM}`;
+    run(env, 'kdb5_util', ['create', '-s', '-r', REALM, '-P', 'master-password']);
+    run(env, 'kadmin.local', ['-r', REALM, '-q', `addprinc -pw ${PASSWORD} ${principal}`]);
+    run(env, 'kadmin.local', ['-r', REALM, '-q', `addprinc -randkey ${service}`]);
+    run(env, 'kadmin.local', ['-r', REALM, '-q', `ktadd -k ${file('service.keytab')} ${service}`]);
+
+    const kdc = childProcess.spawn(findTool('krb5kdc'), ['-n', '-r', REALM], {
+      env,
+      stdio: 'ignore'
+    });
+
+    function stop() {
+      kdc.kill();
+      fs.rmSync(dir, { recursive: true, force: true });
+    }
+
+    return waitForPort(port, 10000)
+      .then(() => {
+        run(env, 'kinit', [principal], `${PASSWORD}\n`);
+        ['KRB5_CONFIG', 'KRB5_KTNAME', 'KRB5CCNAME'].forEach(name => {
+          process.env[name] = env[name];
+        });
+
+        return {
+          dir,
+          port,
+          realm: REALM,
+          hostname: HOSTNAME,
+          username: USERNAME,
+          password: PASSWORD,
+          principal,
+          service: `HTTP@${HOSTNAME}`,
+          stop
+        };
+      })
+      .catch(err => {
+        stop();
+        throw err;
+      });
+  });
+}
+
+module.exports = { start };
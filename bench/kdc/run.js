@@ -0,0 +1,187 @@
+'use strict';
+
+// Measures full handshake throughput and latency against a throwaway local realm, see
+// `realm.js`. Each operation is driven by `concurrency` independent loops for `duration`
+// seconds, and reported as ops/sec and latency percentiles.
+//
+// usage: node bench/kdc/run.js [--ops handshake,wrap,checkPassword,principalDetails]
+//                              [--concurrency 1,8,32] [--duration 5] [--json results.json]
+//
+// `unwrap` is not measured: the API has no acceptor-side wrap to produce tokens for it, so it
+// can only be driven by a real SASL peer.
+
+const fs = require('fs');
+const os = require('os');
+const realm = require('./realm');
+
+function parseArgs(argv) {
+  const args = {
+    ops: ['handshake', 'wrap', 'checkPassword', 'principalDetails'],
+    concurrency: [1, 8, 32],
+    duration: 5,
+    json: null
+  };
+
+  for (let i = 0; i < argv.length; i += 2) {
+    const value = argv[i + 1];
+    switch (argv[i]) {
+      case '--ops':
+        args.ops = value.split(',');
+        break;
+      case '--concurrency':
+        args.concurrency = value.split(',').map(n => parseInt(n, 10));
+        break;
+      case '--duration':
+        args.duration = parseFloat(value);
+        break;
+      case '--json':
+        args.json = value;
+        break;
+      default:
+        throw new Error(`Unknown option \`${argv[i]}\``);
+    }
+  }
+
+  return args;
+}
+
+function elapsedMs(start) {
+  const elapsed = process.hrtime(start);
+  return elapsed[0] * 1e3 + elapsed[1] / 1e6;
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) return 0;
+  const rank = Math.ceil((p / 100) * sorted.length);
+  return sorted[Math.min(sorted.length - 1, Math.max(0, rank - 1))];
+}
+
+// Each operation returns a function performing one iteration, after any per-loop setup
+function operations(kerberos, env) {
+  function handshake() {
+    return Promise.all([
+      kerberos.initializeClient(env.service, { mechOID: kerberos.GSS_MECH_OID_KRB5 }),
+      kerberos.initializeServer(env.service)
+    ]).then(contexts => {
+      const client = contexts[0];
+      const server = contexts[1];
+      return client
+        .step('')
+        .then(token => server.step(token))
+        .then(() => client.step(server.response))
+        .then(() => {
+          if (!client.contextComplete || !server.contextComplete) {
+            throw new Error('handshake did not complete');
+          }
+
+          return client;
+        });
+    });
+  }
+
+  return {
+    handshake: () => Promise.resolve(handshake),
+    wrap: () =>
+      handshake().then(client => {
+        const payload = Buffer.alloc(256, 'a').toString('base64');
+        return () => client.wrap(payload, {});
+      }),
+    checkPassword: () =>
+      Promise.resolve(() =>
+        kerberos.checkPassword(env.username, env.password, `HTTP/${env.hostname}`, env.realm)
+      ),
+    principalDetails: () => Promise.resolve(() => kerberos.principalDetails('HTTP', env.hostname))
+  };
+}
+
+function measure(setup, concurrency, durationMs) {
+  const latencies = [];
+  let errors = 0;
+  let firstError = null;
+  const start = process.hrtime();
+
+  function loop(iteration) {
+    if (elapsedMs(start) >= durationMs) return Promise.resolve();
+    const began = process.hrtime();
+    return iteration()
+      .then(
+        () => latencies.push(elapsedMs(began)),
+        err => {
+          errors++;
+          firstError = firstError || err;
+        }
+      )
+      .then(() => loop(iteration));
+  }
+
+  const loops = [];
+  for (let i = 0; i < concurrency; ++i) loops.push(setup().then(loop));
+  return Promise.all(loops).then(() => {
+    const seconds = elapsedMs(start) / 1e3;
+    latencies.sort((a, b) => a - b);
+    const mean = latencies.reduce((sum, value) => sum + value, 0) / (latencies.length || 1);
+    return {
+      ops: latencies.length,
+      errors,
+      firstError: firstError ? firstError.message : undefined,
+      opsPerSec: Math.round(latencies.length / seconds),
+      meanMs: +mean.toFixed(3),
+      p50Ms: +percentile(latencies, 50).toFixed(3),
+      p99Ms: +percentile(latencies, 99).toFixed(3),
+      maxMs: +percentile(latencies, 100).toFixed(3)
+    };
+  });
+}
+
+function main() {
+  const args = parseArgs(process.argv.slice(2));
+  return realm.start().then(env => {
+    // the addon must only be loaded once the realm's environment is in place
+    const kerberos = require('../..');
+    const ops = operations(kerberos, env);
+    const results = [];
+
+    const runs = [];
+    args.ops.forEach(op => {
+      if (!ops[op]) throw new Error(`Unknown operation \`${op}\``);
+      args.concurrency.forEach(concurrency => runs.push({ op, concurrency }));
+    });
+
+    return runs
+      .reduce(
+        (previous, run) =>
+          previous.then(() =>
+            measure(ops[run.op], run.concurrency, args.duration * 1000).then(result => {
+              const entry = Object.assign({ op: run.op, concurrency: run.concurrency }, result);
+              results.push(entry);
+              console.log(JSON.stringify(entry));
+            })
+          ),
+        Promise.resolve()
+      )
+      .then(() => {
+        if (args.json) {
+          const report = {
+            timestamp: new Date().toISOString(),
+            node: process.version,
+            platform: `${os.platform()}-${os.arch()}`,
+            cpus: os.cpus().length,
+            threadpoolSize: kerberos.stats().threadpool.size,
+            duration: args.duration,
+            results
+          };
+
+          fs.writeFileSync(args.json, JSON.stringify(report, null, 2) + '\n');
+        }
+      })
+      .then(env.stop, err => {
+        env.stop();
+        throw err;
+      });
+  });
+}
+
+main().catch(err => {
+  console.error(err);
+  process.exit(1);
+});
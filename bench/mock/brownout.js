@@ -0,0 +1,96 @@
+'use strict';
+
+// Replays a KDC brownout against the mock GSSAPI backend: handshakes are driven by
+// `concurrency` loops while the latency of ticket requests goes from healthy, to a slow and
+// failing KDC, and back. Each phase reports throughput, latency percentiles and how deep the
+// libuv threadpool queue got, and is reproducible for a given seed.
+//
+// Build with `node-gyp rebuild -- -Dkerberos_gss_mock=true` first (Linux only).
+//
+// usage: node bench/mock/brownout.js [concurrency] [phase seconds] [seed]
+
+const native = require('bindings')('kerberos');
+const kerberos = require('../..');
+
+if (typeof native._configureMock !== 'function') {
+  console.error('the addon was not built with `-Dkerberos_gss_mock=true`');
+  process.exit(1);
+}
+
+const concurrency = parseInt(process.argv[2] || '32', 10);
+const phaseMs = parseFloat(process.argv[3] || '5') * 1000;
+const seed = parseInt(process.argv[4] || '1', 10);
+
+const PHASES = [
+  { name: 'healthy', kdc: { distribution: 'exponential', latency: 2 } },
+  { name: 'brownout', kdc: { distribution: 'lognormal', latency: 150, spread: 1, errorRate: 0.05 } },
+  { name: 'recovered', kdc: { distribution: 'exponential', latency: 2 } }
+];
+
+function elapsedMs(start) {
+  const elapsed = process.hrtime(start);
+  return elapsed[0] * 1e3 + elapsed[1] / 1e6;
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.ceil((p / 100) * sorted.length) - 1)];
+}
+
+function handshake() {
+  return Promise.all([
+    kerberos.initializeClient('HTTP@localhost'),
+    kerberos.initializeServer('HTTP@localhost')
+  ]).then(contexts =>
+    contexts[0]
+      .step('')
+      .then(token => contexts[1].step(token))
+      .then(() => contexts[0].step(contexts[1].response))
+  );
+}
+
+function runPhase(phase) {
+  native._configureMock({
+    seed,
+    calls: {
+      initSecContext: phase.kdc,
+      acceptSecContext: { distribution: 'exponential', latency: 0.2 }
+    }
+  });
+  kerberos.resetStats();
+
+  const latencies = [];
+  let errors = 0;
+  const start = process.hrtime();
+  function loop() {
+    if (elapsedMs(start) >= phaseMs) return Promise.resolve();
+    const began = process.hrtime();
+    return handshake()
+      .then(() => latencies.push(elapsedMs(began)), () => errors++)
+      .then(loop);
+  }
+
+  const loops = [];
+  for (let i = 0; i < concurrency; ++i) loops.push(loop());
+  return Promise.all(loops).then(() => {
+    latencies.sort((a, b) => a - b);
+    const result = {
+      phase: phase.name,
+      ops: latencies.length,
+      errors,
+      opsPerSec: Math.round(latencies.length / (elapsedMs(start) / 1e3)),
+      p50Ms: +percentile(latencies, 50).toFixed(3),
+      p99Ms: +percentile(latencies, 99).toFixed(3),
+      maxQueued: kerberos.stats().threadpool.maxQueued
+    };
+
+    console.log(JSON.stringify(result));
+  });
+}
+
+PHASES.reduce((previous, phase) => previous.then(() => runPhase(phase)), Promise.resolve())
+  .then(() => native._configureMock({}))
+  .catch(err => {
+    console.error(err);
+    process.exit(1);
+  });
@@ -0,0 +1,92 @@
+'use strict';
+
+// Compares the base64 string results of `wrap` and `unwrap` with their `binary` Buffer results.
+// Both carry plaintext, so each binary result gets a Buffer of its own. Each message is an unwrap of a `size` byte payload and a
+// wrap of the reply, driven by `concurrency` contexts. Every mode runs in a fresh process so that
+// their peak RSS can be compared; the mock GSSAPI backend keeps the cost of GSS itself out of it.
+//
+// Build with `node-gyp rebuild -- -Dkerberos_gss_mock=true` first (Linux only).
+//
+// usage: node bench/mock/wrap_output.js [messages] [size] [concurrency]
+
+const childProcess = require('child_process');
+const native = require('bindings')('kerberos');
+const kerberos = require('../..');
+
+if (typeof native._configureMock !== 'function') {
+  console.error('the addon was not built with `-Dkerberos_gss_mock=true`');
+  process.exit(1);
+}
+
+const messages = parseInt(process.argv[2] || '1000000', 10);
+const size = parseInt(process.argv[3] || '512', 10);
+const concurrency = parseInt(process.argv[4] || '16', 10);
+const mode = process.argv[5];
+
+function handshake() {
+  return Promise.all([
+    kerberos.initializeClient('HTTP@localhost'),
+    kerberos.initializeServer('HTTP@localhost')
+  ]).then(contexts =>
+    contexts[0]
+      .step('')
+      .then(token => contexts[1].step(token))
+      .then(() => contexts[0].step(contexts[1].response))
+      .then(() => contexts[0])
+  );
+}
+
+function run(binary) {
+  // what the mock's `gss_wrap` would have produced for the payload
+  const token = Buffer.concat([Buffer.from('mock-wrap0'), Buffer.alloc(size, 'x')]).toString(
+    'base64'
+  );
+  const reply = Buffer.from([1, 0, 0x10, 0]).toString('base64');
+  const options = { binary };
+  const wrapOptions = { user: 'user', binary };
+
+  let remaining = messages;
+  let peakRss = 0;
+  const sampler = setInterval(() => {
+    peakRss = Math.max(peakRss, process.memoryUsage().rss);
+  }, 100);
+
+  function loop(client) {
+    if (remaining <= 0) return Promise.resolve();
+    remaining--;
+    return client
+      .unwrap(token, options)
+      .then(() => client.wrap(reply, wrapOptions))
+      .then(() => loop(client));
+  }
+
+  const contexts = [];
+  for (let i = 0; i < concurrency; ++i) contexts.push(handshake());
+  return Promise.all(contexts).then(clients => {
+    const start = process.hrtime();
+    return Promise.all(clients.map(loop)).then(() => {
+      const elapsed = process.hrtime(start);
+      clearInterval(sampler);
+      const seconds = elapsed[0] + elapsed[1] / 1e9;
+      const usage = process.memoryUsage();
+      return {
+        mode: binary ? 'binary' : 'base64',
+        messages,
+        payloadBytes: size,
+        messagesPerSec: Math.round(messages / seconds),
+        peakRssMB: +(Math.max(peakRss, usage.rss) / 1048576).toFixed(1),
+        heapUsedMB: +(usage.heapUsed / 1048576).toFixed(1),
+        arenaAllocations: kerberos.memoryUsage().arenaAllocations
+      };
+    });
+  });
+}
+
+if (mode != null) {
+  run(mode === 'binary').then(result => console.log(JSON.stringify(result)));
+} else {
+  ['base64', 'binary'].forEach(name => {
+    const args = [__filename, messages, size, concurrency, name];
+    childProcess.execFileSync(process.execPath, args, { stdio: 'inherit' });
+  });
+}
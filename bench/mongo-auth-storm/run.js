@@ -0,0 +1,278 @@
+'use strict';
+
+// Simulates a reconnect storm: `clients` MongoAuthProcess conversations are started at once
+// against the stand-in server in `server.js`, each over its own connection, and the storm is
+// repeated for `rounds`. Each round reports the time-to-authenticated distribution, how deep
+// the libuv threadpool queue got, and how many requests reached the KDC.
+//
+// With an addon built with `-Dkerberos_gss_mock=true` the KDC is simulated with the given
+// latency (exponentially distributed) and error rate, and requests are counted by the mock.
+// Otherwise a throwaway realm is started with `../kdc/realm.js` and requests are counted from
+// its KDC log.
+//
+// usage: node bench/mongo-auth-storm/run.js [--clients 200] [--rounds 3] [--backend mock|kdc]
+//                                          [--kdc-latency 5] [--kdc-error-rate 0] [--seed 1]
+//                                          [--json results.json]
+
+const fs = require('fs');
+const net = require('net');
+const os = require('os');
+const path = require('path');
+const native = require('bindings')('kerberos');
+const standIn = require('./server');
+
+const SERVICE_NAME = 'HTTP';
+const HOSTNAME = 'localhost';
+
+function parseArgs(argv) {
+  const args = {
+    clients: 200,
+    rounds: 3,
+    backend: typeof native._configureMock === 'function' ? 'mock' : 'kdc',
+    kdcLatency: 5,
+    kdcErrorRate: 0,
+    seed: 1,
+    json: null
+  };
+
+  const numbers = {
+    '--clients': 'clients',
+    '--rounds': 'rounds',
+    '--kdc-latency': 'kdcLatency',
+    '--kdc-error-rate': 'kdcErrorRate',
+    '--seed': 'seed'
+  };
+
+  for (let i = 0; i < argv.length; i += 2) {
+    const value = argv[i + 1];
+    if (numbers[argv[i]]) {
+      args[numbers[argv[i]]] = parseFloat(value);
+    } else if (argv[i] === '--backend') {
+      args.backend = value;
+    } else if (argv[i] === '--json') {
+      args.json = value;
+    } else {
+      throw new Error(`Unknown option \`${argv[i]}\``);
+    }
+  }
+
+  if (args.backend === 'mock' && typeof native._configureMock !== 'function') {
+    throw new Error('the mock backend needs an addon built with `-Dkerberos_gss_mock=true`');
+  }
+
+  return args;
+}
+
+function elapsedMs(start) {
+  const elapsed = process.hrtime(start);
+  return elapsed[0] * 1e3 + elapsed[1] / 1e6;
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.ceil((p / 100) * sorted.length) - 1)];
+}
+
+// A connection to the stand-in server, with one outstanding command at a time
+function connect(port) {
+  return new Promise((resolve, reject) => {
+    const socket = net.connect(port, '127.0.0.1', () => {
+      let buffered = '';
+      let pending = null;
+      socket.setNoDelay(true);
+      socket.setEncoding('utf8');
+      socket.on('data', chunk => {
+        buffered += chunk;
+        const newline = buffered.indexOf('\n');
+        if (newline !== -1 && pending) {
+          const reply = JSON.parse(buffered.slice(0, newline));
+          buffered = buffered.slice(newline + 1);
+          const callback = pending;
+          pending = null;
+          if (reply.ok) callback(null, reply);
+          else callback(new Error(reply.errmsg));
+        }
+      });
+
+      resolve({
+        command: message =>
+          new Promise((resolve, reject) => {
+            pending = (err, reply) => (err ? reject(err) : resolve(reply));
+            socket.write(JSON.stringify(message) + '\n');
+          }),
+        close: () => socket.destroy()
+      });
+    });
+    socket.once('error', reject);
+  });
+}
+
+// Runs the conversation the way the driver does: saslStart, then saslContinue until done
+function authenticate(kerberos, port, username) {
+  const auth = new kerberos.processes.MongoAuthProcess(HOSTNAME, port, SERVICE_NAME);
+  const transition = payload =>
+    new Promise((resolve, reject) =>
+      auth.transition(payload, (err, result) => (err ? reject(err) : resolve(result)))
+    );
+
+  return connect(port).then(connection => {
+    function converse(reply) {
+      if (reply.done) return reply;
+      return transition(reply.payload)
+        .then(payload => connection.command({ saslContinue: true, payload }))
+        .then(converse);
+    }
+
+    return new Promise((resolve, reject) =>
+      auth.init(username, null, err => (err ? reject(err) : resolve()))
+    )
+      .then(() => transition(''))
+      .then(payload => connection.command({ saslStart: true, payload }))
+      .then(converse)
+      .then(
+        reply => {
+          connection.close();
+          return reply;
+        },
+        err => {
+          connection.close();
+          throw err;
+        }
+      );
+  });
+}
+
+function kdcRequestCounter(args, env) {
+  if (args.backend === 'mock') {
+    return () => {
+      const calls = native._mockCalls();
+      return calls.initSecContext + calls.getInitCredsPassword;
+    };
+  }
+
+  const log = path.join(env.dir, 'kdc.log');
+  return () => {
+    if (!fs.existsSync(log)) return 0;
+    return fs
+      .readFileSync(log, 'utf8')
+      .split('\n')
+      .filter(line => /\b(AS|TGS)_REQ\b/.test(line)).length;
+  };
+}
+
+function storm(kerberos, args, port, username, kdcRequests) {
+  if (args.backend === 'mock') {
+    native._configureMock({
+      seed: args.seed,
+      calls: {
+        initSecContext: {
+          distribution: 'exponential',
+          latency: args.kdcLatency,
+          errorRate: args.kdcErrorRate
+        }
+      }
+    });
+  }
+
+  kerberos.resetStats();
+  const requestsBefore = kdcRequests();
+  const times = [];
+  let errors = 0;
+  let firstError = null;
+  const start = process.hrtime();
+
+  const conversations = [];
+  for (let i = 0; i < args.clients; ++i) {
+    conversations.push(
+      authenticate(kerberos, port, username).then(
+        () => times.push(elapsedMs(start)),
+        err => {
+          errors++;
+          firstError = firstError || err;
+        }
+      )
+    );
+  }
+
+  return Promise.all(conversations).then(() => {
+    const stormMs = elapsedMs(start);
+    const stats = kerberos.stats();
+    const clientStep = stats.operations['kerberos:ClientStep'];
+    times.sort((a, b) => a - b);
+    return {
+      clients: args.clients,
+      authenticated: times.length,
+      errors,
+      firstError: firstError ? firstError.message : undefined,
+      stormMs: +stormMs.toFixed(3),
+      ttaP50Ms: +percentile(times, 50).toFixed(3),
+      ttaP99Ms: +percentile(times, 99).toFixed(3),
+      ttaMaxMs: +percentile(times, 100).toFixed(3),
+      maxQueued: stats.threadpool.maxQueued,
+      clientStepQueueP99Ms: clientStep && clientStep.queue ? +clientStep.queue.p99.toFixed(3) : 0,
+      kdcRequests: kdcRequests() - requestsBefore
+    };
+  });
+}
+
+function main() {
+  const args = parseArgs(process.argv.slice(2));
+  const setup =
+    args.backend === 'mock'
+      ? Promise.resolve({ username: 'user', stop: () => {} })
+      : require('../kdc/realm').start();
+
+  return setup.then(env => {
+    const kerberos = require('../..');
+    const kdcRequests = kdcRequestCounter(args, env);
+    const results = [];
+
+    return standIn
+      .start({ service: `${SERVICE_NAME}@${HOSTNAME}`, securityLayer: args.backend === 'mock' })
+      .then(server => {
+        const port = server.address().port;
+        let rounds = Promise.resolve();
+        for (let round = 1; round <= args.rounds; ++round) {
+          rounds = rounds
+            .then(() => storm(kerberos, args, port, env.username, kdcRequests))
+            .then(result => {
+              const entry = Object.assign({ round, backend: args.backend }, result);
+              results.push(entry);
+              console.log(JSON.stringify(entry));
+            });
+        }
+
+        return rounds.then(
+          () => server.close(),
+          err => {
+            server.close();
+            throw err;
+          }
+        );
+      })
+      .then(() => {
+        if (args.json) {
+          const report = {
+            timestamp: new Date().toISOString(),
+            node: process.version,
+            platform: `${os.platform()}-${os.arch()}`,
+            cpus: os.cpus().length,
+            threadpoolSize: kerberos.stats().threadpool.size,
+            args,
+            results
+          };
+
+          fs.writeFileSync(args.json, JSON.stringify(report, null, 2) + '\n');
+        }
+      })
+      .then(env.stop, err => {
+        env.stop();
+        throw err;
+      });
+  });
+}
+
+main().catch(err => {
+  console.error(err);
+  process.exit(1);
+});
@@ -0,0 +1,88 @@
+'use strict';
+
+// A stand-in for the GSSAPI SASL conversation of a MongoDB server, accepting contexts with
+// `KerberosServer`. Each connection carries one conversation of newline delimited JSON
+// messages: `{ saslStart: true, payload }` followed by `{ saslContinue: true, payload }` until
+// the reply has `done: true`, so every simulated pool connection pays for its own TCP connect
+// and round trips as it would against a real server.
+//
+// The acceptor cannot wrap messages, so the security layer offer which is answered by the last
+// `saslStep` of `MongoAuthProcess` can only be produced with the mock GSSAPI backend,
+// whose tokens are plain text. Against a real KDC the conversation ends once the context is
+// established.
+
+const net = require('net');
+const kerberos = require('../..');
+
+// `mock-wrap` with no confidentiality: no security layer, a 4096 byte maximum message size
+const MOCK_SECURITY_LAYER_OFFER = Buffer.concat([
+  Buffer.from('mock-wrap0'),
+  Buffer.from([1, 0, 0x10, 0])
+]).toString('base64');
+
+function handleConnection(socket, options) {
+  let buffered = '';
+  let server = null;
+  let step = 0;
+
+  function reply(message) {
+    socket.write(JSON.stringify(message) + '\n');
+  }
+
+  function fail(err) {
+    reply({ ok: 0, errmsg: err.message });
+    socket.end();
+  }
+
+  function handle(message) {
+    step++;
+    if (message.saslStart) {
+      return kerberos
+        .initializeServer(options.service)
+        .then(created => {
+          server = created;
+          return server.step(message.payload);
+        })
+        .then(() => reply({ ok: 1, payload: server.response || '', done: false }));
+    }
+
+    if (step === 2 && options.securityLayer) {
+      return Promise.resolve(reply({ ok: 1, payload: MOCK_SECURITY_LAYER_OFFER, done: false }));
+    }
+
+    return Promise.resolve(reply({ ok: 1, payload: '', done: true, user: server.username }));
+  }
+
+  socket.setEncoding('utf8');
+  socket.on('data', chunk => {
+    buffered += chunk;
+    let newline;
+    while ((newline = buffered.indexOf('\n')) !== -1) {
+      const line = buffered.slice(0, newline);
+      buffered = buffered.slice(newline + 1);
+      handle(JSON.parse(line)).catch(fail);
+    }
+  });
+  socket.on('error', () => {});
+}
+
+/**
+ * Starts the stand-in server on a free loopback port.
+ *
+ * @param {object} options
+ * @param {string} options.service the acceptor service name, e.g. `HTTP@localhost`
+ * @param {boolean} options.securityLayer whether to offer a (mock) security layer
+ * @return {Promise<net.Server>}
+ */
+function start(options) {
+  return new Promise((resolve, reject) => {
+    const server = net.createServer(socket => {
+      socket.setNoDelay(true);
+      handleConnection(socket, options);
+    });
+    server.on('error', reject);
+    server.listen(0, '127.0.0.1', () => resolve(server));
+  });
+}
+
+module.exports = { start };
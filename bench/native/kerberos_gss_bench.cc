@@ -0,0 +1,200 @@
+// Times the GSS core directly, without V8 or libuv, so that regressions in `src/unix` can be
+// told apart from binding overhead. Expects a realm where the default credential cache holds a
+// ticket for the client and the default keytab holds the key for `service`, e.g. the one set up
+// by `bench/kdc/native.js`.
+//
+// usage: kerberos_bench <service> [iterations]   e.g. kerberos_bench HTTP@localhost 1000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "../../src/kerberos_stats.h"
+#include "../../src/unix/base64.h"
+#include "../../src/unix/kerberos_gss.h"
+
+struct Benchmark {
+    const char* name;
+    KerberosHistogram histogram;
+};
+
+static Benchmark benchmarks[] = {{"base64_encode", {}},
+                                 {"base64_decode", {}},
+                                 {"client_init", {}},
+                                 {"server_init", {}},
+                                 {"client_step", {}},
+                                 {"server_step", {}},
+                                 {"client_step_mutual", {}},
+                                 {"client_wrap", {}},
+                                 {"client_unwrap", {}}};
+
+enum {
+    BASE64_ENCODE,
+    BASE64_DECODE,
+    CLIENT_INIT,
+    SERVER_INIT,
+    CLIENT_STEP,
+    SERVER_STEP,
+    CLIENT_STEP_MUTUAL,
+    CLIENT_WRAP,
+    CLIENT_UNWRAP,
+    BENCHMARKS
+};
+
+class Timer {
+   public:
+    explicit Timer(int benchmark) : _benchmark(benchmark), _start(KerberosMonotonicNanos()) {}
+    ~Timer() {
+        benchmarks[_benchmark].histogram.Record(KerberosMonotonicNanos() - _start);
+    }
+
+   private:
+    int _benchmark;
+    uint64_t _start;
+};
+
+// Exits with the error if `result` is a failure, otherwise frees it when `owned`. The results of
+// step, unwrap and wrap belong to their state.
+static void check(const char* what, gss_result* result, bool owned = false) {
+    if (result->code == AUTH_GSS_ERROR) {
+        std::string message = (result->message != NULL)
+                                  ? std::string(result->message)
+                                  : gss_status_message(result->major_status, result->minor_status);
+        fprintf(stderr, "%s failed: %s\n", what, message.c_str());
+        exit(1);
+    }
+
+    if (owned) {
+        gss_result_free(result);
+    }
+}
+
+static void bench_base64(int iterations) {
+    std::vector<unsigned char> data(4096);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (unsigned char)i;
+    }
+
+    for (int i = 0; i < iterations; ++i) {
+        char* encoded;
+        {
+            Timer timer(BASE64_ENCODE);
+            encoded = base64_encode(data.data(), data.size());
+        }
+
+        size_t length;
+        unsigned char* decoded;
+        {
+            Timer timer(BASE64_DECODE);
+            decoded = base64_decode(encoded, &length);
+        }
+
+        free(encoded);
+        free(decoded);
+    }
+}
+
+// Wraps `payload` with the acceptor's context, producing a token for the initiator to unwrap
+static char* server_wrap(gss_server_state* server, const char* payload) {
+    OM_uint32 min_stat;
+    gss_buffer_desc input = {strlen(payload), (void*)payload};
+    gss_buffer_desc output = GSS_C_EMPTY_BUFFER;
+    OM_uint32 maj_stat =
+        gss_wrap(&min_stat, server->context, 0, GSS_C_QOP_DEFAULT, &input, NULL, &output);
+    if (GSS_ERROR(maj_stat)) {
+        fprintf(stderr, "gss_wrap failed: %s\n", gss_status_message(maj_stat, min_stat).c_str());
+        exit(1);
+    }
+
+    char* token = base64_encode((const unsigned char*)output.value, output.length);
+    gss_release_buffer(&min_stat, &output);
+    return token;
+}
+
+static void bench_handshake(const char* service, int iterations) {
+    std::string payload(256, 'a');
+    char* wrap_input = base64_encode((const unsigned char*)payload.data(), payload.size());
+
+    for (int i = 0; i < iterations; ++i) {
+        gss_client_state* client = gss_client_state_new();
+        gss_server_state* server = gss_server_state_new();
+        {
+            Timer timer(CLIENT_INIT);
+            check("client init",
+                  authenticate_gss_client_init(service,
+                                               NULL,
+                                               NULL,
+                                               GSS_C_MUTUAL_FLAG | GSS_C_SEQUENCE_FLAG,
+                                               NULL,
+                                               GSS_C_NO_OID,
+                                               client),
+                  true);
+        }
+        {
+            Timer timer(SERVER_INIT);
+            check("server init", authenticate_gss_server_init(service, server), true);
+        }
+        {
+            Timer timer(CLIENT_STEP);
+            check("client step", authenticate_gss_client_step(client, "", NULL));
+        }
+        {
+            Timer timer(SERVER_STEP);
+            check("server step", authenticate_gss_server_step(server, client->response));
+        }
+        {
+            Timer timer(CLIENT_STEP_MUTUAL);
+            check("client step", authenticate_gss_client_step(client, server->response, NULL));
+        }
+        {
+            Timer timer(CLIENT_WRAP);
+            check("client wrap", authenticate_gss_client_wrap(client, wrap_input, NULL, 0, false));
+        }
+
+        char* token = server_wrap(server, payload.c_str());
+        {
+            Timer timer(CLIENT_UNWRAP);
+            check("client unwrap", authenticate_gss_client_unwrap(client, token, false));
+        }
+        free(token);
+
+        authenticate_gss_client_clean(client);
+        authenticate_gss_server_clean(server);
+        gss_client_state_free(client);
+        gss_server_state_free(server);
+    }
+
+    free(wrap_input);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <service> [iterations]\n", argv[0]);
+        return 2;
+    }
+
+    const char* service = argv[1];
+    int iterations = (argc > 2) ? atoi(argv[2]) : 1000;
+
+    bench_base64(iterations * 10);
+    bench_handshake(service, iterations);
+
+    // one JSON object per benchmark, durations in microseconds
+    for (int i = 0; i < BENCHMARKS; ++i) {
+        KerberosHistogram::Summary summary = benchmarks[i].histogram.Summarize();
+        printf(
+            "{\"name\":\"%s\",\"count\":%llu,\"meanUs\":%.3f,\"p50Us\":%.3f,\"p99Us\":%.3f,"
+            "\"maxUs\":%.3f}\n",
+            benchmarks[i].name,
+            (unsigned long long)summary.count,
+            summary.mean / 1e3,
+            summary.p50 / 1e3,
+            summary.p99 / 1e3,
+            summary.max / 1e3);
+    }
+
+    return 0;
+}
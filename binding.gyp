@@ -1,11 +1,45 @@
 {
+  'variables': {
+    'kerberos_usdt%': 'true',
+    'kerberos_bench%': 'false',
+    'kerberos_gss_mock%': 'false',
+    # The GSS core, shared by the addon and the `kerberos_core` library on mac and linux
+    'kerberos_gss_sources': [
+      'src/unix/base64.cc',
+      'src/unix/kerberos_gss.cc',
+      'src/unix/kerberos_gss_arena.cc',
+      'src/unix/kerberos_gss_cred_cache.cc',
+      'src/unix/kerberos_gss_localname.cc'
+    ]
+  },
+  'target_defaults': {
+    'conditions': [
+      ['kerberos_usdt!="true"', {
+        'defines': [ 'KERBEROS_DISABLE_USDT' ]
+      }],
+      # Exposes the native micro-benchmarks of bench/, e.g. `_benchmarkChallenge`
+      ['kerberos_bench=="true"', {
+        'defines': [ 'KERBEROS_BENCH' ]
+      }],
+      # Replaces the KDC and keytab dependent GSSAPI and krb5 calls with a configurable mock,
+      # see src/unix/kerberos_gss_mock.h
+      ['kerberos_gss_mock=="true" and OS=="linux"', {
+        'defines': [ 'KERBEROS_GSS_MOCK' ]
+      }]
+    ]
+  },
   'targets': [
     {
       'target_name': 'kerberos',
       'type': 'loadable_module',
       'include_dirs': [ '<!(node -e "require(\'nan\')")' ],
       'sources': [
-        'src/kerberos.cc'
+        'src/kerberos.cc',
+        'src/kerberos_challenge.cc',
+        'src/kerberos_memory.cc',
+        'src/kerberos_slab.cc',
+        'src/kerberos_stats.cc',
+        'src/kerberos_trace.cc'
       ],
       'xcode_settings': {
         'MACOSX_DEPLOYMENT_TARGET': '10.12'
@@ -13,8 +47,7 @@
       'conditions': [
         ['OS=="mac" or OS=="linux"', {
           'sources': [
-            'src/unix/base64.cc',
-            'src/unix/kerberos_gss.cc',
+            '<@(kerberos_gss_sources)',
             'src/unix/kerberos_unix.cc'
           ],
           'link_settings': {
@@ -24,12 +57,8 @@
             ]
           },
           'conditions': [
-            ['_type=="static_library"', {
-              'link_settings': {
-                'libraries': [
-                  '-lcom_err'
-                ]
-              }
+            ['kerberos_gss_mock=="true" and OS=="linux"', {
+              'sources': [ 'src/unix/kerberos_gss_mock.cc' ]
             }]
           ]
         }],
@@ -48,5 +77,49 @@
         }]
       ]
     }
+  ],
+  'conditions': [
+    # The GSS core as a static library, and a benchmark linked against it which runs without
+    # node. Both are opt-in, an install only builds the addon above (which compiles the core
+    # sources itself); they are built with `node-gyp rebuild -- -Dkerberos_bench=true`
+    ['kerberos_bench=="true" and (OS=="mac" or OS=="linux")', {
+      'targets': [
+        {
+          'target_name': 'kerberos_core',
+          'type': 'static_library',
+          'sources': [
+            'src/kerberos_memory.cc',
+            'src/kerberos_stats.cc',
+            'src/kerberos_trace.cc',
+            '<@(kerberos_gss_sources)'
+          ],
+          'conditions': [
+            ['kerberos_gss_mock=="true" and OS=="linux"', {
+              'sources': [ 'src/unix/kerberos_gss_mock.cc' ]
+            }]
+          ],
+          'xcode_settings': {
+            'MACOSX_DEPLOYMENT_TARGET': '10.12'
+          },
+          'link_settings': {
+            'libraries': [
+              '-lkrb5',
+              '-lgssapi_krb5'
+            ]
+          }
+        },
+        {
+          'target_name': 'kerberos_bench',
+          'type': 'executable',
+          'dependencies': [ 'kerberos_core' ],
+          'sources': [
+            'bench/native/kerberos_gss_bench.cc'
+          ],
+          'xcode_settings': {
+            'MACOSX_DEPLOYMENT_TARGET': '10.12'
+          }
+        }
+      ]
+    }]
   ]
 }
\ No newline at end of file
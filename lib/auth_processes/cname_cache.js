@@ -0,0 +1,112 @@
+'use strict';
+const dns = require('dns');
+
+// Answers which mean the name has no CNAME, as opposed to the resolver being unhealthy
+const NEGATIVE_CODES = ['ENODATA', 'ENOTFOUND', 'NXDOMAIN'];
+
+/**
+ * Caches `dns.resolveCname` answers for host name canonicalization, so that establishing many
+ * connections to the same hosts costs one DNS round trip per host and TTL rather than one per
+ * connection. Concurrent lookups of a host share a single query, and hosts without a CNAME are
+ * remembered for `negativeTtl`. Other failures (timeouts, refused queries) are not cached.
+ *
+ * Node does not expose the TTL of CNAME records, so answers are kept for `ttl` milliseconds,
+ * which should not exceed the TTL of the records involved.
+ *
+ * @private
+ */
+class CnameCache {
+  /**
+   * @param {object} [options]
+   * @param {number} [options.ttl=60000] How long an answer is reused, in milliseconds
+   * @param {number} [options.negativeTtl=5000] How long a host without a CNAME is remembered, in milliseconds
+   * @param {number} [options.maxEntries=1000] The number of hosts kept, the oldest are evicted first
+   * @param {function} [options.resolveCname] Replaces `dns.resolveCname`
+   */
+  constructor(options) {
+    options = options || {};
+    this.ttl = typeof options.ttl === 'number' ? options.ttl : 60000;
+    this.negativeTtl = typeof options.negativeTtl === 'number' ? options.negativeTtl : 5000;
+    this.maxEntries = typeof options.maxEntries === 'number' ? options.maxEntries : 1000;
+    this._resolveCname = options.resolveCname || dns.resolveCname;
+    this._entries = new Map();
+    this._pending = new Map();
+    this._stats = { hits: 0, negativeHits: 0, misses: 0, coalesced: 0, errors: 0 };
+  }
+
+  /**
+   * Resolves the CNAMEs of `host`, from the cache when possible.
+   *
+   * @param {string} host
+   * @param {function} callback called with an error or the CNAME records of `host`
+   */
+  resolve(host, callback) {
+    const entry = this._entries.get(host);
+    if (entry != null) {
+      if (entry.expires > Date.now()) {
+        if (entry.error) {
+          this._stats.negativeHits++;
+          return process.nextTick(callback, entry.error);
+        }
+
+        this._stats.hits++;
+        return process.nextTick(callback, null, entry.records);
+      }
+
+      this._entries.delete(host);
+    }
+
+    const waiting = this._pending.get(host);
+    if (waiting != null) {
+      this._stats.coalesced++;
+      waiting.push(callback);
+      return;
+    }
+
+    this._stats.misses++;
+    const callbacks = [callback];
+    this._pending.set(host, callbacks);
+    this._resolveCname(host, (err, records) => {
+      this._pending.delete(host);
+      if (err) {
+        this._stats.errors++;
+        if (NEGATIVE_CODES.indexOf(err.code) !== -1) {
+          this._store(host, { error: err, expires: Date.now() + this.negativeTtl });
+        }
+      } else {
+        this._store(host, { records, expires: Date.now() + this.ttl });
+      }
+
+      callbacks.forEach(cb => cb(err, records));
+    });
+  }
+
+  _store(host, entry) {
+    if (this._entries.size >= this.maxEntries) {
+      this._entries.delete(this._entries.keys().next().value);
+    }
+
+    this._entries.set(host, entry);
+  }
+
+  /**
+   * Returns the number of lookups answered from the cache (`hits` and `negativeHits`), sent to
+   * DNS (`misses`), or joined to one already in flight (`coalesced`), the number of DNS queries
+   * which failed (`errors`), and the number of hosts cached (`size`).
+   *
+   * @return {object}
+   */
+  stats() {
+    return Object.assign({ size: this._entries.size }, this._stats);
+  }
+
+  /**
+   * Forgets every cached answer and resets the statistics.
+   */
+  clear() {
+    this._entries.clear();
+    Object.keys(this._stats).forEach(key => (this._stats[key] = 0));
+  }
+}
+
+module.exports = { CnameCache };
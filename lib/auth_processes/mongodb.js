@@ -1,6 +1,9 @@
 'use strict';
-const dns = require('dns');
 const kerberos = require('../kerberos');
+const CnameCache = require('./cname_cache').CnameCache;
+
+// Shared by every process, see `MongoAuthProcess.cnameCache`
+const cnameCache = new CnameCache();
 
 class MongoAuthProcess {
   constructor(host, port, serviceName, options) {
@@ -34,7 +37,7 @@ class MongoAuthProcess {
       if (!canonicalizeHostName) return callback();
 
       // Attempt to resolve the host name
-      dns.resolveCname(host, (err, r) => {
+      cnameCache.resolve(host, (err, r) => {
         if (err) return callback(err);
 
         // Get the first resolve host id
@@ -80,7 +83,7 @@ class MongoAuthProcess {
 
 function firstTransition(auth) {
   return (payload, callback) => {
-    auth.client.step('', (err, response) => {
+    auth.client.saslStep('', {}, (err, response) => {
       if (err) return callback(err);
 
       // Set up the next step
@@ -94,8 +97,10 @@ function firstTransition(auth) {
 
 function secondTransition(auth) {
   return (payload, callback) => {
-    auth.client.step(payload, (err, response) => {
-      if (err && auth.retries === 0) return callback(err);
+    auth.client.saslStep(payload, {}, (err, response) => {
+      // Only errors which may be transient are worth retrying, `retryable` is not reported on
+      // all platforms so its absence is treated as retryable
+      if (err && (auth.retries === 0 || err.retryable === false)) return callback(err);
 
       // Attempt to re-establish a context
       if (err) {
@@ -117,20 +122,15 @@ function secondTransition(auth) {
 
 function thirdTransition(auth) {
   return (payload, callback) => {
-    // GSS Client Unwrap
-    auth.client.unwrap(payload, (err, response) => {
+    // Unwrap the security layer offer and wrap the reply in a single call
+    auth.client.saslStep(payload, { user: auth.username }, (err, wrapped) => {
       if (err) return callback(err, false);
 
-      // Wrap the response
-      auth.client.wrap(response, { user: auth.username }, (err, wrapped) => {
-        if (err) return callback(err, false);
-
-        // Set up the next step
-        auth._transition = fourthTransition(auth);
+      // Set up the next step
+      auth._transition = fourthTransition(auth);
 
-        // Return the payload
-        callback(null, wrapped);
-      });
+      // Return the payload
+      callback(null, wrapped);
     });
   };
 }
@@ -145,6 +145,12 @@ function fourthTransition(auth) {
   };
 }
 
+/**
+ * The cache of `gssapiCanonicalizeHostName` lookups shared by every `MongoAuthProcess`, whose
+ * `stats()` report its hits and misses, and whose `ttl` and `negativeTtl` can be adjusted.
+ */
+MongoAuthProcess.cnameCache = cnameCache;
+
 // Set the process
 module.exports = {
   MongoAuthProcess
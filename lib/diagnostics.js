@@ -0,0 +1,156 @@
+'use strict';
+
+const START_CHANNEL = 'kerberos:operation:start';
+const END_CHANNEL = 'kerberos:operation:end';
+
+// `diagnostics_channel` is only available from node 14.17/15.1
+let startChannel = null;
+let endChannel = null;
+try {
+  const diagnosticsChannel = require('diagnostics_channel');
+  startChannel = diagnosticsChannel.channel(START_CHANNEL);
+  endChannel = diagnosticsChannel.channel(END_CHANNEL);
+} catch (err) {
+  // events are not published
+}
+
+let performance = null;
+let performanceEntries = false;
+
+/**
+ * Enables or disables creating a `PerformanceMeasure` for every native operation.
+ *
+ * @private
+ * @param {boolean} enabled
+ */
+function setPerformanceEntries(enabled) {
+  if (enabled && performance == null) {
+    performance = require('perf_hooks').performance;
+  }
+
+  performanceEntries = !!enabled;
+}
+
+function isInstrumented() {
+  return (
+    performanceEntries ||
+    (startChannel != null && (startChannel.hasSubscribers || endChannel.hasSubscribers))
+  );
+}
+
+function now() {
+  if (performance == null) {
+    performance = require('perf_hooks').performance;
+  }
+
+  return performance.now();
+}
+
+/**
+ * Returns the decoded size in bytes of a base64-encoded token, or `null` if there is no token.
+ * Binary tokens are already decoded.
+ *
+ * @private
+ * @param {string|Buffer} token
+ * @return {number|null}
+ */
+function tokenLength(token) {
+  if (Buffer.isBuffer(token)) {
+    return token.length;
+  }
+
+  if (typeof token !== 'string') {
+    return null;
+  }
+
+  let padding = 0;
+  if (token.endsWith('==')) padding = 2;
+  else if (token.endsWith('=')) padding = 1;
+  return Math.floor((token.length * 3) / 4) - padding;
+}
+
+/**
+ * Wraps an operation defined with `defineOperation` so that it publishes start and end events
+ * on `diagnostics_channel`, and optionally records a `PerformanceMeasure`. When neither is in
+ * use the original operation is called directly.
+ *
+ * `describe.start(target, args)` returns the initial event properties, which must include the
+ * `operation` name, and the optional `describe.end(target, result, event)` adds properties once
+ * the operation has completed successfully.
+ *
+ * @private
+ * @param {function} fn the operation to wrap
+ * @param {object} describe
+ * @return {function}
+ */
+function instrumentOperation(fn, describe) {
+  return function() {
+    if (!isInstrumented()) {
+      return fn.apply(this, arguments);
+    }
+
+    const target = this;
+    const args = Array.prototype.slice.call(arguments);
+    const event = describe.start(target, args);
+    const start = now();
+    if (startChannel != null && startChannel.hasSubscribers) {
+      startChannel.publish(event);
+    }
+
+    const finish = (err, result) => {
+      event.duration = now() - start;
+      if (err) {
+        event.error = err;
+      } else if (describe.end) {
+        describe.end(target, result, event);
+      }
+
+      if (endChannel != null && endChannel.hasSubscribers) {
+        endChannel.publish(event);
+      }
+
+      if (performanceEntries) {
+        performance.measure(event.operation, { start, duration: event.duration, detail: event });
+      }
+    };
+
+    const callback = args[args.length - 1];
+    if (typeof callback === 'function') {
+      args[args.length - 1] = function(err, result) {
+        finish(err, result);
+        return callback.apply(this, arguments);
+      };
+    }
+
+    let promise;
+    try {
+      promise = fn.apply(target, args);
+    } catch (err) {
+      finish(err);
+      throw err;
+    }
+
+    if (typeof callback === 'function') {
+      return promise;
+    }
+
+    return promise.then(
+      result => {
+        finish(null, result);
+        return result;
+      },
+      err => {
+        finish(err);
+        throw err;
+      }
+    );
+  };
+}
+
+module.exports = {
+  START_CHANNEL,
+  END_CHANNEL,
+  instrumentOperation,
+  setPerformanceEntries,
+  tokenLength
+};
@@ -4,6 +4,11 @@ const kerberos = require('bindings')('kerberos');
 const KerberosClient = kerberos.KerberosClient;
 const KerberosServer = kerberos.KerberosServer;
 const defineOperation = require('./util').defineOperation;
+const formatPrometheus = require('./stats').formatPrometheus;
+const diagnostics = require('./diagnostics');
+const instrumentOperation = diagnostics.instrumentOperation;
+const tokenLength = diagnostics.tokenLength;
+const SaslSecurityLayer = require('./sasl_stream').SaslSecurityLayer;
 
 // GSS Flags
 const GSS_C_DELEG_FLAG = 1;
@@ -21,9 +26,51 @@ const GSS_C_NO_OID = 0;
 const GSS_MECH_OID_KRB5 = 9;
 const GSS_MECH_OID_SPNEGO = 6;
 
+// The service and mechanism of a context, recorded for diagnostics events
+const kDiagnostics = Symbol('diagnostics');
+
+function mechanismName(options) {
+  const mechOID = options != null && typeof options === 'object' ? options.mechOID : null;
+  if (mechOID === GSS_MECH_OID_KRB5) return 'krb5';
+  if (mechOID === GSS_MECH_OID_SPNEGO) return 'spnego';
+  return null;
+}
+
+function contextEvent(operation, context, challenge) {
+  const details = (context && context[kDiagnostics]) || {};
+  return {
+    operation,
+    service: details.service || null,
+    mechanism: details.mechanism || null,
+    inputLength: tokenLength(challenge)
+  };
+}
+
+function handleOperation(handle, client, server) {
+  const info = typeof handle === 'number' ? kerberos.handleInfo(handle) : null;
+  return info != null && 'targetName' in info ? server : client;
+}
+
+function recordResponseLength(context, result, event) {
+  const response =
+    result != null && typeof result === 'object' ? result.response : context.response;
+  event.outputLength = tokenLength(response);
+}
+
+function recordResultLength(context, result, event) {
+  event.outputLength = tokenLength(result);
+}
+
+function totalLength(buffers) {
+  return Array.isArray(buffers) ? buffers.reduce((total, buffer) => total + buffer.length, 0) : null;
+}
+
 /**
  * @class KerberosClient
  *
+ * A client runs one operation at a time: starting another before the previous one has completed
+ * is an error. Chain operations on the same client, or use separate clients to run them in parallel.
+ *
  * @property {string} username The username used for authentication
  * @property {string} response The last response received during authentication steps
  * @property {string} responseConf Indicates whether confidentiality was applied or not (GSSAPI only)
@@ -36,13 +83,22 @@ const GSS_MECH_OID_SPNEGO = 6;
  * @kind function
  * @memberof KerberosClient
  * @param {string} challenge A string containing the base64-encoded server data (which may be empty for the first step)
+ * @param {object} [options] Optional settings
+ * @param {boolean} [options.details=false] Resolve to `{ response, complete, username, responseConf }` instead of just the response, saving a round trip through the client's getters for each
  * @param {function} [callback]
  * @return {Promise} returns Promise if no callback passed
  */
-KerberosClient.prototype.step = defineOperation(KerberosClient.prototype.step, [
-  { name: 'challenge', type: 'string' },
-  { name: 'callback', type: 'function', required: false }
-]);
+KerberosClient.prototype.step = instrumentOperation(
+  defineOperation(KerberosClient.prototype.step, [
+    { name: 'challenge', type: 'string' },
+    { name: 'options', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) => contextEvent('kerberos:ClientStep', client, args[0]),
+    end: recordResponseLength
+  }
+);
 
 /**
  * Perform the client side kerberos wrap step.
@@ -52,14 +108,21 @@ KerberosClient.prototype.step = defineOperation(KerberosClient.prototype.step, [
  * @param {string} challenge The response returned after calling `unwrap`
  * @param {object} [options] Optional settings
  * @param {string} [options.user] The user to authorize
+ * @param {boolean} [options.binary=false] Resolve to a `Buffer` holding the wrapped token instead of a base64 string, saving an encoding per message. The token is wrapped without confidentiality and so carries the message, so like the output of `unwrap` it gets memory of its own.
  * @param {function} [callback]
  * @return {Promise} returns Promise if no callback passed
  */
-KerberosClient.prototype.wrap = defineOperation(KerberosClient.prototype.wrap, [
-  { name: 'challenge', type: 'string' },
-  { name: 'options', type: 'object' },
-  { name: 'callback', type: 'function', required: false }
-]);
+KerberosClient.prototype.wrap = instrumentOperation(
+  defineOperation(KerberosClient.prototype.wrap, [
+    { name: 'challenge', type: 'string' },
+    { name: 'options', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) => contextEvent('kerberos:ClientWrap', client, args[0]),
+    end: recordResultLength
+  }
+);
 
 /**
  * Perform the client side kerberos unwrap step
@@ -67,17 +130,242 @@ KerberosClient.prototype.wrap = defineOperation(KerberosClient.prototype.wrap, [
  * @kind function
  * @memberof KerberosClient
  * @param {string} challenge A string containing the base64-encoded server data
+ * @param {object} [options] Optional settings
+ * @param {boolean} [options.binary=false] Resolve to a `Buffer` holding the unwrapped message instead of a base64 string. It is never a slice of a shared slab, so its memory holds nothing but this message
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed
+ */
+KerberosClient.prototype.unwrap = instrumentOperation(
+  defineOperation(KerberosClient.prototype.unwrap, [
+    { name: 'challenge', type: 'string' },
+    { name: 'options', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) => contextEvent('kerberos:ClientUnwrap', client, args[0]),
+    end: recordResultLength
+  }
+);
+
+/**
+ * Computes a message integrity code (MIC) for `message` with `gss_get_mic`, for protocols which
+ * only need integrity. A MIC is smaller and cheaper to make than a `wrap` token, and is sent
+ * alongside the message rather than in place of it.
+ *
+ * @kind function
+ * @memberof KerberosClient
+ * @param {Buffer} message
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed, resolving to the MIC as a `Buffer`
+ */
+KerberosClient.prototype.getMic = instrumentOperation(
+  defineOperation(KerberosClient.prototype.getMic, [
+    { name: 'message', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) => contextEvent('kerberos:ClientGetMic', client, args[0]),
+    end: recordResultLength
+  }
+);
+
+/**
+ * Computes the MICs of several messages in a single native call, see `getMic`.
+ *
+ * @kind function
+ * @memberof KerberosClient
+ * @param {Buffer[]} messages
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed, resolving to an array holding the MIC of each message
+ */
+KerberosClient.prototype.getMics = instrumentOperation(
+  defineOperation(KerberosClient.prototype.getMics, [
+    { name: 'messages', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) =>
+      Object.assign(contextEvent('kerberos:ClientGetMic', client, null), {
+        inputLength: totalLength(args[0])
+      })
+  }
+);
+
+/**
+ * Checks that `mic` is the MIC of `message` with `gss_verify_mic`. Resolves to whether it is;
+ * the operation only fails when the MIC couldn't be checked at all, e.g. because the context has
+ * expired. A MIC which was already verified, or arrives out of sequence, is not valid.
+ *
+ * @kind function
+ * @memberof KerberosClient
+ * @param {Buffer} message
+ * @param {Buffer} mic
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed, resolving to `true` if the MIC is valid
+ */
+KerberosClient.prototype.verifyMic = instrumentOperation(
+  defineOperation(KerberosClient.prototype.verifyMic, [
+    { name: 'message', type: 'object' },
+    { name: 'mic', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) => contextEvent('kerberos:ClientVerifyMic', client, args[0])
+  }
+);
+
+/**
+ * Checks the MICs of several messages in a single native call, see `verifyMic`.
+ *
+ * @kind function
+ * @memberof KerberosClient
+ * @param {Buffer[]} messages
+ * @param {Buffer[]} mics The MIC of each message
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed, resolving to an array of whether each MIC is valid
+ */
+KerberosClient.prototype.verifyMics = instrumentOperation(
+  defineOperation(KerberosClient.prototype.verifyMics, [
+    { name: 'messages', type: 'object' },
+    { name: 'mics', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) =>
+      Object.assign(contextEvent('kerberos:ClientVerifyMic', client, null), {
+        inputLength: totalLength(args[0])
+      })
+  }
+);
+
+/**
+ * Reports the room `wrapInto` needs around a message of `length` bytes: `header` bytes before it,
+ * and `trailer` bytes after it for padding and the trailer. For the Kerberos mechanism (RFC 4121)
+ * these don't depend on the length, so they can be asked for once per context.
+ *
+ * @kind function
+ * @memberof KerberosClient
+ * @param {number} length The length of the message
+ * @param {object} [options] Optional settings
+ * @param {boolean} [options.protect=true] Whether the message will be encrypted, as well as signed
  * @param {function} [callback]
  * @return {Promise} returns Promise if no callback passed
  */
-KerberosClient.prototype.unwrap = defineOperation(KerberosClient.prototype.unwrap, [
-  { name: 'challenge', type: 'string' },
-  { name: 'callback', type: 'function', required: false }
-]);
+KerberosClient.prototype.wrapOverhead = instrumentOperation(
+  defineOperation(KerberosClient.prototype.wrapOverhead, [
+    { name: 'length', type: 'number' },
+    { name: 'options', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: client => contextEvent('kerberos:ClientWrapOverhead', client, null)
+  }
+);
+
+/**
+ * Wraps the message at `buffer[offset, offset + length)` in place: it is encrypted (or only
+ * signed, without `options.protect`) where it is, and the token's header and trailer are written
+ * into the bytes just before and after it, see `wrapOverhead`. Resolves to a `Buffer` sharing
+ * `buffer`'s memory which holds the whole token, the same token `wrap` would produce, without
+ * allocating or copying the message.
+ *
+ * @kind function
+ * @memberof KerberosClient
+ * @param {Buffer} buffer The buffer holding the message, with room for the header and trailer
+ * @param {number} offset The offset of the message in `buffer`
+ * @param {number} length The length of the message
+ * @param {object} [options] Optional settings
+ * @param {boolean} [options.protect=true] Encrypt the message, as well as signing it
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed
+ */
+KerberosClient.prototype.wrapInto = instrumentOperation(
+  defineOperation(KerberosClient.prototype.wrapInto, [
+    { name: 'buffer', type: 'object' },
+    { name: 'offset', type: 'number' },
+    { name: 'length', type: 'number' },
+    { name: 'options', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) =>
+      Object.assign(contextEvent('kerberos:ClientWrapInto', client, null), {
+        inputLength: args[2]
+      }),
+    end: recordResultLength
+  }
+);
+
+/**
+ * Unwraps the token in `buffer` in place, decrypting the message where it is. Resolves to a
+ * `Buffer` sharing `buffer`'s memory which holds the message; `responseConf` reports whether it
+ * was encrypted.
+ *
+ * @kind function
+ * @memberof KerberosClient
+ * @param {Buffer} buffer A whole wrap token, from `wrapInto` or `wrap`
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed
+ */
+KerberosClient.prototype.unwrapInPlace = instrumentOperation(
+  defineOperation(KerberosClient.prototype.unwrapInPlace, [
+    { name: 'buffer', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) => contextEvent('kerberos:ClientUnwrapInPlace', client, args[0]),
+    end: recordResultLength
+  }
+);
+
+/**
+ * Advances the client side of a SASL GSSAPI exchange (RFC 4752) with the next server payload,
+ * resolving to the next client payload. Until the security context is complete this is a `step`;
+ * after that, the server's security layer offer is unwrapped, the security layer named by
+ * `options.qop` is selected, and the reply authorizing `options.user` is wrapped, all in a single
+ * call. Once a layer other than `'auth'` is selected, protect the connection with a
+ * `SaslSecurityLayer`.
+ *
+ * @kind function
+ * @memberof KerberosClient
+ * @param {string} payload The base64-encoded server payload (which is empty for the first step)
+ * @param {object} [options] Optional settings
+ * @param {string} [options.user] The user to authorize
+ * @param {string} [options.qop='auth'] The security layer: `'auth'` for none, `'auth-int'` for integrity, or `'auth-conf'` for confidentiality
+ * @param {number} [options.maxBufferSize=65536] The largest frame accepted from the server once a security layer is in place
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed
+ */
+KerberosClient.prototype.saslStep = instrumentOperation(
+  defineOperation(KerberosClient.prototype.saslStep, [
+    { name: 'payload', type: 'string' },
+    { name: 'options', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (client, args) => contextEvent('kerberos:ClientSaslStep', client, args[0]),
+    end: recordResultLength
+  }
+);
+
+/**
+ * Releases the security context and credentials held by this client now, rather than when it is
+ * garbage collected, and returns its native state for reuse by the next `initializeClient`.
+ * Operations already in flight complete first, later ones fail. Safe to call more than once, and
+ * also available as `[Symbol.dispose]` where the runtime supports it.
+ *
+ * @kind function
+ * @memberof KerberosClient
+ */
+if (typeof Symbol.dispose === 'symbol') {
+  KerberosClient.prototype[Symbol.dispose] = KerberosClient.prototype.destroy;
+}
 
 /**
  * @class KerberosServer
  *
+ * Like `KerberosClient`, a server runs one operation at a time.
+ *
  * @property {string} username The username used for authentication
  * @property {string} response The last response received during authentication steps
  * @property {string} targetName The target used for authentication
@@ -90,13 +378,45 @@ KerberosClient.prototype.unwrap = defineOperation(KerberosClient.prototype.unwra
  * @kind function
  * @memberof KerberosServer
  * @param {string} challenge A string containing the base64-encoded client data
+ * @param {object} [options] Optional settings
+ * @param {boolean} [options.details=false] Resolve to `{ response, complete, username, targetName }` instead of just the response
  * @param {function} [callback]
  * @return {Promise} returns Promise if no callback passed
  */
-KerberosServer.prototype.step = defineOperation(KerberosServer.prototype.step, [
-  { name: 'challenge', type: 'string' },
-  { name: 'callback', type: 'function', required: false }
-]);
+KerberosServer.prototype.step = instrumentOperation(
+  defineOperation(KerberosServer.prototype.step, [
+    { name: 'challenge', type: 'string' },
+    { name: 'options', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (server, args) => contextEvent('kerberos:ServerStep', server, args[0]),
+    end: recordResponseLength
+  }
+);
+
+/**
+ * Maps the authenticated client principal to a local account name, following the `auth_to_local`
+ * rules of the Kerberos configuration. Mappings are cached in memory, so this is cheap to call
+ * for every connection.
+ *
+ * @kind function
+ * @memberof KerberosServer
+ * @return {string|null} The local name, or `null` if the principal has no local name or the context is not yet complete
+ */
+
+/**
+ * Releases the security context and credentials held by this server now, rather than when it is
+ * garbage collected, and returns its native state for reuse by the next `initializeServer`.
+ * Operations already in flight complete first, later ones fail. Safe to call more than once, and
+ * also available as `[Symbol.dispose]` where the runtime supports it.
+ *
+ * @kind function
+ * @memberof KerberosServer
+ */
+if (typeof Symbol.dispose === 'symbol') {
+  KerberosServer.prototype[Symbol.dispose] = KerberosServer.prototype.destroy;
+}
 
 /**
  * This function provides a simple way to verify that a user name and password
@@ -123,13 +443,18 @@ KerberosServer.prototype.step = defineOperation(KerberosServer.prototype.step, [
  * @param {function} [callback]
  * @return {Promise} returns Promise if no callback passed
  */
-const checkPassword = defineOperation(kerberos.checkPassword, [
-  { name: 'username', type: 'string' },
-  { name: 'password', type: 'string' },
-  { name: 'service', type: 'string' },
-  { name: 'defaultRealm', type: 'string', required: false },
-  { name: 'callback', type: 'function', required: false }
-]);
+const checkPassword = instrumentOperation(
+  defineOperation(kerberos.checkPassword, [
+    { name: 'username', type: 'string' },
+    { name: 'password', type: 'string' },
+    { name: 'service', type: 'string' },
+    { name: 'defaultRealm', type: 'string', required: false },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (target, args) => ({ operation: 'kerberos:CheckPassword', service: args[2] })
+  }
+);
 
 /**
  * This function returns the service principal for the server given a service type and hostname.
@@ -142,11 +467,16 @@ const checkPassword = defineOperation(kerberos.checkPassword, [
  * @param {function} [callback]
  * @return {Promise} returns Promise if no callback passed
  */
-const principalDetails = defineOperation(kerberos.principalDetails, [
-  { name: 'service', type: 'string' },
-  { name: 'hostname', type: 'string' },
-  { name: 'callback', type: 'function', required: false }
-]);
+const principalDetails = instrumentOperation(
+  defineOperation(kerberos.principalDetails, [
+    { name: 'service', type: 'string' },
+    { name: 'hostname', type: 'string' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (target, args) => ({ operation: 'kerberos:PrincipalDetails', service: args[0] })
+  }
+);
 
 /**
  * Initializes a context for client-side authentication with the given service principal.
@@ -155,16 +485,30 @@ const principalDetails = defineOperation(kerberos.principalDetails, [
  * @param {string} service A string containing the service principal in the form 'type@fqdn' (e.g. 'imap@mail.apple.com').
  * @param {object} [options] Optional settings
  * @param {string} [options.principal] Optional string containing the client principal in the form 'user@realm' (e.g. 'jdoe@example.com').
+ * @param {string} [options.user] Optional alias for `principal`, used with `password` when `principal` is not supplied.
+ * @param {string} [options.password] Optional password for the client principal. When supplied, credentials are acquired directly from the KDC and kept in process memory (no `kinit` or credential cache on disk is needed), then shared by every client initialized with the same principal until they expire. On macOS, whose GSS framework cannot log in with a password, the principal's existing credentials are used instead.
  * @param {number} [options.gssFlags] Optional integer used to set GSS flags. (e.g.  GSS_C_DELEG_FLAG|GSS_C_MUTUAL_FLAG|GSS_C_SEQUENCE_FLAG will allow for forwarding credentials to the remote host)
  * @param {number} [options.mechOID] Optional GSS mech OID. Defaults to None (GSS_C_NO_OID). Other possible values are `GSS_MECH_OID_KRB5`, `GSS_MECH_OID_SPNEGO`.
  * @param {function} [callback]
  * @return {Promise} returns Promise if no callback passed
  */
-const initializeClient = defineOperation(kerberos.initializeClient, [
-  { name: 'service', type: 'string' },
-  { name: 'options', type: 'object', default: { mechOID: GSS_C_NO_OID } },
-  { name: 'callback', type: 'function', required: false }
-]);
+const initializeClient = instrumentOperation(
+  defineOperation(kerberos.initializeClient, [
+    { name: 'service', type: 'string' },
+    { name: 'options', type: 'object', default: { mechOID: GSS_C_NO_OID } },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (target, args) => ({
+      operation: 'kerberos:InitializeClient',
+      service: args[0],
+      mechanism: mechanismName(args[1])
+    }),
+    end: (target, client, event) => {
+      client[kDiagnostics] = { service: event.service, mechanism: event.mechanism };
+    }
+  }
+);
 
 /**
  * Initializes a context for server-side authentication with the given service principal.
@@ -174,16 +518,280 @@ const initializeClient = defineOperation(kerberos.initializeClient, [
  * @param {function} [callback]
  * @return {Promise} returns Promise if no callback passed
  */
-const initializeServer = defineOperation(kerberos.initializeServer, [
-  { name: 'service', type: 'string' },
-  { name: 'callback', type: 'function', required: false }
-]);
+const initializeServer = instrumentOperation(
+  defineOperation(kerberos.initializeServer, [
+    { name: 'service', type: 'string' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (target, args) => ({ operation: 'kerberos:InitializeServer', service: args[0] }),
+    end: (target, server, event) => {
+      server[kDiagnostics] = { service: event.service, mechanism: null };
+    }
+  }
+);
+
+/**
+ * Initializes a client-side authentication context in the native context table, returning an
+ * integer handle instead of a `KerberosClient`. Handle-based contexts are not tracked by the
+ * garbage collector and must be released with `releaseHandle` when no longer needed.
+ *
+ * @kind function
+ * @param {string} service A string containing the service principal in the form 'type@fqdn' (e.g. 'imap@mail.apple.com').
+ * @param {object} [options] Optional settings, the same as those supported by `initializeClient`
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed
+ */
+const initializeClientHandle = instrumentOperation(
+  defineOperation(kerberos.initializeClientHandle, [
+    { name: 'service', type: 'string' },
+    { name: 'options', type: 'object', default: { mechOID: GSS_C_NO_OID } },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (target, args) => ({
+      operation: 'kerberos:InitializeClientHandle',
+      service: args[0],
+      mechanism: mechanismName(args[1])
+    })
+  }
+);
+
+/**
+ * Initializes a server-side authentication context in the native context table, returning an
+ * integer handle instead of a `KerberosServer`. Handle-based contexts are not tracked by the
+ * garbage collector and must be released with `releaseHandle` when no longer needed.
+ *
+ * @kind function
+ * @param {string} service A string containing the service principal in the form 'type@fqdn' (e.g. 'imap@mail.apple.com').
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed
+ */
+const initializeServerHandle = instrumentOperation(
+  defineOperation(kerberos.initializeServerHandle, [
+    { name: 'service', type: 'string' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (target, args) => ({ operation: 'kerberos:InitializeServerHandle', service: args[0] })
+  }
+);
+
+/**
+ * Processes a single kerberos step for a client or server context handle.
+ *
+ * @kind function
+ * @param {number} handle A context handle returned by `initializeClientHandle` or `initializeServerHandle`
+ * @param {string} challenge A string containing the base64-encoded peer data (which may be empty for the first client step)
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed
+ */
+const stepHandle = instrumentOperation(
+  defineOperation(kerberos.stepHandle, [
+    { name: 'handle', type: 'number' },
+    { name: 'challenge', type: 'string' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (target, args) => {
+      const operation = handleOperation(args[0], 'kerberos:ClientStep', 'kerberos:ServerStep');
+      return contextEvent(operation, null, args[1]);
+    },
+    end: recordResultLength
+  }
+);
+
+/**
+ * Perform the client side kerberos wrap step for a client context handle.
+ *
+ * @kind function
+ * @param {number} handle A context handle returned by `initializeClientHandle`
+ * @param {string} challenge The response returned after calling `unwrapHandle`
+ * @param {object} [options] Optional settings
+ * @param {string} [options.user] The user to authorize
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed
+ */
+const wrapHandle = instrumentOperation(
+  defineOperation(kerberos.wrapHandle, [
+    { name: 'handle', type: 'number' },
+    { name: 'challenge', type: 'string' },
+    { name: 'options', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (target, args) => contextEvent('kerberos:ClientWrap', null, args[1]),
+    end: recordResultLength
+  }
+);
+
+/**
+ * Perform the client side kerberos unwrap step for a client context handle.
+ *
+ * @kind function
+ * @param {number} handle A context handle returned by `initializeClientHandle`
+ * @param {string} challenge A string containing the base64-encoded server data
+ * @param {function} [callback]
+ * @return {Promise} returns Promise if no callback passed
+ */
+const unwrapHandle = instrumentOperation(
+  defineOperation(kerberos.unwrapHandle, [
+    { name: 'handle', type: 'number' },
+    { name: 'challenge', type: 'string' },
+    { name: 'callback', type: 'function', required: false }
+  ]),
+  {
+    start: (target, args) => contextEvent('kerberos:ClientUnwrap', null, args[1]),
+    end: recordResultLength
+  }
+);
+
+/**
+ * Returns the current state of a context handle, with the same properties as a
+ * `KerberosClient` or `KerberosServer`, or `null` if the handle has been released.
+ *
+ * @kind function
+ * @param {number} handle A context handle
+ * @return {object|null}
+ */
+const handleInfo = kerberos.handleInfo;
+
+/**
+ * Releases a context handle and its native resources. If an operation is still running
+ * against the context, cleanup happens as soon as that operation completes.
+ *
+ * @kind function
+ * @param {number} handle A context handle
+ * @return {boolean} `false` if the handle was already released
+ */
+const releaseHandle = kerberos.releaseHandle;
+
+/**
+ * Returns the number of live handles and the allocated capacity of the native context tables.
+ *
+ * @kind function
+ * @return {object} `{ clients: { live, capacity }, servers: { live, capacity } }`
+ */
+const handleTableStats = kerberos.handleTableStats;
+
+/**
+ * Maps a Kerberos principal to a local account name, following the `auth_to_local` rules of the
+ * Kerberos configuration. The configuration is only loaded once, and mappings are kept in a
+ * bounded in-memory LRU cache, so this is cheap to call for every connection.
+ *
+ * @kind function
+ * @param {string} principal The principal to map, in the form 'user@REALM'
+ * @return {string|null} The local name, or `null` if the principal has no local name
+ */
+const toLocalName = kerberos.toLocalName;
+
+/**
+ * Returns latency statistics for every native operation run so far, keyed by operation under
+ * `operations`. Operations dispatched to the threadpool (e.g. `kerberos:ClientStep`) report the
+ * time spent waiting for a thread (`queue`), the CPU time of the thread running them (`cpu`),
+ * their duration (`wall`) and the time until the event loop ran their callback (`completion`);
+ * the underlying GSSAPI entry points (e.g. `authenticate_gss_client_step`) report `cpu` and
+ * `wall`. Each is summarized as `{ count, mean, p50, p99, p999, max }` with durations in
+ * milliseconds.
+ *
+ * `threadpool` reports the configured threadpool `size`, the number of operations currently
+ * `queued` for a thread, `executing` on one, or `completing` (waiting for the event loop), the
+ * highest number ever queued (`maxQueued`), and the number `dispatched` and `completed` in total.
+ * `executing` staying at `size` while `queued` grows means the threadpool is saturated.
+ *
+ * @kind function
+ * @param {object} [options] Optional settings
+ * @param {string} [options.format] Set to `prometheus` to return the statistics in the Prometheus text exposition format
+ * @return {object|string}
+ */
+function stats(options) {
+  const snapshot = kerberos.stats();
+  if (options && options.format === 'prometheus') {
+    return formatPrometheus(snapshot);
+  }
+
+  return snapshot;
+}
+
+/**
+ * Clears all latency statistics and threadpool counters.
+ *
+ * @kind function
+ */
+const resetStats = kerberos.resetStats;
+
+/**
+ * Returns the number of live native objects, and the bytes of native memory held for them,
+ * for `clients`, `servers`, security `contexts` and cached `credentials`, each as
+ * `{ live, bytes }`. The memory held by GSSAPI for contexts and credentials is opaque, so a
+ * fixed estimate is used for each. The same total is reported to V8 as external memory so that
+ * garbage collection keeps up with native allocations, and is returned as `external`.
+ * `arenaAllocations` counts the heap blocks allocated for the per-operation storage of
+ * contexts, which stops growing once live contexts have warmed up.
+ *
+ * @kind function
+ * @return {object}
+ */
+const memoryUsage = kerberos.memoryUsage;
+
+/**
+ * Enables or disables capturing Kerberos library trace output (the lines written to the file
+ * named by `KRB5_TRACE`) into a fixed-size in-memory buffer. Each line is tagged with the
+ * operation that produced it, so the exchanges behind one slow `checkPassword` or
+ * `principalDetails` call can be inspected with `dumpTrace`. Tracing of the GSSAPI mechanism
+ * itself still requires `KRB5_TRACE`. Disabling capture discards the buffered lines.
+ *
+ * @kind function
+ * @param {boolean} enabled Whether to capture trace output
+ */
+const setTraceEnabled = kerberos.setTraceEnabled;
+
+/**
+ * Returns the captured trace lines, oldest first, as objects of the form
+ * `{ operationId, operation, elapsed, message }` where `elapsed` is the time in milliseconds
+ * since the first captured line of the same operation. Errors raised by an operation carry its
+ * id as `operationId`.
+ *
+ * @kind function
+ * @param {number} [operationId] Only return the lines of this operation
+ * @return {object[]}
+ */
+const dumpTrace = kerberos.dumpTrace;
+
+/**
+ * Enables or disables recording a `PerformanceMeasure` (named after the operation, e.g.
+ * `kerberos:ClientStep`) for every native operation, with the same `detail` as the
+ * `kerberos:operation:end` diagnostics channel event. Measures are buffered in the performance
+ * timeline until cleared, so this is disabled by default.
+ *
+ * @kind function
+ * @param {boolean} enabled Whether to record performance entries
+ */
+const setPerformanceEntries = diagnostics.setPerformanceEntries;
 
 module.exports = {
   initializeClient,
   initializeServer,
   principalDetails,
   checkPassword,
+  toLocalName,
+  stats,
+  resetStats,
+  memoryUsage,
+  setTraceEnabled,
+  dumpTrace,
+  setPerformanceEntries,
+  SaslSecurityLayer,
+
+  // handle-based contexts
+  initializeClientHandle,
+  initializeServerHandle,
+  stepHandle,
+  wrapHandle,
+  unwrapHandle,
+  handleInfo,
+  releaseHandle,
+  handleTableStats,
 
   // gss flags
   GSS_C_DELEG_FLAG,
@@ -0,0 +1,176 @@
+'use strict';
+const Duplex = require('stream').Duplex;
+
+const FRAME_HEADER_LENGTH = 4;
+const DEFAULT_MAX_BUFFER_SIZE = 65536;
+
+/**
+ * The data channel of a SASL GSSAPI security layer (RFC 4752), once `saslStep` has negotiated
+ * integrity (`qop: 'auth-int'`) or confidentiality (`qop: 'auth-conf'`) with the server. Data
+ * written to the stream is split into chunks which fit the server's buffer, wrapped, and written
+ * to `socket` as length-prefixed frames; frames read from `socket` are unwrapped and can be read
+ * from the stream.
+ *
+ * Writes queued while the socket is busy are wrapped together in a single native call, and so
+ * are all of the complete frames received at once. The socket's backpressure is honoured in both
+ * directions: writes complete once the socket has taken the frames, and the socket is paused
+ * while the stream's readable buffer is full.
+ *
+ * The client's security context is used by one operation at a time, and shouldn't be used for
+ * anything else while the stream is open.
+ *
+ * @example
+ * const layer = new SaslSecurityLayer(client, socket);
+ * layer.write(request);
+ * layer.on('data', reply => {});
+ */
+class SaslSecurityLayer extends Duplex {
+  /**
+   * @param {KerberosClient} client A client whose `saslStep` negotiated a security layer
+   * @param {net.Socket} socket The connection to the server
+   * @param {object} [options] Options passed on to `stream.Duplex`
+   * @param {number} [options.maxBufferSize=65536] The `maxBufferSize` passed to `saslStep`, incoming frames larger than this are an error
+   */
+  constructor(client, socket, options) {
+    options = options || {};
+    super(Object.assign({}, options, { decodeStrings: true, objectMode: false }));
+    this.maxBufferSize =
+      typeof options.maxBufferSize === 'number' ? options.maxBufferSize : DEFAULT_MAX_BUFFER_SIZE;
+
+    this._client = client;
+    this._socket = socket;
+    this._operations = [];
+    this._received = [];
+    this._receivedLength = 0;
+    this._unwrapping = false;
+    this._socketEnded = false;
+
+    socket.on('data', chunk => this._onData(chunk));
+    socket.on('end', () => {
+      this._socketEnded = true;
+      this._maybeUnwrap();
+    });
+    socket.on('error', err => this.destroy(err));
+    socket.on('close', () => {
+      if (!this._socketEnded) this.destroy();
+    });
+  }
+
+  _write(chunk, encoding, callback) {
+    this._writev([{ chunk, encoding }], callback);
+  }
+
+  _writev(chunks, callback) {
+    const data =
+      chunks.length === 1 ? chunks[0].chunk : Buffer.concat(chunks.map(entry => entry.chunk));
+
+    this._native('_saslWrap', data, (err, frames) => {
+      if (err) return callback(err);
+      if (this._socket.write(frames)) return callback();
+      this._socket.once('drain', () => callback());
+    });
+  }
+
+  _final(callback) {
+    this._socket.end(callback);
+  }
+
+  _read() {
+    if (this._socket.isPaused()) {
+      this._socket.resume();
+    }
+  }
+
+  _destroy(err, callback) {
+    this._operations = [];
+    this._received = [];
+    this._socket.destroy();
+    callback(err);
+  }
+
+  _onData(chunk) {
+    this._received.push(chunk);
+    this._receivedLength += chunk.length;
+    this._maybeUnwrap();
+  }
+
+  // Unwraps every complete frame received so far, unless that is already in progress
+  _maybeUnwrap() {
+    if (this._unwrapping || this.destroyed) return;
+
+    const frameLength = this._nextFrameLength();
+    if (frameLength > this.maxBufferSize) {
+      return this.destroy(new Error('SASL frame exceeds the negotiated maximum buffer size'));
+    }
+
+    if (frameLength === -1 || this._receivedLength < FRAME_HEADER_LENGTH + frameLength) {
+      if (this._socketEnded) {
+        if (this._receivedLength > 0) {
+          return this.destroy(new Error('The connection ended in the middle of a SASL frame'));
+        }
+
+        this.push(null);
+      }
+
+      return;
+    }
+
+    const data = this._received.length === 1 ? this._received[0] : Buffer.concat(this._received);
+    this._received = [];
+    this._receivedLength = 0;
+    this._unwrapping = true;
+
+    this._native('_saslUnwrap', data, (err, plaintext, consumed) => {
+      this._unwrapping = false;
+      if (err) return this.destroy(err);
+
+      if (consumed < data.length) {
+        const rest = data.slice(consumed);
+        this._received.unshift(rest);
+        this._receivedLength += rest.length;
+      }
+
+      if (plaintext.length > 0 && !this.push(plaintext)) {
+        this._socket.pause();
+      }
+
+      this._maybeUnwrap();
+    });
+  }
+
+  _nextFrameLength() {
+    if (this._receivedLength < FRAME_HEADER_LENGTH) return -1;
+
+    let header = this._received[0];
+    if (header.length < FRAME_HEADER_LENGTH) {
+      header = Buffer.concat(this._received, FRAME_HEADER_LENGTH);
+    }
+
+    return header.readUInt32BE(0);
+  }
+
+  // The client's context is not safe for concurrent use, so native calls from both directions
+  // are run one at a time
+  _native(method, data, callback) {
+    this._operations.push({ method, data, callback });
+    if (this._operations.length === 1) {
+      this._runNext();
+    }
+  }
+
+  _runNext() {
+    const operation = this._operations[0];
+    if (operation == null) return;
+
+    this._client[operation.method](operation.data, (err, result, consumed) => {
+      this._operations.shift();
+      if (!this.destroyed) {
+        operation.callback(err, result, consumed);
+      }
+
+      this._runNext();
+    });
+  }
+}
+
+module.exports = { SaslSecurityLayer };
@@ -0,0 +1,69 @@
+'use strict';
+
+const PHASES = ['queue', 'cpu', 'wall', 'completion'];
+const THREADPOOL_GAUGES = [
+  ['size', 'size', 'Number of libuv threadpool threads'],
+  ['queued', 'queued', 'Operations waiting for a threadpool thread'],
+  ['executing', 'executing', 'Operations running on a threadpool thread'],
+  ['completing', 'completing', 'Operations waiting for the event loop to run their callback'],
+  ['maxQueued', 'max_queued', 'Highest number of operations waiting for a threadpool thread']
+];
+const THREADPOOL_COUNTERS = [
+  ['dispatched', 'dispatched_total', 'Operations dispatched to the threadpool'],
+  ['completed', 'completed_total', 'Operations whose callback has run']
+];
+const QUANTILES = [['0.5', 'p50'], ['0.99', 'p99'], ['0.999', 'p999']];
+
+function escapeLabel(value) {
+  return String(value)
+    .replace(/\\/g, '\\\\')
+    .replace(/"/g, '\\"')
+    .replace(/\n/g, '\\n');
+}
+
+/**
+ * Formats a stats snapshot in the Prometheus text exposition format, as a summary per
+ * operation and phase with durations in seconds, followed by the threadpool gauges and counters.
+ *
+ * @private
+ * @param {object} snapshot the result of the native `stats` method
+ * @return {string}
+ */
+function formatPrometheus(snapshot) {
+  const name = 'kerberos_operation_duration_seconds';
+  const lines = [
+    `# HELP ${name} Latency of native kerberos operations, by phase`,
+    `# TYPE ${name} summary`
+  ];
+
+  const operations = snapshot.operations;
+  Object.keys(operations).forEach(operation => {
+    PHASES.forEach(phase => {
+      const summary = operations[operation][phase];
+      if (summary == null) return;
+
+      const labels = `operation="${escapeLabel(operation)}",phase="${phase}"`;
+      QUANTILES.forEach(quantile => {
+        const value = summary[quantile[1]] / 1000;
+        lines.push(`${name}{${labels},quantile="${quantile[0]}"} ${value}`);
+      });
+
+      lines.push(`${name}_sum{${labels}} ${(summary.mean * summary.count) / 1000}`);
+      lines.push(`${name}_count{${labels}} ${summary.count}`);
+    });
+  });
+
+  const threadpool = snapshot.threadpool;
+  const metric = (spec, type) => {
+    const metricName = `kerberos_threadpool_${spec[1]}`;
+    lines.push(`# HELP ${metricName} ${spec[2]}`);
+    lines.push(`# TYPE ${metricName} ${type}`);
+    lines.push(`${metricName} ${threadpool[spec[0]]}`);
+  };
+
+  THREADPOOL_GAUGES.forEach(spec => metric(spec, 'gauge'));
+  THREADPOOL_COUNTERS.forEach(spec => metric(spec, 'counter'));
+  return lines.join('\n') + '\n';
+}
+
+module.exports = { formatPrometheus };
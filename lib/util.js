@@ -44,13 +44,19 @@ function defineOperation(fn, paramDefs) {
       const def = paramDefs[i];
       let arg = args[argIdx];
 
+      // special case to allow `options` to be optional. A function in its place is the
+      // callback, so it is left for the parameters which follow.
+      if (def.name === 'options' && typeof arg === 'function') {
+        arg = undefined;
+        argIdx--;
+      }
+
       if (def.hasOwnProperty('default') && arg == null) arg = def.default;
       if (def.type === 'object' && def.default != null) {
         arg = Object.assign({}, def.default, arg);
       }
 
-      // special case to allow `options` to be optional
-      if (def.name === 'options' && (typeof arg === 'function' || arg == null)) {
+      if (def.name === 'options' && arg == null) {
         arg = {};
       }
 
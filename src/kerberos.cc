@@ -1,14 +1,49 @@
 #include "kerberos.h"
+#include "kerberos_challenge.h"
 #include "kerberos_worker.h"
 
+#include <map>
+
+// The properties are defined up front, in a fixed order, so that setting them on an instance
+// doesn't change its shape
+static v8::Local<v8::ObjectTemplate> StepResultTemplate(const char* last,
+                                                       v8::Local<v8::Value> initial) {
+    v8::Local<v8::ObjectTemplate> tpl = Nan::New<v8::ObjectTemplate>();
+    Nan::SetTemplate(tpl, "response", Nan::Null());
+    Nan::SetTemplate(tpl, "complete", Nan::False());
+    Nan::SetTemplate(tpl, "username", Nan::Null());
+    Nan::SetTemplate(tpl, last, initial);
+    return tpl;
+}
+
+static v8::Local<v8::Value> StringOrNull(const char* value) {
+    if (value == NULL) {
+        return Nan::Null();
+    }
+
+    return Nan::New(value).ToLocalChecked();
+}
+
 /// KerberosClient
 Nan::Persistent<v8::Function> KerberosClient::constructor;
+Nan::Persistent<v8::ObjectTemplate> KerberosClient::step_result_template;
 NAN_MODULE_INIT(KerberosClient::Init) {
     v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>();
     tpl->SetClassName(Nan::New("KerberosClient").ToLocalChecked());
     Nan::SetPrototypeMethod(tpl, "step", Step);
     Nan::SetPrototypeMethod(tpl, "wrap", WrapData);
     Nan::SetPrototypeMethod(tpl, "unwrap", UnwrapData);
+    Nan::SetPrototypeMethod(tpl, "getMic", GetMic);
+    Nan::SetPrototypeMethod(tpl, "getMics", GetMics);
+    Nan::SetPrototypeMethod(tpl, "verifyMic", VerifyMic);
+    Nan::SetPrototypeMethod(tpl, "verifyMics", VerifyMics);
+    Nan::SetPrototypeMethod(tpl, "wrapOverhead", WrapOverhead);
+    Nan::SetPrototypeMethod(tpl, "wrapInto", WrapInto);
+    Nan::SetPrototypeMethod(tpl, "unwrapInPlace", UnwrapInPlace);
+    Nan::SetPrototypeMethod(tpl, "saslStep", SaslStep);
+    Nan::SetPrototypeMethod(tpl, "_saslWrap", SaslWrap);
+    Nan::SetPrototypeMethod(tpl, "_saslUnwrap", SaslUnwrap);
+    Nan::SetPrototypeMethod(tpl, "destroy", Destroy);
 
     v8::Local<v8::ObjectTemplate> itpl = tpl->InstanceTemplate();
     itpl->SetInternalFieldCount(1);
@@ -20,6 +55,7 @@ NAN_MODULE_INIT(KerberosClient::Init) {
     Nan::SetAccessor(
         itpl, Nan::New("contextComplete").ToLocalChecked(), KerberosClient::ContextCompleteGetter);
 
+    step_result_template.Reset(StepResultTemplate("responseConf", Nan::New(0)));
     constructor.Reset(Nan::GetFunction(tpl).ToLocalChecked());
     Nan::Set(target,
              Nan::New("KerberosClient").ToLocalChecked(),
@@ -35,42 +71,102 @@ v8::Local<v8::Object> KerberosClient::NewInstance(krb_client_state* state) {
     return scope.Escape(object);
 }
 
-KerberosClient::KerberosClient(krb_client_state* state) : _state(state) {}
+KerberosClient::KerberosClient(krb_client_state* state)
+    : _state(state), _pending(0), _destroy_pending(false) {}
 
 krb_client_state* KerberosClient::state() const {
     return _state;
 }
 
+v8::Local<v8::Object> KerberosClient::StepResult() const {
+    Nan::EscapableHandleScope scope;
+    v8::Local<v8::Object> result =
+        Nan::NewInstance(Nan::New(step_result_template)).ToLocalChecked();
+    Nan::Set(result, Nan::New("response").ToLocalChecked(), StringOrNull(_state->response));
+    Nan::Set(result, Nan::New("complete").ToLocalChecked(), Nan::New(_state->context_complete));
+    Nan::Set(
+        result, Nan::New("username").ToLocalChecked(), StringOrNull(ClientUserName(_state, true)));
+    Nan::Set(result, Nan::New("responseConf").ToLocalChecked(), Nan::New(_state->responseConf));
+    return scope.Escape(result);
+}
+
+bool KerberosClient::BeginOperation() {
+    if (_state == NULL || _destroy_pending) {
+        Nan::ThrowError("KerberosClient has been destroyed");
+        return false;
+    }
+
+    if (_pending > 0) {
+        Nan::ThrowError("KerberosClient already has an operation in progress");
+        return false;
+    }
+
+    // the worker refers to this object, keep it from being collected until the operation ends
+    Ref();
+    _pending++;
+    return true;
+}
+
+void KerberosClient::EndOperation() {
+    if (--_pending == 0 && _destroy_pending) {
+        _destroy_pending = false;
+        ReleaseState();
+    }
+
+    Unref();
+}
+
+NAN_METHOD(KerberosClient::Destroy) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    if (client->_state == NULL) {
+        return;
+    }
+
+    if (client->_pending > 0) {
+        client->_destroy_pending = true;
+        return;
+    }
+
+    client->ReleaseState();
+}
+
+// Once destroyed, a context reads as empty
 NAN_GETTER(KerberosClient::UserNameGetter) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    (client->state()->username == NULL)
-        ? info.GetReturnValue().Set(Nan::Null())
-        : info.GetReturnValue().Set(Nan::New(client->state()->username).ToLocalChecked());
+    const char* username =
+        (client->state() != NULL) ? ClientUserName(client->state(), client->_pending == 0) : NULL;
+    (username == NULL) ? info.GetReturnValue().Set(Nan::Null())
+                       : info.GetReturnValue().Set(Nan::New(username).ToLocalChecked());
 }
 
 NAN_GETTER(KerberosClient::ResponseGetter) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    (client->state()->response == NULL)
+    (client->state() == NULL || client->state()->response == NULL)
         ? info.GetReturnValue().Set(Nan::Null())
         : info.GetReturnValue().Set(Nan::New(client->state()->response).ToLocalChecked());
 }
 
 NAN_GETTER(KerberosClient::ResponseConfGetter) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    info.GetReturnValue().Set(Nan::New(client->state()->responseConf));
+    info.GetReturnValue().Set(
+        Nan::New(client->state() != NULL ? client->state()->responseConf : 0));
 }
 
 NAN_GETTER(KerberosClient::ContextCompleteGetter) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    info.GetReturnValue().Set(Nan::New(client->state()->context_complete));
+    info.GetReturnValue().Set(
+        Nan::New(client->state() != NULL && client->state()->context_complete));
 }
 
 /// KerberosServer
 Nan::Persistent<v8::Function> KerberosServer::constructor;
+Nan::Persistent<v8::ObjectTemplate> KerberosServer::step_result_template;
 NAN_MODULE_INIT(KerberosServer::Init) {
     v8::Local<v8::FunctionTemplate> tpl = Nan::New<v8::FunctionTemplate>();
     tpl->SetClassName(Nan::New("KerberosServer").ToLocalChecked());
     Nan::SetPrototypeMethod(tpl, "step", Step);
+    Nan::SetPrototypeMethod(tpl, "localName", LocalName);
+    Nan::SetPrototypeMethod(tpl, "destroy", Destroy);
 
     v8::Local<v8::ObjectTemplate> itpl = tpl->InstanceTemplate();
     itpl->SetInternalFieldCount(1);
@@ -82,6 +178,7 @@ NAN_MODULE_INIT(KerberosServer::Init) {
     Nan::SetAccessor(
         itpl, Nan::New("contextComplete").ToLocalChecked(), KerberosServer::ContextCompleteGetter);
 
+    step_result_template.Reset(StepResultTemplate("targetName", Nan::Null()));
     constructor.Reset(Nan::GetFunction(tpl).ToLocalChecked());
     Nan::Set(target,
              Nan::New("KerberosServer").ToLocalChecked(),
@@ -97,38 +194,278 @@ v8::Local<v8::Object> KerberosServer::NewInstance(krb_server_state* state) {
     return scope.Escape(object);
 }
 
-KerberosServer::KerberosServer(krb_server_state* state) : _state(state) {}
+KerberosServer::KerberosServer(krb_server_state* state)
+    : _state(state), _pending(0), _destroy_pending(false) {}
 
 krb_server_state* KerberosServer::state() const {
     return _state;
 }
 
+v8::Local<v8::Object> KerberosServer::StepResult() const {
+    Nan::EscapableHandleScope scope;
+    v8::Local<v8::Object> result =
+        Nan::NewInstance(Nan::New(step_result_template)).ToLocalChecked();
+    Nan::Set(result, Nan::New("response").ToLocalChecked(), StringOrNull(_state->response));
+    Nan::Set(result, Nan::New("complete").ToLocalChecked(), Nan::New(_state->context_complete));
+    Nan::Set(
+        result, Nan::New("username").ToLocalChecked(), StringOrNull(ServerUserName(_state, true)));
+    Nan::Set(result,
+             Nan::New("targetName").ToLocalChecked(),
+             StringOrNull(ServerTargetName(_state, true)));
+    return scope.Escape(result);
+}
+
+bool KerberosServer::BeginOperation() {
+    if (_state == NULL || _destroy_pending) {
+        Nan::ThrowError("KerberosServer has been destroyed");
+        return false;
+    }
+
+    if (_pending > 0) {
+        Nan::ThrowError("KerberosServer already has an operation in progress");
+        return false;
+    }
+
+    // the worker refers to this object, keep it from being collected until the operation ends
+    Ref();
+    _pending++;
+    return true;
+}
+
+void KerberosServer::EndOperation() {
+    if (--_pending == 0 && _destroy_pending) {
+        _destroy_pending = false;
+        ReleaseState();
+    }
+
+    Unref();
+}
+
+NAN_METHOD(KerberosServer::Destroy) {
+    KerberosServer* server = Nan::ObjectWrap::Unwrap<KerberosServer>(info.This());
+    if (server->_state == NULL) {
+        return;
+    }
+
+    if (server->_pending > 0) {
+        server->_destroy_pending = true;
+        return;
+    }
+
+    server->ReleaseState();
+}
+
 NAN_GETTER(KerberosServer::UserNameGetter) {
     KerberosServer* server = Nan::ObjectWrap::Unwrap<KerberosServer>(info.This());
-    (server->_state->username == NULL)
-        ? info.GetReturnValue().Set(Nan::Null())
-        : info.GetReturnValue().Set(Nan::New((char*)server->_state->username).ToLocalChecked());
+    const char* username =
+        (server->_state != NULL) ? ServerUserName(server->_state, server->_pending == 0) : NULL;
+    (username == NULL) ? info.GetReturnValue().Set(Nan::Null())
+                       : info.GetReturnValue().Set(Nan::New(username).ToLocalChecked());
 }
 
 NAN_GETTER(KerberosServer::ResponseGetter) {
     KerberosServer* server = Nan::ObjectWrap::Unwrap<KerberosServer>(info.This());
-    (server->_state->response == NULL)
+    (server->_state == NULL || server->_state->response == NULL)
         ? info.GetReturnValue().Set(Nan::Null())
         : info.GetReturnValue().Set(Nan::New((char*)server->_state->response).ToLocalChecked());
 }
 
 NAN_GETTER(KerberosServer::TargetNameGetter) {
     KerberosServer* server = Nan::ObjectWrap::Unwrap<KerberosServer>(info.This());
-    (server->_state->targetname == NULL)
-        ? info.GetReturnValue().Set(Nan::Null())
-        : info.GetReturnValue().Set(Nan::New((char*)server->_state->targetname).ToLocalChecked());
+    const char* targetname =
+        (server->_state != NULL) ? ServerTargetName(server->_state, server->_pending == 0) : NULL;
+    (targetname == NULL) ? info.GetReturnValue().Set(Nan::Null())
+                         : info.GetReturnValue().Set(Nan::New(targetname).ToLocalChecked());
 }
 
 NAN_GETTER(KerberosServer::ContextCompleteGetter) {
     KerberosServer* server = Nan::ObjectWrap::Unwrap<KerberosServer>(info.This());
-    info.GetReturnValue().Set(Nan::New(server->_state->context_complete));
+    info.GetReturnValue().Set(Nan::New(server->_state != NULL && server->_state->context_complete));
+}
+
+static v8::Local<v8::Object> HistogramSummary(const KerberosHistogram& histogram) {
+    // histograms are recorded in nanoseconds, and reported in milliseconds
+    const double scale = 1e-6;
+    KerberosHistogram::Summary summary = histogram.Summarize();
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("count").ToLocalChecked(), Nan::New<v8::Number>((double)summary.count));
+    Nan::Set(result, Nan::New("mean").ToLocalChecked(), Nan::New<v8::Number>(summary.mean * scale));
+    Nan::Set(result, Nan::New("p50").ToLocalChecked(), Nan::New<v8::Number>(summary.p50 * scale));
+    Nan::Set(result, Nan::New("p99").ToLocalChecked(), Nan::New<v8::Number>(summary.p99 * scale));
+    Nan::Set(result, Nan::New("p999").ToLocalChecked(), Nan::New<v8::Number>(summary.p999 * scale));
+    Nan::Set(result, Nan::New("max").ToLocalChecked(), Nan::New<v8::Number>(summary.max * scale));
+    return result;
+}
+
+NAN_METHOD(Stats) {
+    v8::Local<v8::Object> operations = Nan::New<v8::Object>();
+    for (KerberosOperationStats* stats : KerberosStatsAll()) {
+        if (stats->wall.count() == 0) {
+            continue;
+        }
+
+        v8::Local<v8::Object> operation = Nan::New<v8::Object>();
+        if (stats->queue.count() != 0) {
+            Nan::Set(operation, Nan::New("queue").ToLocalChecked(), HistogramSummary(stats->queue));
+        }
+        Nan::Set(operation, Nan::New("cpu").ToLocalChecked(), HistogramSummary(stats->cpu));
+        Nan::Set(operation, Nan::New("wall").ToLocalChecked(), HistogramSummary(stats->wall));
+        if (stats->completion.count() != 0) {
+            Nan::Set(operation,
+                     Nan::New("completion").ToLocalChecked(),
+                     HistogramSummary(stats->completion));
+        }
+        Nan::Set(operations, Nan::New(stats->name).ToLocalChecked(), operation);
+    }
+
+    KerberosThreadpoolStats& pool = KerberosThreadpool();
+    v8::Local<v8::Object> threadpool = Nan::New<v8::Object>();
+    const std::pair<const char*, double> gauges[] = {
+        {"size", KerberosThreadpoolSize()},
+        {"queued", (double)pool.queued.load()},
+        {"executing", (double)pool.executing.load()},
+        {"completing", (double)pool.completing.load()},
+        {"maxQueued", (double)pool.max_queued.load()},
+        {"dispatched", (double)pool.dispatched.load()},
+        {"completed", (double)pool.completed.load()}};
+    for (const auto& gauge : gauges) {
+        Nan::Set(threadpool, Nan::New(gauge.first).ToLocalChecked(), Nan::New(gauge.second));
+    }
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("operations").ToLocalChecked(), operations);
+    Nan::Set(result, Nan::New("threadpool").ToLocalChecked(), threadpool);
+    info.GetReturnValue().Set(result);
+}
+
+void KerberosMemoryReport() {
+    int64_t delta = KerberosMemoryUnreported();
+    if (delta != 0) {
+        Nan::AdjustExternalMemory((int)delta);
+    }
+}
+
+NAN_METHOD(MemoryUsage) {
+    static const char* const kinds[KERBEROS_MEMORY_KINDS] = {
+        "clients", "servers", "contexts", "credentials"};
+
+    KerberosMemoryReport();
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    for (int kind = 0; kind < KERBEROS_MEMORY_KINDS; ++kind) {
+        KerberosMemoryUsage usage = KerberosMemoryUsageOf((KerberosMemoryKind)kind);
+        v8::Local<v8::Object> counts = Nan::New<v8::Object>();
+        Nan::Set(counts,
+                 Nan::New("live").ToLocalChecked(),
+                 Nan::New<v8::Number>((double)usage.live));
+        Nan::Set(counts,
+                 Nan::New("bytes").ToLocalChecked(),
+                 Nan::New<v8::Number>((double)usage.bytes));
+        Nan::Set(result, Nan::New(kinds[kind]).ToLocalChecked(), counts);
+    }
+
+    Nan::Set(result,
+             Nan::New("external").ToLocalChecked(),
+             Nan::New<v8::Number>((double)KerberosMemoryReported()));
+    Nan::Set(result,
+             Nan::New("arenaAllocations").ToLocalChecked(),
+             Nan::New<v8::Number>((double)KerberosMemoryArenaAllocations()));
+    info.GetReturnValue().Set(result);
 }
 
+NAN_METHOD(ResetStats) {
+    KerberosStatsReset();
+}
+
+NAN_METHOD(SetTraceEnabled) {
+    bool enabled = Nan::To<bool>(info[0]).FromJust();
+    KerberosTraceSetEnabled(enabled);
+    if (!enabled) {
+        KerberosTraceClear();
+    }
+}
+
+NAN_METHOD(DumpTrace) {
+    uint64_t operation_id = 0;
+    if (info[0]->IsNumber()) {
+        operation_id = (uint64_t)Nan::To<double>(info[0]).FromJust();
+        if (operation_id == 0) {
+            info.GetReturnValue().Set(Nan::New<v8::Array>());
+            return;
+        }
+    }
+
+    // timings are reported relative to the first retained line of each operation
+    std::map<uint64_t, uint64_t> started_at;
+    std::vector<KerberosTraceEntry> entries = KerberosTraceDump(operation_id);
+    v8::Local<v8::Array> result = Nan::New<v8::Array>((int)entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const KerberosTraceEntry& entry = entries[i];
+        uint64_t start = started_at.emplace(entry.operation_id, entry.timestamp).first->second;
+
+        v8::Local<v8::Object> line = Nan::New<v8::Object>();
+        Nan::Set(line,
+                 Nan::New("operationId").ToLocalChecked(),
+                 Nan::New<v8::Number>((double)entry.operation_id));
+        Nan::Set(line,
+                 Nan::New("operation").ToLocalChecked(),
+                 entry.operation != NULL
+                     ? v8::Local<v8::Value>(Nan::New(entry.operation).ToLocalChecked())
+                     : v8::Local<v8::Value>(Nan::Null()));
+        Nan::Set(line,
+                 Nan::New("elapsed").ToLocalChecked(),
+                 Nan::New<v8::Number>((entry.timestamp - start) / 1e6));
+        Nan::Set(line,
+                 Nan::New("message").ToLocalChecked(),
+                 Nan::New(entry.message).ToLocalChecked());
+        Nan::Set(result, (uint32_t)i, line);
+    }
+
+    info.GetReturnValue().Set(result);
+}
+
+#ifdef KERBEROS_BENCH
+// Times getting a token from JS onto the threadpool, the way the operations hand a challenge to
+// their worker closure, with `Nan::Utf8String` and a `std::string` versus `KerberosChallenge`.
+// Returns the mean in nanoseconds of each.
+NAN_METHOD(BenchmarkChallenge) {
+    v8::Local<v8::Value> value = info[0];
+    uint32_t iterations = Nan::To<uint32_t>(info[1]).FromMaybe(1000);
+    size_t checksum = 0;
+
+    uint64_t start = KerberosMonotonicNanos();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        std::string challenge(*Nan::Utf8String(value));
+        KerberosWorker::ExecuteHandler handler = [=](KerberosWorker::SetOnFinishedHandler) {
+            (void)challenge.c_str();
+        };
+        KerberosWorker::ExecuteHandler queued = handler;
+        checksum += challenge.size();
+    }
+    uint64_t utf8 = KerberosMonotonicNanos() - start;
+
+    start = KerberosMonotonicNanos();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(value);
+        KerberosWorker::ExecuteHandler handler = [=](KerberosWorker::SetOnFinishedHandler) {
+            (void)challenge->c_str();
+        };
+        KerberosWorker::ExecuteHandler queued = handler;
+        checksum -= challenge->size();
+    }
+    uint64_t one_byte = KerberosMonotonicNanos() - start;
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    Nan::Set(result,
+             Nan::New("utf8Ns").ToLocalChecked(),
+             Nan::New<v8::Number>((double)utf8 / iterations));
+    Nan::Set(result,
+             Nan::New("oneByteNs").ToLocalChecked(),
+             Nan::New<v8::Number>((double)one_byte / iterations));
+    Nan::Set(result, Nan::New("consistent").ToLocalChecked(), Nan::New(checksum == 0));
+    info.GetReturnValue().Set(result);
+}
+#endif
+
 NAN_METHOD(TestMethod) {
     std::string string(*Nan::Utf8String(info[0]));
     bool shouldError = Nan::To<bool>(info[1]).FromJust();
@@ -143,6 +480,10 @@ NAN_METHOD(TestMethod) {
     }
 
     KerberosWorker::Run(callback, "kerberos:TestMethod", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        if (KerberosTraceEnabled()) {
+            KerberosTraceRecord(string.c_str(), string.size());
+        }
+
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
             if (shouldError) {
@@ -173,9 +514,66 @@ static NAN_MODULE_INIT(Init) {
     Nan::Set(target,
              Nan::New("checkPassword").ToLocalChecked(),
              Nan::GetFunction(Nan::New<v8::FunctionTemplate>(CheckPassword)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("toLocalName").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(ToLocalName)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("initializeClientHandle").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(InitializeClientHandle)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("initializeServerHandle").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(InitializeServerHandle)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("stepHandle").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(StepHandle)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("wrapHandle").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(WrapHandle)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("unwrapHandle").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(UnwrapHandle)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("handleInfo").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(HandleInfo)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("releaseHandle").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(ReleaseHandle)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("handleTableStats").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(HandleTableStats)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("stats").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(Stats)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("resetStats").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(ResetStats)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("memoryUsage").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(MemoryUsage)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("setTraceEnabled").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(SetTraceEnabled)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("dumpTrace").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(DumpTrace)).ToLocalChecked());
     Nan::Set(target,
              Nan::New("_testMethod").ToLocalChecked(),
              Nan::GetFunction(Nan::New<v8::FunctionTemplate>(TestMethod)).ToLocalChecked());
+
+#ifdef KERBEROS_BENCH
+    Nan::Set(target,
+             Nan::New("_benchmarkChallenge").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(BenchmarkChallenge)).ToLocalChecked());
+#endif
+
+#ifdef KERBEROS_GSS_MOCK
+    Nan::Set(target,
+             Nan::New("_configureMock").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(ConfigureMock)).ToLocalChecked());
+    Nan::Set(target,
+             Nan::New("_mockCalls").ToLocalChecked(),
+             Nan::GetFunction(Nan::New<v8::FunctionTemplate>(MockCalls)).ToLocalChecked());
+#endif
 }
 
 NODE_MODULE(kerberos, Init)
@@ -11,8 +11,13 @@ class KerberosServer : public Nan::ObjectWrap {
 
     krb_server_state* state() const;
 
+    // The `{ response, complete, username, targetName }` a step resolves to with the `details`
+    // option. Every result is created from the same template, so they all share a hidden class.
+    v8::Local<v8::Object> StepResult() const;
+
    private:
     static Nan::Persistent<v8::Function> constructor;
+    static Nan::Persistent<v8::ObjectTemplate> step_result_template;
 
     static NAN_GETTER(UserNameGetter);
     static NAN_GETTER(ResponseGetter);
@@ -20,12 +25,25 @@ class KerberosServer : public Nan::ObjectWrap {
     static NAN_GETTER(ContextCompleteGetter);
 
     static NAN_METHOD(Step);
+    static NAN_METHOD(LocalName);
+    static NAN_METHOD(Destroy);
 
    private:
     explicit KerberosServer(krb_server_state* server_state);
     ~KerberosServer();
 
+    // Throws and returns false if the context has been destroyed or another operation is still
+    // running against it (a GSS context and its result slot can only serve one operation at a
+    // time), otherwise counts an operation and holds a reference to the object until
+    // `EndOperation`, which releases the context if it was destroyed in the meantime
+    bool BeginOperation();
+    void EndOperation();
+    // Cleans up the context and returns its state to the pool (platform specific)
+    void ReleaseState();
+
     krb_server_state* _state;
+    uint32_t _pending;
+    bool _destroy_pending;
 };
 
 class KerberosClient : public Nan::ObjectWrap {
@@ -35,8 +53,12 @@ class KerberosClient : public Nan::ObjectWrap {
 
     krb_client_state* state() const;
 
+    // `{ response, complete, username, responseConf }`, see `KerberosServer`
+    v8::Local<v8::Object> StepResult() const;
+
    private:
     static Nan::Persistent<v8::Function> constructor;
+    static Nan::Persistent<v8::ObjectTemplate> step_result_template;
 
     static NAN_GETTER(UserNameGetter);
     static NAN_GETTER(ResponseGetter);
@@ -46,20 +68,75 @@ class KerberosClient : public Nan::ObjectWrap {
     static NAN_METHOD(Step);
     static NAN_METHOD(UnwrapData);
     static NAN_METHOD(WrapData);
+    static NAN_METHOD(GetMic);
+    static NAN_METHOD(GetMics);
+    static NAN_METHOD(VerifyMic);
+    static NAN_METHOD(VerifyMics);
+    static NAN_METHOD(WrapOverhead);
+    static NAN_METHOD(WrapInto);
+    static NAN_METHOD(UnwrapInPlace);
+    static NAN_METHOD(SaslStep);
+    static NAN_METHOD(SaslWrap);
+    static NAN_METHOD(SaslUnwrap);
+    static NAN_METHOD(Destroy);
 
    private:
     explicit KerberosClient(krb_client_state* client_state);
     ~KerberosClient();
 
+    // See `KerberosServer`
+    bool BeginOperation();
+    void EndOperation();
+    void ReleaseState();
+
+    // The single message and batch forms of `getMic` and `verifyMic` (platform specific)
+    static void GetMicOperation(const Nan::FunctionCallbackInfo<v8::Value>& info, bool batch);
+    static void VerifyMicOperation(const Nan::FunctionCallbackInfo<v8::Value>& info, bool batch);
+
     krb_client_state* _state;
+    uint32_t _pending;
+    bool _destroy_pending;
 };
 
 NAN_METHOD(PrincipalDetails);
 NAN_METHOD(InitializeClient);
 NAN_METHOD(InitializeServer);
 NAN_METHOD(CheckPassword);
+NAN_METHOD(ToLocalName);
+
+// Handle-based contexts, which live in a native table instead of being wrapped by JS objects
+NAN_METHOD(InitializeClientHandle);
+NAN_METHOD(InitializeServerHandle);
+NAN_METHOD(StepHandle);
+NAN_METHOD(WrapHandle);
+NAN_METHOD(UnwrapHandle);
+NAN_METHOD(HandleInfo);
+NAN_METHOD(ReleaseHandle);
+NAN_METHOD(HandleTableStats);
+
+// Latency statistics, shared by all platforms
+NAN_METHOD(Stats);
+NAN_METHOD(ResetStats);
+
+// Native memory accounting, shared by all platforms
+NAN_METHOD(MemoryUsage);
+
+// krb5 trace capture, shared by all platforms
+NAN_METHOD(SetTraceEnabled);
+NAN_METHOD(DumpTrace);
+
+#ifdef KERBEROS_GSS_MOCK
+// Latency and fault injection of the mock GSSAPI backend, see `unix/kerberos_gss_mock.h`
+NAN_METHOD(ConfigureMock);
+NAN_METHOD(MockCalls);
+#endif
 
 // NOTE: explicitly used for unit testing `defineOperation`, not meant to be exported
 NAN_METHOD(TestMethod);
 
+#ifdef KERBEROS_BENCH
+// Compares the ways of copying a token out of JS, see `bench/challenge_copy.js`
+NAN_METHOD(BenchmarkChallenge);
+#endif
+
 #endif  // KERBEROS_NATIVE_EXTENSION_H
@@ -0,0 +1,75 @@
+#include "kerberos_challenge.h"
+
+#include <string.h>
+
+#include <mutex>
+
+// Buffers are kept for reuse up to these limits, enough for the tokens in flight on a busy
+// threadpool without holding on to the occasional very large one
+#define CHALLENGE_POOL_SIZE 64
+#define CHALLENGE_POOL_MAX_BYTES (64 * 1024)
+
+static std::mutex pool_mutex;
+static std::vector<KerberosChallenge*> pool;
+
+std::shared_ptr<KerberosChallenge> KerberosChallenge::From(v8::Local<v8::Value> value) {
+    KerberosChallenge* challenge = NULL;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (!pool.empty()) {
+            challenge = pool.back();
+            pool.pop_back();
+        }
+    }
+
+    if (challenge == NULL) {
+        challenge = new KerberosChallenge();
+    }
+
+    if (value->IsString() && value.As<v8::String>()->IsOneByte()) {
+        v8::Local<v8::String> string = value.As<v8::String>();
+        int length = string->Length();
+        if (challenge->_data.size() < (size_t)length + 1) {
+            challenge->_data.resize(length + 1);
+        }
+
+#if NODE_MAJOR_VERSION >= 11
+        string->WriteOneByte(v8::Isolate::GetCurrent(),
+                             (uint8_t*)challenge->_data.data(),
+                             0,
+                             length,
+                             v8::String::NO_NULL_TERMINATION);
+#else
+        string->WriteOneByte(
+            (uint8_t*)challenge->_data.data(), 0, length, v8::String::NO_NULL_TERMINATION);
+#endif
+        challenge->_size = length;
+    } else {
+        Nan::Utf8String utf8(value);
+        size_t length = (*utf8 != NULL) ? utf8.length() : 0;
+        if (challenge->_data.size() < length + 1) {
+            challenge->_data.resize(length + 1);
+        }
+
+        if (length > 0) {
+            memcpy(challenge->_data.data(), *utf8, length);
+        }
+        challenge->_size = length;
+    }
+
+    challenge->_data[challenge->_size] = '\0';
+    return std::shared_ptr<KerberosChallenge>(challenge, Recycle);
+}
+
+// The last reference to a challenge can be dropped on any thread
+void KerberosChallenge::Recycle(KerberosChallenge* challenge) {
+    if (challenge->_data.size() <= CHALLENGE_POOL_MAX_BYTES) {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (pool.size() < CHALLENGE_POOL_SIZE) {
+            pool.push_back(challenge);
+            return;
+        }
+    }
+
+    delete challenge;
+}
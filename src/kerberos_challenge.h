@@ -0,0 +1,38 @@
+#ifndef KERBEROS_CHALLENGE_H
+#define KERBEROS_CHALLENGE_H
+
+#include <nan.h>
+
+#include <memory>
+#include <vector>
+
+// A base64 token passed from JS (a challenge, or data to wrap/unwrap), copied on the main thread
+// so that it can be decoded on the threadpool. Base64 is always a one-byte V8 string, whose
+// contents are copied with a single `WriteOneByte` into a pooled buffer; that avoids the UTF-8
+// transcode and the `std::string` copy of `Nan::Utf8String`, and the buffer copies of capturing a
+// string in the worker closures, which only share the pointer. Other one-byte characters are
+// copied as Latin-1, which makes no difference since they aren't valid base64 either way, and
+// anything else is transcoded to UTF-8 as before.
+class KerberosChallenge {
+   public:
+    // Must be called on the main thread
+    static std::shared_ptr<KerberosChallenge> From(v8::Local<v8::Value> value);
+
+    const char* c_str() const {
+        return _data.data();
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+   private:
+    KerberosChallenge() : _size(0) {}
+
+    static void Recycle(KerberosChallenge* challenge);
+
+    std::vector<char> _data;
+    size_t _size;
+};
+
+#endif  // KERBEROS_CHALLENGE_H
@@ -9,18 +9,52 @@
 typedef gss_client_state krb_client_state;
 typedef gss_server_state krb_server_state;
 typedef gss_result krb_result;
+
+// Peer names are resolved lazily by the GSS backend. Resolving reads the context, so while an
+// operation on it is running on the threadpool (`idle` is false) only an already resolved name
+// is returned.
+inline const char* ClientUserName(krb_client_state* state, bool idle) {
+  return idle ? authenticate_gss_client_username(state) : state->username;
+}
+
+inline const char* ServerUserName(krb_server_state* state, bool idle) {
+  return idle ? authenticate_gss_server_username(state) : state->username;
+}
+
+inline const char* ServerTargetName(krb_server_state* state, bool idle) {
+  return idle ? authenticate_gss_server_targetname(state) : state->targetname;
+}
+
+// Provide a default custom deleter for the `gss_result` type
+inline void ResultDeleter(krb_result* result) {
+  gss_result_free(result);
+}
 #else
 #include "win32/kerberos_sspi.h"
 
 typedef sspi_client_state krb_client_state;
 typedef sspi_server_state krb_server_state;
 typedef sspi_result krb_result;
-#endif
 
-// Provide a default custom delter for the `gss_result` type
+inline const char* ClientUserName(krb_client_state* state, bool idle) {
+  return state->username;
+}
+
+inline const char* ServerUserName(krb_server_state* state, bool idle) {
+  return (const char*)state->username;
+}
+
+inline const char* ServerTargetName(krb_server_state* state, bool idle) {
+  return state->targetname;
+}
+
+// Provide a default custom deleter for the `sspi_result` type
 inline void ResultDeleter(krb_result* result) {
+  free(result->message);
   free(result);
 }
+#endif
+
 
 // Useful methods for optional value handling
 NAN_INLINE std::string StringOptionValue(v8::Local<v8::Object> options, const char* _key) {
@@ -55,4 +89,34 @@ NAN_INLINE uint32_t UInt32OptionValue(v8::Local<v8::Object> options,
     return value->Uint32Value(Nan::GetCurrentContext()).FromJust();
 }
 
+NAN_INLINE bool BooleanOptionValue(v8::Local<v8::Object> options, const char* _key, bool def) {
+    Nan::HandleScope scope;
+    v8::Local<v8::String> key = Nan::New(_key).ToLocalChecked();
+    if (options.IsEmpty() || !Nan::Has(options, key).FromMaybe(false)) {
+      return def;
+    }
+
+    v8::Local<v8::Value> value = Nan::Get(options, key).ToLocalChecked();
+    if (!value->IsBoolean()) {
+      return def;
+    }
+
+    return Nan::To<bool>(value).FromJust();
+}
+
+NAN_INLINE double NumberOptionValue(v8::Local<v8::Object> options, const char* _key, double def) {
+    Nan::HandleScope scope;
+    v8::Local<v8::String> key = Nan::New(_key).ToLocalChecked();
+    if (options.IsEmpty() || !Nan::Has(options, key).FromMaybe(false)) {
+      return def;
+    }
+
+    v8::Local<v8::Value> value = Nan::Get(options, key).ToLocalChecked();
+    if (!value->IsNumber()) {
+      return def;
+    }
+
+    return Nan::To<double>(value).FromJust();
+}
+
 #endif
@@ -0,0 +1,201 @@
+#ifndef KERBEROS_CONTEXT_TABLE_H
+#define KERBEROS_CONTEXT_TABLE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+// A handle packs a slot index, the generation of the slot when it was handed out, and a tag
+// identifying which table it belongs to. Handles are exposed to JavaScript as numbers, so they
+// are kept within the 53 bits a double can represent exactly.
+#define CONTEXT_HANDLE_INDEX_BITS 24
+#define CONTEXT_HANDLE_GENERATION_BITS 28
+#define CONTEXT_HANDLE_INDEX_MASK ((1ULL << CONTEXT_HANDLE_INDEX_BITS) - 1)
+#define CONTEXT_HANDLE_GENERATION_MASK ((1ULL << CONTEXT_HANDLE_GENERATION_BITS) - 1)
+#define CONTEXT_HANDLE_TAG_SHIFT (CONTEXT_HANDLE_INDEX_BITS + CONTEXT_HANDLE_GENERATION_BITS)
+
+#define CONTEXT_HANDLE_TAG_CLIENT 0
+#define CONTEXT_HANDLE_TAG_SERVER 1
+
+inline uint32_t ContextHandleTag(uint64_t handle) {
+    return (uint32_t)(handle >> CONTEXT_HANDLE_TAG_SHIFT);
+}
+
+// Fixed-capacity slabs of inline context states, addressed by integer handles rather than by
+// JavaScript objects. Slabs are never moved or freed once allocated, so a state pointer handed
+// to a worker thread stays valid while the slot is pinned. All other bookkeeping (allocation,
+// lookup, release) happens on the main thread and needs no locking.
+template <typename State>
+class ContextTable {
+   public:
+    typedef void (*CleanupHandler)(State* state);
+
+    static const uint32_t kSlabSize = 4096;
+
+    ContextTable(uint32_t tag, CleanupHandler cleanup)
+        : _tag(tag), _cleanup(cleanup), _free_head(kNoSlot), _live(0) {}
+
+    // Returns a zeroed state for a new context and writes its handle, or NULL if the table is
+    // full. A zeroed state is safe to clean up, so a slot can be released whether or not its
+    // initialization succeeded. The slot starts out pinned, call `Unpin` once initialization has
+    // completed.
+    State* Allocate(uint64_t* handle) {
+        if (_free_head == kNoSlot && !Grow()) {
+            return NULL;
+        }
+
+        uint32_t index = _free_head;
+        Slot* slot = SlotAt(index);
+        _free_head = slot->next_free;
+
+        memset(&slot->state, 0, sizeof(State));
+        slot->next_free = kNoSlot;
+        slot->in_use = true;
+        slot->release_pending = false;
+        slot->pins = 1;
+        _live++;
+
+        *handle = MakeHandle(index, slot->generation);
+        return &slot->state;
+    }
+
+    // Returns the state for a live handle, or NULL if the handle is stale, released, or belongs
+    // to a different table.
+    State* Lookup(uint64_t handle) {
+        Slot* slot = Resolve(handle);
+        return (slot == NULL || slot->release_pending) ? NULL : &slot->state;
+    }
+
+    // Like `Lookup`, but also keeps the slot from being recycled until `Unpin` is called. Used
+    // to hand a state to a worker thread. A state serves one operation at a time, so this also
+    // returns NULL while the slot is already pinned, use `Lookup` to tell that apart from a
+    // handle which isn't live.
+    State* Pin(uint64_t handle) {
+        Slot* slot = Resolve(handle);
+        if (slot == NULL || slot->release_pending || slot->pins > 0) {
+            return NULL;
+        }
+
+        slot->pins++;
+        return &slot->state;
+    }
+
+    // Whether no operation is running against a live handle's state
+    bool Idle(uint64_t handle) {
+        Slot* slot = Resolve(handle);
+        return slot != NULL && slot->pins == 0;
+    }
+
+    void Unpin(uint64_t handle) {
+        Slot* slot = Resolve(handle);
+        if (slot == NULL || slot->pins == 0) {
+            return;
+        }
+
+        if (--slot->pins == 0 && slot->release_pending) {
+            Recycle(handle);
+        }
+    }
+
+    // Releases a context. If an operation is still running against it, cleanup is deferred until
+    // that operation completes. Returns false if the handle was not live.
+    bool Release(uint64_t handle) {
+        Slot* slot = Resolve(handle);
+        if (slot == NULL || slot->release_pending) {
+            return false;
+        }
+
+        slot->release_pending = true;
+        if (slot->pins == 0) {
+            Recycle(handle);
+        }
+
+        return true;
+    }
+
+    uint32_t live() const {
+        return _live;
+    }
+
+    uint32_t capacity() const {
+        return (uint32_t)_slabs.size() * kSlabSize;
+    }
+
+   private:
+    static const uint32_t kNoSlot = 0xFFFFFFFF;
+
+    struct Slot {
+        State state;
+        uint32_t generation;
+        uint32_t next_free;
+        uint32_t pins;
+        bool in_use;
+        bool release_pending;
+    };
+
+    uint64_t MakeHandle(uint32_t index, uint32_t generation) const {
+        return ((uint64_t)_tag << CONTEXT_HANDLE_TAG_SHIFT) |
+               ((uint64_t)generation << CONTEXT_HANDLE_INDEX_BITS) | index;
+    }
+
+    Slot* SlotAt(uint32_t index) {
+        return &_slabs[index / kSlabSize][index % kSlabSize];
+    }
+
+    Slot* Resolve(uint64_t handle) {
+        if (ContextHandleTag(handle) != _tag) {
+            return NULL;
+        }
+
+        uint32_t index = (uint32_t)(handle & CONTEXT_HANDLE_INDEX_MASK);
+        uint32_t generation =
+            (uint32_t)((handle >> CONTEXT_HANDLE_INDEX_BITS) & CONTEXT_HANDLE_GENERATION_MASK);
+        if (index >= capacity()) {
+            return NULL;
+        }
+
+        Slot* slot = SlotAt(index);
+        return (slot->in_use && slot->generation == generation) ? slot : NULL;
+    }
+
+    void Recycle(uint64_t handle) {
+        uint32_t index = (uint32_t)(handle & CONTEXT_HANDLE_INDEX_MASK);
+        Slot* slot = SlotAt(index);
+        _cleanup(&slot->state);
+
+        slot->in_use = false;
+        slot->generation = (slot->generation + 1) & CONTEXT_HANDLE_GENERATION_MASK;
+        slot->next_free = _free_head;
+        _free_head = index;
+        _live--;
+    }
+
+    bool Grow() {
+        uint32_t base = capacity();
+        if (base + kSlabSize > CONTEXT_HANDLE_INDEX_MASK + 1) {
+            return false;
+        }
+
+        std::unique_ptr<Slot[]> slab(new Slot[kSlabSize]);
+        for (uint32_t i = 0; i < kSlabSize; ++i) {
+            slab[i].generation = 0;
+            slab[i].pins = 0;
+            slab[i].in_use = false;
+            slab[i].next_free = (i + 1 < kSlabSize) ? base + i + 1 : _free_head;
+        }
+
+        _slabs.push_back(std::move(slab));
+        _free_head = base;
+        return true;
+    }
+
+    uint32_t _tag;
+    CleanupHandler _cleanup;
+    uint32_t _free_head;
+    uint32_t _live;
+    std::vector<std::unique_ptr<Slot[]>> _slabs;
+};
+
+#endif  // KERBEROS_CONTEXT_TABLE_H
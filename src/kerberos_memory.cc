@@ -0,0 +1,58 @@
+#include "kerberos_memory.h"
+
+#include <atomic>
+
+struct MemoryCounters {
+    std::atomic<int64_t> live;
+    std::atomic<int64_t> bytes;
+};
+
+static MemoryCounters counters[KERBEROS_MEMORY_KINDS];
+static std::atomic<int64_t> total_bytes(0);
+static std::atomic<uint64_t> arena_allocations(0);
+static int64_t reported_bytes = 0;  // only touched on the main thread
+
+void KerberosMemoryAllocated(KerberosMemoryKind kind, size_t bytes) {
+    counters[kind].live.fetch_add(1, std::memory_order_relaxed);
+    KerberosMemoryResized(kind, (int64_t)bytes);
+}
+
+void KerberosMemoryFreed(KerberosMemoryKind kind, size_t bytes) {
+    counters[kind].live.fetch_sub(1, std::memory_order_relaxed);
+    KerberosMemoryResized(kind, -(int64_t)bytes);
+}
+
+void KerberosMemoryResized(KerberosMemoryKind kind, int64_t delta) {
+    if (delta == 0) {
+        return;
+    }
+
+    counters[kind].bytes.fetch_add(delta, std::memory_order_relaxed);
+    total_bytes.fetch_add(delta, std::memory_order_relaxed);
+}
+
+KerberosMemoryUsage KerberosMemoryUsageOf(KerberosMemoryKind kind) {
+    KerberosMemoryUsage usage;
+    usage.live = counters[kind].live.load(std::memory_order_relaxed);
+    usage.bytes = counters[kind].bytes.load(std::memory_order_relaxed);
+    return usage;
+}
+
+void KerberosMemoryArenaAllocated() {
+    arena_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t KerberosMemoryArenaAllocations() {
+    return arena_allocations.load(std::memory_order_relaxed);
+}
+
+int64_t KerberosMemoryReported() {
+    return reported_bytes;
+}
+
+int64_t KerberosMemoryUnreported() {
+    int64_t total = total_bytes.load(std::memory_order_relaxed);
+    int64_t delta = total - reported_bytes;
+    reported_bytes = total;
+    return delta;
+}
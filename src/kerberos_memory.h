@@ -0,0 +1,45 @@
+#ifndef KERBEROS_MEMORY_H
+#define KERBEROS_MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Native allocations made on behalf of JS objects which V8 can't see, tracked so they can be
+// reported to the garbage collector and exposed for capacity planning.
+enum KerberosMemoryKind {
+    KERBEROS_MEMORY_CLIENTS = 0,
+    KERBEROS_MEMORY_SERVERS,
+    KERBEROS_MEMORY_CONTEXTS,
+    KERBEROS_MEMORY_CREDENTIALS,
+    KERBEROS_MEMORY_KINDS
+};
+
+struct KerberosMemoryUsage {
+    int64_t live;
+    int64_t bytes;
+};
+
+// Safe to call from any thread
+void KerberosMemoryAllocated(KerberosMemoryKind kind, size_t bytes);
+void KerberosMemoryFreed(KerberosMemoryKind kind, size_t bytes);
+void KerberosMemoryResized(KerberosMemoryKind kind, int64_t delta);
+
+KerberosMemoryUsage KerberosMemoryUsageOf(KerberosMemoryKind kind);
+
+// Counts the heap blocks allocated by per-operation arenas (see `unix/kerberos_gss_arena.h`),
+// which stops increasing once the arenas of live contexts have grown to fit their operations
+void KerberosMemoryArenaAllocated();
+uint64_t KerberosMemoryArenaAllocations();
+
+// The number of bytes reported to V8 so far
+int64_t KerberosMemoryReported();
+
+// Returns the change in tracked memory since the last call and marks it as reported. Must be
+// called on the main thread.
+int64_t KerberosMemoryUnreported();
+
+// Reports the change in tracked memory since the last call to V8 with
+// `Nan::AdjustExternalMemory`. Must be called on the main thread.
+void KerberosMemoryReport();
+
+#endif  // KERBEROS_MEMORY_H
@@ -0,0 +1,39 @@
+#ifndef KERBEROS_PROBES_H
+#define KERBEROS_PROBES_H
+
+// USDT (SystemTap/bpftrace compatible) probes under the `kerberos` provider. A probe is a nop
+// in the instruction stream plus an ELF note describing its arguments, so there is no cost until
+// a tracer attaches. They are compiled out where `sys/sdt.h` is unavailable, or when
+// `KERBEROS_DISABLE_USDT` is defined (`node-gyp rebuild -- -Dkerberos_usdt=false`). List them
+// with `bpftrace -l 'usdt:<path to kerberos.node>:*'`.
+//
+//   worker_queue(id, operation)           worker_start(id, operation)
+//   worker_done(id, operation)            worker_complete(id, operation)
+//   client_step_entry(state, input_len)   client_step_return(state, major, minor, output_len)
+//   server_step_entry(state, input_len)   server_step_return(state, major, minor, output_len)
+//   wrap_entry(state, input_len)          wrap_return(state, major, minor, output_len)
+//   unwrap_entry(state, input_len)        unwrap_return(state, major, minor, output_len)
+//   get_mic_entry(state, input_len)       get_mic_return(state, major, minor, mic_len)
+//   verify_mic_entry(state, input_len)    verify_mic_return(state, major, minor, mic_len)
+//   base64_encode_entry(input_len)        base64_encode_return(output_len)
+//   base64_decode_entry(input_len)        base64_decode_return(output_len)
+
+#if defined(__linux__) && !defined(KERBEROS_DISABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define KERBEROS_HAVE_USDT 1
+#endif
+#endif
+
+#if defined(KERBEROS_HAVE_USDT)
+#include <sys/sdt.h>
+
+#define KERBEROS_PROBE1(name, a) DTRACE_PROBE1(kerberos, name, a)
+#define KERBEROS_PROBE2(name, a, b) DTRACE_PROBE2(kerberos, name, a, b)
+#define KERBEROS_PROBE4(name, a, b, c, d) DTRACE_PROBE4(kerberos, name, a, b, c, d)
+#else
+#define KERBEROS_PROBE1(name, a)
+#define KERBEROS_PROBE2(name, a, b)
+#define KERBEROS_PROBE4(name, a, b, c, d)
+#endif
+
+#endif  // KERBEROS_PROBES_H
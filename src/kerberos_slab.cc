@@ -0,0 +1,37 @@
+#include "kerberos_slab.h"
+
+#include <string.h>
+
+#define SLAB_SIZE (64 * 1024)
+// Outputs larger than this get a buffer of their own, so that no single output pins a slab
+#define SLAB_MAX_SLICE (SLAB_SIZE / 8)
+#define SLAB_ALIGNMENT 8
+
+static Nan::Persistent<v8::Object> slab;
+static size_t slab_offset = 0;
+
+v8::Local<v8::Object> KerberosSlabBuffer(const char* data, size_t length) {
+    Nan::EscapableHandleScope scope;
+    if (length > SLAB_MAX_SLICE) {
+        return scope.Escape(Nan::CopyBuffer(data, (uint32_t)length).ToLocalChecked());
+    }
+
+    if (slab.IsEmpty() || slab_offset + length > SLAB_SIZE) {
+        slab.Reset(Nan::NewBuffer(SLAB_SIZE).ToLocalChecked());
+        slab_offset = 0;
+    }
+
+    v8::Local<v8::Object> current = Nan::New(slab);
+    if (length > 0) {
+        memcpy(node::Buffer::Data(current) + slab_offset, data, length);
+    }
+
+    v8::Local<v8::Uint8Array> view = current.As<v8::Uint8Array>();
+    v8::Local<v8::Object> slice = node::Buffer::New(v8::Isolate::GetCurrent(),
+                                                    view->Buffer(),
+                                                    view->ByteOffset() + slab_offset,
+                                                    length)
+                                      .ToLocalChecked();
+    slab_offset = (slab_offset + length + SLAB_ALIGNMENT - 1) & ~(size_t)(SLAB_ALIGNMENT - 1);
+    return scope.Escape(slice);
+}
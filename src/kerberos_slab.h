@@ -0,0 +1,17 @@
+#ifndef KERBEROS_SLAB_H
+#define KERBEROS_SLAB_H
+
+#include <nan.h>
+
+// Copies an operation's output into a new `Buffer`. Small outputs become slices of a shared slab
+// which is replaced once full, like the pool behind `Buffer.allocUnsafe`, so a stream of them
+// costs one allocation per slab instead of one per output. A slab is freed once every slice of it
+// has been collected. Must be called on the main thread.
+//
+// Every slice's `buffer` is the whole slab, which holds the outputs of other operations on other
+// contexts, so this is only used for MICs and tokens which were wrapped with confidentiality.
+// Plaintext, including integrity-only wrap tokens which carry it, is always copied into a Buffer
+// of its own.
+v8::Local<v8::Object> KerberosSlabBuffer(const char* data, size_t length);
+
+#endif  // KERBEROS_SLAB_H
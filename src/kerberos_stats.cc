@@ -0,0 +1,208 @@
+#include "kerberos_stats.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <map>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define SUB_BUCKETS (1ULL << KERBEROS_HISTOGRAM_SUB_BUCKET_BITS)
+
+static int HighestBit(uint64_t value) {
+#if defined(_MSC_VER)
+    int bit = 63;
+    while (bit > 0 && !(value & (1ULL << bit))) {
+        bit--;
+    }
+    return bit;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+static size_t BucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return (size_t)value;
+    }
+
+    int bit = HighestBit(value);
+    if (bit >= KERBEROS_HISTOGRAM_MAX_BITS) {
+        return KERBEROS_HISTOGRAM_BUCKETS - 1;
+    }
+
+    int shift = bit - KERBEROS_HISTOGRAM_SUB_BUCKET_BITS;
+    uint64_t sub_bucket = (value >> shift) - SUB_BUCKETS;
+    return (size_t)(((uint64_t)(shift + 1) << KERBEROS_HISTOGRAM_SUB_BUCKET_BITS) + sub_bucket);
+}
+
+static double BucketMidpoint(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return (double)index;
+    }
+
+    int shift = (int)(index >> KERBEROS_HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    uint64_t sub_bucket = index & (SUB_BUCKETS - 1);
+    uint64_t lower = (SUB_BUCKETS + sub_bucket) << shift;
+    return (double)lower + (double)(1ULL << shift) / 2;
+}
+
+KerberosHistogram::KerberosHistogram() {
+    Reset();
+}
+
+void KerberosHistogram::Record(uint64_t value) {
+    _buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+void KerberosHistogram::Reset() {
+    for (size_t i = 0; i < KERBEROS_HISTOGRAM_BUCKETS; ++i) {
+        _buckets[i].store(0, std::memory_order_relaxed);
+    }
+
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+KerberosHistogram::Summary KerberosHistogram::Summarize() const {
+    Summary summary = {0, 0, 0, 0, 0, 0};
+    uint64_t counts[KERBEROS_HISTOGRAM_BUCKETS];
+    uint64_t total = 0;
+
+    // Take a copy first, recording may continue while we summarize
+    for (size_t i = 0; i < KERBEROS_HISTOGRAM_BUCKETS; ++i) {
+        counts[i] = _buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if (total == 0) {
+        return summary;
+    }
+
+    const double quantiles[] = {0.5, 0.99, 0.999};
+    double* targets[] = {&summary.p50, &summary.p99, &summary.p999};
+    uint64_t seen = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < KERBEROS_HISTOGRAM_BUCKETS && next < 3; ++i) {
+        seen += counts[i];
+        while (next < 3 && seen >= (uint64_t)ceil(quantiles[next] * total)) {
+            *targets[next++] = BucketMidpoint(i);
+        }
+    }
+
+    summary.count = total;
+    summary.mean = (double)_sum.load(std::memory_order_relaxed) / total;
+    summary.max = (double)_max.load(std::memory_order_relaxed);
+    return summary;
+}
+
+static std::mutex registry_mutex;
+static std::map<std::string, KerberosOperationStats*> registry_index;
+static std::vector<KerberosOperationStats*> registry;
+
+KerberosOperationStats* KerberosStatsFor(const char* name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto it = registry_index.find(name);
+    if (it != registry_index.end()) {
+        return it->second;
+    }
+
+    KerberosOperationStats* stats = new KerberosOperationStats(name);
+    registry_index[name] = stats;
+    registry.push_back(stats);
+    return stats;
+}
+
+std::vector<KerberosOperationStats*> KerberosStatsAll() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return registry;
+}
+
+void KerberosStatsReset() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (KerberosOperationStats* stats : registry) {
+        stats->queue.Reset();
+        stats->cpu.Reset();
+        stats->wall.Reset();
+        stats->completion.Reset();
+    }
+
+    // gauges reflect live operations and are left alone, the high water mark restarts from them
+    KerberosThreadpoolStats& pool = KerberosThreadpool();
+    pool.max_queued.store(pool.queued.load());
+    pool.dispatched.store(0);
+    pool.completed.store(0);
+}
+
+KerberosThreadpoolStats& KerberosThreadpool() {
+    static KerberosThreadpoolStats pool = {{0}, {0}, {0}, {0}, {0}, {0}};
+    return pool;
+}
+
+int KerberosThreadpoolSize() {
+    // mirrors libuv, which reads this once when the threadpool starts
+    const char* value = getenv("UV_THREADPOOL_SIZE");
+    int size = (value != NULL) ? atoi(value) : 4;
+    if (size < 1) {
+        size = 1;
+    }
+    if (size > 1024) {
+        size = 1024;
+    }
+
+    return size;
+}
+
+#if defined(_WIN32)
+uint64_t KerberosMonotonicNanos() {
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / frequency.QuadPart);
+}
+
+uint64_t KerberosThreadCpuNanos() {
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+
+    // FILETIME is in 100ns intervals
+    uint64_t kernel_time = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t user_time = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (kernel_time + user_time) * 100;
+}
+#else
+static uint64_t ClockNanos(clockid_t clock) {
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t KerberosMonotonicNanos() {
+    return ClockNanos(CLOCK_MONOTONIC);
+}
+
+uint64_t KerberosThreadCpuNanos() {
+    return ClockNanos(CLOCK_THREAD_CPUTIME_ID);
+}
+#endif
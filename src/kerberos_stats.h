@@ -0,0 +1,115 @@
+#ifndef KERBEROS_STATS_H
+#define KERBEROS_STATS_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Each power of two range of a histogram is split into this many linear buckets (as a power of
+// two), which bounds the relative error of a reported percentile to ~6%.
+#define KERBEROS_HISTOGRAM_SUB_BUCKET_BITS 4
+// Values are recorded in nanoseconds and clamped to 2^48 (about 78 hours)
+#define KERBEROS_HISTOGRAM_MAX_BITS 48
+#define KERBEROS_HISTOGRAM_BUCKETS                                                          \
+    ((KERBEROS_HISTOGRAM_MAX_BITS - KERBEROS_HISTOGRAM_SUB_BUCKET_BITS + 1)                 \
+     << KERBEROS_HISTOGRAM_SUB_BUCKET_BITS)
+
+// A log-linear latency histogram in the style of HdrHistogram. Recording is a handful of relaxed
+// atomic increments, so it is safe to record from any thread and cheap enough to leave on.
+class KerberosHistogram {
+   public:
+    struct Summary {
+        uint64_t count;
+        double mean;
+        double p50;
+        double p99;
+        double p999;
+        double max;
+    };
+
+    KerberosHistogram();
+
+    void Record(uint64_t value);
+    void Reset();
+
+    uint64_t count() const {
+        return _count.load(std::memory_order_relaxed);
+    }
+
+    // Percentiles are reported as the midpoint of the bucket they fall in, all values in the
+    // unit they were recorded in.
+    Summary Summarize() const;
+
+   private:
+    std::atomic<uint64_t> _buckets[KERBEROS_HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _max;
+};
+
+// Latency of one kind of operation, split into time spent waiting for a threadpool thread, CPU
+// time consumed by the thread running it, wall time from start to finish, and time from finishing
+// on the threadpool until the event loop ran its completion callback.
+struct KerberosOperationStats {
+    explicit KerberosOperationStats(const char* name) : name(name) {}
+
+    const std::string name;
+    KerberosHistogram queue;
+    KerberosHistogram cpu;
+    KerberosHistogram wall;
+    KerberosHistogram completion;
+};
+
+// Gauges and counters for operations dispatched to the libuv threadpool. An operation is
+// `queued` until a thread picks it up, `executing` while it runs, and `completing` until the
+// event loop has run its callback.
+struct KerberosThreadpoolStats {
+    std::atomic<int64_t> queued;
+    std::atomic<int64_t> executing;
+    std::atomic<int64_t> completing;
+    std::atomic<int64_t> max_queued;
+    std::atomic<uint64_t> dispatched;
+    std::atomic<uint64_t> completed;
+};
+
+KerberosThreadpoolStats& KerberosThreadpool();
+
+// The number of libuv threadpool threads, as configured by `UV_THREADPOOL_SIZE`
+int KerberosThreadpoolSize();
+
+// Returns the stats for the named operation, registering it on first use. The returned pointer
+// stays valid for the lifetime of the process.
+KerberosOperationStats* KerberosStatsFor(const char* name);
+
+// Every registered operation, in registration order
+std::vector<KerberosOperationStats*> KerberosStatsAll();
+
+void KerberosStatsReset();
+
+uint64_t KerberosMonotonicNanos();
+uint64_t KerberosThreadCpuNanos();
+
+// Records the CPU and wall time of the enclosing scope
+class KerberosStatsScope {
+   public:
+    explicit KerberosStatsScope(KerberosOperationStats* stats)
+        : _stats(stats), _start(KerberosMonotonicNanos()), _cpu_start(KerberosThreadCpuNanos()) {}
+
+    ~KerberosStatsScope() {
+        _stats->cpu.Record(KerberosThreadCpuNanos() - _cpu_start);
+        _stats->wall.Record(KerberosMonotonicNanos() - _start);
+    }
+
+   private:
+    KerberosOperationStats* _stats;
+    uint64_t _start;
+    uint64_t _cpu_start;
+};
+
+#define KERBEROS_STATS_SCOPE(name)                                                  \
+    static KerberosOperationStats* kerberos_scope_stats = KerberosStatsFor(name);   \
+    KerberosStatsScope kerberos_stats_scope(kerberos_scope_stats)
+
+#endif  // KERBEROS_STATS_H
@@ -0,0 +1,148 @@
+#include "kerberos_trace.h"
+
+#include <string.h>
+
+#include <atomic>
+
+#include "kerberos_stats.h"
+
+// A slot's sequence encodes the position of the line it holds, and is odd while that line is being
+// written, so readers can tell when a line has been overwritten underneath them. 0 is a slot which
+// was never written.
+struct TraceSlot {
+    std::atomic<uint64_t> sequence;
+    uint64_t operation_id;
+    const char* operation;
+    uint64_t timestamp;
+    uint32_t length;
+    char message[KERBEROS_TRACE_MESSAGE_SIZE];
+};
+
+static TraceSlot trace_slots[KERBEROS_TRACE_CAPACITY];
+static std::atomic<uint64_t> trace_head(0);
+static std::atomic<uint64_t> trace_floor(0);
+static std::atomic<uint64_t> trace_operation_ids(0);
+static std::atomic<bool> trace_enabled(false);
+
+static thread_local uint64_t current_operation_id = 0;
+static thread_local const char* current_operation = NULL;
+
+static uint64_t CommittedSequence(uint64_t position) {
+    return (position + 1) << 1;
+}
+
+static uint64_t WritingSequence(uint64_t position) {
+    return CommittedSequence(position) | 1;
+}
+
+uint64_t KerberosTraceNextOperationId() {
+    return ++trace_operation_ids;
+}
+
+KerberosTraceOperation::KerberosTraceOperation(uint64_t operation_id, const char* operation)
+    : _previous_id(current_operation_id), _previous_operation(current_operation) {
+    current_operation_id = operation_id;
+    current_operation = operation;
+}
+
+KerberosTraceOperation::~KerberosTraceOperation() {
+    current_operation_id = _previous_id;
+    current_operation = _previous_operation;
+}
+
+uint64_t KerberosTraceCurrentOperationId() {
+    return current_operation_id;
+}
+
+bool KerberosTraceEnabled() {
+    return trace_enabled.load(std::memory_order_relaxed);
+}
+
+void KerberosTraceSetEnabled(bool enabled) {
+    trace_enabled.store(enabled);
+}
+
+void KerberosTraceRecord(const char* message, size_t length) {
+    // krb5 terminates each line with a newline
+    while (length > 0 && (message[length - 1] == '\n' || message[length - 1] == '\r')) {
+        length--;
+    }
+    if (length > KERBEROS_TRACE_MESSAGE_SIZE) {
+        length = KERBEROS_TRACE_MESSAGE_SIZE;
+    }
+
+    uint64_t position = trace_head.fetch_add(1);
+    TraceSlot& slot = trace_slots[position % KERBEROS_TRACE_CAPACITY];
+
+    // Positions are distinct, but writers a multiple of `KERBEROS_TRACE_CAPACITY` apart share a
+    // slot. A writer only claims its slot from a committed line older than its own, so a slot
+    // has at most one writer at a time. Otherwise the slot is being written by another writer, or
+    // already holds a newer line, and this line is dropped rather than waited on. The claim
+    // acquires the previous writer's commit, so its stores to the payload come before ours.
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    do {
+        if ((sequence & 1) != 0 || sequence >= CommittedSequence(position)) {
+            return;
+        }
+    } while (!slot.sequence.compare_exchange_weak(sequence,
+                                                  WritingSequence(position),
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed));
+
+    // The payload is written with plain stores, readers validate their copy against the
+    // sequence afterwards and discard it if the slot was claimed in the meantime
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.operation_id = current_operation_id;
+    slot.operation = current_operation;
+    slot.timestamp = KerberosMonotonicNanos();
+    slot.length = (uint32_t)length;
+    memcpy(slot.message, message, length);
+    slot.sequence.store(CommittedSequence(position), std::memory_order_release);
+}
+
+std::vector<KerberosTraceEntry> KerberosTraceDump(uint64_t operation_id) {
+    std::vector<KerberosTraceEntry> entries;
+    uint64_t head = trace_head.load(std::memory_order_acquire);
+    uint64_t position = head > KERBEROS_TRACE_CAPACITY ? head - KERBEROS_TRACE_CAPACITY : 0;
+    uint64_t floor = trace_floor.load(std::memory_order_relaxed);
+    if (position < floor) {
+        position = floor;
+    }
+
+    for (; position < head; ++position) {
+        TraceSlot& slot = trace_slots[position % KERBEROS_TRACE_CAPACITY];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != CommittedSequence(position)) {
+            continue;  // still being written, or already overwritten
+        }
+
+        KerberosTraceEntry entry;
+        entry.operation_id = slot.operation_id;
+        entry.operation = slot.operation;
+        entry.timestamp = slot.timestamp;
+        char message[KERBEROS_TRACE_MESSAGE_SIZE];
+        uint32_t length = slot.length;
+        if (length > KERBEROS_TRACE_MESSAGE_SIZE) {
+            continue;
+        }
+        memcpy(message, slot.message, length);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;  // overwritten while it was being copied
+        }
+
+        if (operation_id != 0 && entry.operation_id != operation_id) {
+            continue;
+        }
+
+        entry.message.assign(message, length);
+        entries.push_back(entry);
+    }
+
+    return entries;
+}
+
+void KerberosTraceClear() {
+    trace_floor.store(trace_head.load());
+}
@@ -0,0 +1,55 @@
+#ifndef KERBEROS_TRACE_H
+#define KERBEROS_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Number of trace lines retained, older lines are overwritten as new ones are recorded
+#define KERBEROS_TRACE_CAPACITY 2048
+// Trace lines longer than this are truncated
+#define KERBEROS_TRACE_MESSAGE_SIZE 232
+
+struct KerberosTraceEntry {
+    uint64_t operation_id;
+    const char* operation;
+    uint64_t timestamp;
+    std::string message;
+};
+
+// Allocates a new operation id, ids are never reused and are never 0
+uint64_t KerberosTraceNextOperationId();
+
+// Marks the calling thread as working on behalf of an operation for the lifetime of the scope, so
+// trace lines recorded from it (and errors created on it) can be correlated with the operation.
+class KerberosTraceOperation {
+   public:
+    KerberosTraceOperation(uint64_t operation_id, const char* operation);
+    ~KerberosTraceOperation();
+
+   private:
+    uint64_t _previous_id;
+    const char* _previous_operation;
+};
+
+// The id of the operation the calling thread is working on, or 0 if there is none
+uint64_t KerberosTraceCurrentOperationId();
+
+bool KerberosTraceEnabled();
+void KerberosTraceSetEnabled(bool enabled);
+
+// Records a trace line for the current operation. Recording never blocks: each writer claims a
+// slot of the ring buffer, and drops its line if that slot is still being written by a writer
+// one or more laps of the ring behind, or was already claimed by one ahead. Readers skip lines
+// which are being written or were overwritten while they were copied.
+void KerberosTraceRecord(const char* message, size_t length);
+
+// Returns the retained trace lines, oldest first, restricted to one operation unless
+// `operation_id` is 0
+std::vector<KerberosTraceEntry> KerberosTraceDump(uint64_t operation_id);
+
+void KerberosTraceClear();
+
+#endif  // KERBEROS_TRACE_H
@@ -4,6 +4,11 @@
 #include <functional>
 #include <nan.h>
 
+#include "kerberos_memory.h"
+#include "kerberos_probes.h"
+#include "kerberos_stats.h"
+#include "kerberos_trace.h"
+
 class KerberosWorker : public Nan::AsyncWorker {
  public:
     typedef std::function<void(KerberosWorker*)>  OnFinishedHandler;
@@ -11,7 +16,20 @@ class KerberosWorker : public Nan::AsyncWorker {
     typedef std::function<void(SetOnFinishedHandler)> ExecuteHandler;
 
     explicit KerberosWorker(Nan::Callback *callback, const char* resource_name, ExecuteHandler handler)
-        : Nan::AsyncWorker(callback, resource_name), execute_handler(handler) {}
+        : Nan::AsyncWorker(callback, resource_name),
+          execute_handler(handler),
+          stats(KerberosStatsFor(resource_name)),
+          operation_id(KerberosTraceNextOperationId()),
+          queued_at(KerberosMonotonicNanos()),
+          finished_at(0) {
+        KerberosThreadpoolStats& pool = KerberosThreadpool();
+        int64_t queued = ++pool.queued;
+        int64_t max_queued = pool.max_queued.load(std::memory_order_relaxed);
+        while (queued > max_queued && !pool.max_queued.compare_exchange_weak(max_queued, queued)) {
+        }
+        pool.dispatched++;
+        KERBEROS_PROBE2(worker_queue, operation_id, stats->name.c_str());
+    }
 
     template <class... T>
     void Call(T... t) {
@@ -19,9 +37,27 @@ class KerberosWorker : public Nan::AsyncWorker {
     }
 
     virtual void Execute() {
+        KerberosThreadpoolStats& pool = KerberosThreadpool();
+        pool.queued--;
+        pool.executing++;
+
+        KerberosTraceOperation trace(operation_id, stats->name.c_str());
+        KERBEROS_PROBE2(worker_start, operation_id, stats->name.c_str());
+        uint64_t started_at = KerberosMonotonicNanos();
+        uint64_t cpu_started_at = KerberosThreadCpuNanos();
+        stats->queue.Record(started_at - queued_at);
+
         execute_handler([=] (OnFinishedHandler handler) {
             on_finished_handler = handler;
         });
+
+        finished_at = KerberosMonotonicNanos();
+        stats->cpu.Record(KerberosThreadCpuNanos() - cpu_started_at);
+        stats->wall.Record(finished_at - started_at);
+
+        pool.executing--;
+        pool.completing++;
+        KERBEROS_PROBE2(worker_done, operation_id, stats->name.c_str());
     }
 
     static void Run(Nan::Callback *callback, const char* resource_name, ExecuteHandler handler) {
@@ -37,12 +73,26 @@ class KerberosWorker : public Nan::AsyncWorker {
 
  protected:
     void HandleOKCallback() {
+        KerberosThreadpoolStats& pool = KerberosThreadpool();
+        stats->completion.Record(KerberosMonotonicNanos() - finished_at);
+        pool.completing--;
+        pool.completed++;
+        KERBEROS_PROBE2(worker_complete, operation_id, stats->name.c_str());
+
+        KerberosTraceOperation trace(operation_id, stats->name.c_str());
         on_finished_handler(this);
+
+        // states and credentials grow and shrink on the threadpool
+        KerberosMemoryReport();
     }
 
  private:
     ExecuteHandler execute_handler;
     OnFinishedHandler on_finished_handler;
+    KerberosOperationStats* stats;
+    uint64_t operation_id;
+    uint64_t queued_at;
+    uint64_t finished_at;
 };
 
 #endif // ASYNC_WORKER_H
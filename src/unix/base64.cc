@@ -15,6 +15,7 @@
  **/
 
 #include "base64.h"
+#include "../kerberos_probes.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -30,17 +31,15 @@ static signed char index_64[128] = {
     39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1};
 #define CHAR64(c) (((c) < 0 || (c) > 127) ? -1 : index_64[(c)])
 
-// base64_encode    :    base64 encode
+// base64_encode_into :    base64 encode into a caller provided buffer
 //
 // value            :    data to encode
 // vlen             :    length of data
-// (result)         :    new char[] - c-str of result
-char* base64_encode(const unsigned char* value, size_t vlen) {
-    char* result = (char*)malloc((vlen * 4) / 3 + 5);
-    if (result == NULL) {
-        return NULL;
-    }
-    char* out = result;
+// out              :    at least `base64_encoded_size(vlen)` bytes
+// (result)         :    length of the encoded c-str, excluding its terminator
+size_t base64_encode_into(const unsigned char* value, size_t vlen, char* out) {
+    KERBEROS_PROBE1(base64_encode_entry, vlen);
+    char* start = out;
     while (vlen >= 3) {
         *out++ = basis_64[value[0] >> 2];
         *out++ = basis_64[((value[0] << 4) & 0x30) | (value[1] >> 4)];
@@ -60,68 +59,95 @@ char* base64_encode(const unsigned char* value, size_t vlen) {
     }
     *out = '\0';
 
-    return result;
+    KERBEROS_PROBE1(base64_encode_return, out - start);
+    return out - start;
 }
 
-// base64_decode    :    base64 decode
+// base64_encode    :    base64 encode
 //
-// value            :    c-str to decode
-// rlen             :    length of decoded result
-// (result)         :    new unsigned char[] - decoded result
-unsigned char* base64_decode(const char* value, size_t* rlen) {
-    *rlen = 0;
-    int c1, c2, c3, c4;
-
-    size_t vlen = strlen(value);
-    unsigned char* result = (unsigned char*)malloc((vlen * 3) / 4 + 1);
+// value            :    data to encode
+// vlen             :    length of data
+// (result)         :    new char[] - c-str of result
+char* base64_encode(const unsigned char* value, size_t vlen) {
+    char* result = (char*)malloc(base64_encoded_size(vlen));
     if (result == NULL) {
         return NULL;
     }
-    unsigned char* out = result;
 
+    base64_encode_into(value, vlen, result);
+    return result;
+}
+
+// base64_decode_into :    base64 decode into a caller provided buffer
+//
+// value            :    c-str to decode
+// vlen             :    length of value
+// out              :    at least `base64_decoded_size(vlen)` bytes
+// (result)         :    length of the decoded result, 0 if value is not valid base64
+size_t base64_decode_into(const char* value, size_t vlen, unsigned char* out) {
+    size_t rlen = 0;
+    int c1, c2, c3, c4;
+    unsigned char* start = out;
+
+    KERBEROS_PROBE1(base64_decode_entry, vlen);
     while (1) {
         if (value[0] == 0) {
-            return result;
+            KERBEROS_PROBE1(base64_decode_return, rlen);
+            return rlen;
         }
         c1 = value[0];
         if (CHAR64(c1) == -1) {
             goto base64_decode_error;
-            ;
         }
         c2 = value[1];
         if (CHAR64(c2) == -1) {
             goto base64_decode_error;
-            ;
         }
         c3 = value[2];
         if ((c3 != '=') && (CHAR64(c3) == -1)) {
             goto base64_decode_error;
-            ;
         }
         c4 = value[3];
         if ((c4 != '=') && (CHAR64(c4) == -1)) {
             goto base64_decode_error;
-            ;
         }
 
         value += 4;
         *out++ = (CHAR64(c1) << 2) | (CHAR64(c2) >> 4);
-        *rlen += 1;
+        rlen += 1;
 
         if (c3 != '=') {
             *out++ = ((CHAR64(c2) << 4) & 0xf0) | (CHAR64(c3) >> 2);
-            *rlen += 1;
+            rlen += 1;
 
             if (c4 != '=') {
                 *out++ = ((CHAR64(c3) << 6) & 0xc0) | CHAR64(c4);
-                *rlen += 1;
+                rlen += 1;
             }
         }
     }
 
 base64_decode_error:
-    *result = 0;
+    *start = 0;
+    rlen = 0;
+
+    KERBEROS_PROBE1(base64_decode_return, rlen);
+    return rlen;
+}
+
+// base64_decode    :    base64 decode
+//
+// value            :    c-str to decode
+// rlen             :    length of decoded result
+// (result)         :    new unsigned char[] - decoded result
+unsigned char* base64_decode(const char* value, size_t* rlen) {
     *rlen = 0;
+    size_t vlen = strlen(value);
+    unsigned char* result = (unsigned char*)malloc(base64_decoded_size(vlen));
+    if (result == NULL) {
+        return NULL;
+    }
 
+    *rlen = base64_decode_into(value, vlen, result);
     return result;
 }
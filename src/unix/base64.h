@@ -18,7 +18,14 @@
 
 #include <stddef.h>
 
+// Buffer sizes needed by the `_into` variants, which let callers encode and decode into memory
+// they already own
+#define base64_encoded_size(vlen) (((vlen) + 2) / 3 * 4 + 1)
+#define base64_decoded_size(vlen) (((vlen) * 3) / 4 + 1)
+
 char* base64_encode(const unsigned char* value, size_t vlen);
 unsigned char* base64_decode(const char* value, size_t* rlen);
+size_t base64_encode_into(const unsigned char* value, size_t vlen, char* out);
+size_t base64_decode_into(const char* value, size_t vlen, unsigned char* out);
 
 #endif
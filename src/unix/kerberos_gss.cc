@@ -17,43 +17,225 @@
 #include "kerberos_gss.h"
 
 #include "base64.h"
+#include "kerberos_gss_localname.h"
+#include "../kerberos_memory.h"
+#include "../kerberos_probes.h"
+#include "../kerberos_stats.h"
+#include "../kerberos_trace.h"
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if !defined(__APPLE__)
+extern "C" {
+    #include <gssapi/gssapi_ext.h>
+}
+#endif
+
 #if defined(__clang__)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
 #endif
 
-static gss_result* gss_success_result(int ret);
-static gss_result* gss_error_result(OM_uint32 err_maj, OM_uint32 err_min);
-static gss_result* gss_error_result_with_message(const char* message);
-static gss_result* gss_error_result_with_message_and_code(const char* mesage, int code);
+// Results are written to the result slot of a state when one is given, otherwise allocated
+static gss_result* gss_success_result(gss_result* slot, int ret);
+static gss_result* gss_error_result(gss_result* slot, OM_uint32 err_maj, OM_uint32 err_min);
+static gss_result* gss_error_result_with_message(gss_result* slot, const char* message);
+static gss_result* gss_error_result_with_message_and_code(gss_result* slot,
+                                                          const char* mesage,
+                                                          int code);
+
+// Freed states are kept for the next context, up to this many of each kind, so that connection
+// churn doesn't go through the allocator
+#define GSS_STATE_POOL_SIZE 256
+
+static std::mutex state_pool_mutex;
+static std::vector<gss_client_state*> client_state_pool;
+static std::vector<gss_server_state*> server_state_pool;
+
+template <typename State>
+static State* gss_state_alloc(std::vector<State*>* pool) {
+    {
+        std::lock_guard<std::mutex> lock(state_pool_mutex);
+        if (!pool->empty()) {
+            State* state = pool->back();
+            pool->pop_back();
+            return state;
+        }
+    }
+
+    return (State*)malloc(sizeof(State));
+}
+
+template <typename State>
+static void gss_state_free(std::vector<State*>* pool, State* state) {
+    {
+        std::lock_guard<std::mutex> lock(state_pool_mutex);
+        if (pool->size() < GSS_STATE_POOL_SIZE) {
+            pool->push_back(state);
+            return;
+        }
+    }
+
+    free(state);
+}
 
 gss_client_state* gss_client_state_new() {
-    gss_client_state* state = (gss_client_state*)malloc(sizeof(gss_client_state));
+    gss_client_state* state = gss_state_alloc(&client_state_pool);
+    state->cached_creds = NULL;
     state->username = NULL;
     state->response = NULL;
     state->responseConf = 0;
+    state->output = NULL;
+    state->output_length = 0;
+    state->sasl_layer = 0;
+    state->sasl_max_send = 0;
+    state->sasl_max_receive = 0;
+    state->sasl_max_plaintext = 0;
     state->context_complete = false;
+    state->accounted_bytes = 0;
+    state->accounted_context = false;
+    gss_arena_init(&state->arena);
 
     return state;
 }
 
 gss_server_state* gss_server_state_new() {
-    gss_server_state* state = (gss_server_state*)malloc(sizeof(gss_server_state));
+    gss_server_state* state = gss_state_alloc(&server_state_pool);
     state->username = NULL;
     state->response = NULL;
     state->targetname = NULL;
     state->context_complete = false;
+    state->accounted_bytes = 0;
+    state->accounted_context = false;
+    gss_arena_init(&state->arena);
 
     return state;
 }
 
+void gss_client_state_free(gss_client_state* state) {
+    gss_state_free(&client_state_pool, state);
+}
+
+void gss_server_state_free(gss_server_state* state) {
+    gss_state_free(&server_state_pool, state);
+}
+
+static size_t gss_string_bytes(const char* string) {
+    return (string != NULL) ? strlen(string) + 1 : 0;
+}
+
+// A security context is opaque, this approximates what the krb5 mechanism holds for one (names,
+// session and subsession keys, sequence state and the replay cache entry).
+#define GSS_CONTEXT_ESTIMATED_BYTES 2048
+
+static void gss_context_account(bool* accounted, gss_ctx_id_t context) {
+    bool live = (context != GSS_C_NO_CONTEXT);
+    if (live && !*accounted) {
+        KerberosMemoryAllocated(KERBEROS_MEMORY_CONTEXTS, GSS_CONTEXT_ESTIMATED_BYTES);
+    } else if (!live && *accounted) {
+        KerberosMemoryFreed(KERBEROS_MEMORY_CONTEXTS, GSS_CONTEXT_ESTIMATED_BYTES);
+    }
+
+    *accounted = live;
+}
+
+static void gss_state_account(KerberosMemoryKind kind, size_t* accounted, size_t bytes) {
+    if (*accounted == 0) {
+        KerberosMemoryAllocated(kind, bytes);
+    } else {
+        KerberosMemoryResized(kind, (int64_t)bytes - (int64_t)*accounted);
+    }
+
+    *accounted = bytes;
+}
+
+static void gss_state_unaccount(KerberosMemoryKind kind, size_t* accounted) {
+    if (*accounted != 0) {
+        KerberosMemoryFreed(kind, *accounted);
+        *accounted = 0;
+    }
+}
+
+// Brings the memory accounting for a state in line with what it currently holds, called whenever
+// its context or strings change
+static void gss_client_state_account(gss_client_state* state) {
+    size_t bytes = sizeof(gss_client_state) + gss_string_bytes(state->username) +
+                   gss_arena_heap_bytes(&state->arena);
+    gss_state_account(KERBEROS_MEMORY_CLIENTS, &state->accounted_bytes, bytes);
+    gss_context_account(&state->accounted_context, state->context);
+}
+
+static void gss_server_state_account(gss_server_state* state) {
+    size_t bytes = sizeof(gss_server_state) + gss_string_bytes(state->username) +
+                   gss_string_bytes(state->targetname) + gss_arena_heap_bytes(&state->arena);
+    gss_state_account(KERBEROS_MEMORY_SERVERS, &state->accounted_bytes, bytes);
+    gss_context_account(&state->accounted_context, state->context);
+}
+
+// Decodes a base64 token into `arena`, returns false if out of memory
+static bool gss_arena_decode_token(gss_arena* arena, const char* challenge, gss_buffer_t token) {
+    size_t length = strlen(challenge);
+    unsigned char* value = (unsigned char*)gss_arena_alloc(arena, base64_decoded_size(length));
+    if (value == NULL) {
+        return false;
+    }
+
+    token->length = base64_decode_into(challenge, length, value);
+    token->value = value;
+    return true;
+}
+
+// Copies a token as is into `arena`, returns NULL if out of memory
+static char* gss_arena_copy_token(gss_arena* arena, gss_buffer_t token) {
+    char* result = (char*)gss_arena_alloc(arena, token->length);
+    if (result != NULL) {
+        memcpy(result, token->value, token->length);
+    }
+
+    return result;
+}
+
+// Encodes a token as base64 into `arena`, returns NULL if out of memory
+static char* gss_arena_encode_token(gss_arena* arena, gss_buffer_t token) {
+    char* result = (char*)gss_arena_alloc(arena, base64_encoded_size(token->length));
+    if (result != NULL) {
+        base64_encode_into((const unsigned char*)token->value, token->length, result);
+    }
+
+    return result;
+}
+
+#if !defined(__APPLE__)
+static void gss_trace_callback(krb5_context context, const krb5_trace_info* info, void* data) {
+    // called with NULL when the context is freed
+    if (info != NULL && info->message != NULL) {
+        KerberosTraceRecord(info->message, strlen(info->message));
+    }
+}
+#endif
+
+// Sends trace lines from `context` to the trace buffer while capture is enabled. The GSSAPI
+// mechanism creates its own contexts which can only be traced through `KRB5_TRACE`.
+static void gss_trace_context(krb5_context context) {
+#if !defined(__APPLE__)
+    if (KerberosTraceEnabled()) {
+        krb5_set_trace_callback(context, gss_trace_callback, NULL);
+    }
+#endif
+}
+
 gss_result* server_principal_details(const char* service, const char* hostname) {
+    KERBEROS_STATS_SCOPE("server_principal_details");
     char match[1024];
     size_t match_len = 0;
     char* details = NULL;
@@ -72,26 +254,28 @@ gss_result* server_principal_details(const char* service, const char* hostname)
 
     code = krb5_init_context(&kcontext);
     if (code) {
-        result =
-            gss_error_result_with_message_and_code("Cannot initialize Kerberos5 context", code);
+        result = gss_error_result_with_message_and_code(
+            NULL, "Cannot initialize Kerberos5 context", code);
         return result;
     }
 
+    gss_trace_context(kcontext);
+
     if ((code = krb5_kt_default(kcontext, &kt))) {
-        result = gss_error_result_with_message_and_code("Cannot get default keytab", code);
+        result = gss_error_result_with_message_and_code(NULL, "Cannot get default keytab", code);
         goto end;
     }
 
     if ((code = krb5_kt_start_seq_get(kcontext, kt, &cursor))) {
-        result =
-            gss_error_result_with_message_and_code("Cannot get sequence cursor from keytab", code);
+        result = gss_error_result_with_message_and_code(
+            NULL, "Cannot get sequence cursor from keytab", code);
         goto end;
     }
 
     while ((code = krb5_kt_next_entry(kcontext, kt, &entry, &cursor)) == 0) {
         if ((code = krb5_unparse_name(kcontext, entry.principal, &pname))) {
             result = gss_error_result_with_message_and_code(
-                "Cannot parse principal name from keytab", code);
+                NULL, "Cannot parse principal name from keytab", code);
             goto end;
         }
 
@@ -108,9 +292,10 @@ gss_result* server_principal_details(const char* service, const char* hostname)
     }
 
     if (details == NULL) {
-        result = gss_error_result_with_message_and_code("Principal not found in keytab", -1);
+        result =
+            gss_error_result_with_message_and_code(NULL, "Principal not found in keytab", -1);
     } else {
-        result = gss_success_result(AUTH_GSS_COMPLETE);
+        result = gss_success_result(NULL, AUTH_GSS_COMPLETE);
         result->data = details;
     }
 end:
@@ -125,10 +310,12 @@ end:
 
 gss_result* authenticate_gss_client_init(const char* service,
                                          const char* principal,
+                                         const char* password,
                                          long int gss_flags,
                                          gss_server_state* delegatestate,
                                          gss_OID mech_oid,
                                          gss_client_state* state) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_init");
     OM_uint32 maj_stat;
     OM_uint32 min_stat;
     gss_buffer_desc name_token = GSS_C_EMPTY_BUFFER;
@@ -140,8 +327,15 @@ gss_result* authenticate_gss_client_init(const char* service,
     state->context = GSS_C_NO_CONTEXT;
     state->gss_flags = gss_flags;
     state->client_creds = GSS_C_NO_CREDENTIAL;
+    state->cached_creds = NULL;
     state->username = NULL;
     state->response = NULL;
+    state->output = NULL;
+    state->output_length = 0;
+    state->sasl_layer = 0;
+    state->accounted_bytes = 0;
+    state->accounted_context = false;
+    gss_client_state_account(state);
 
     // Import server name first
     name_token.length = strlen(service);
@@ -151,7 +345,7 @@ gss_result* authenticate_gss_client_init(const char* service,
         gss_import_name(&min_stat, &name_token, gss_krb5_nt_service_name, &state->server_name);
 
     if (GSS_ERROR(maj_stat)) {
-        ret = gss_error_result(maj_stat, min_stat);
+        ret = gss_error_result(NULL, maj_stat, min_stat);
         goto end;
     }
 
@@ -159,15 +353,30 @@ gss_result* authenticate_gss_client_init(const char* service,
     if (delegatestate && delegatestate->client_creds != GSS_C_NO_CREDENTIAL) {
         state->client_creds = delegatestate->client_creds;
     }
+    // With a password, log the principal in directly rather than relying on an existing ccache.
+    // The credentials are kept in memory and shared by every client using the same principal.
+    else if (principal && *principal && password && *password) {
+        state->cached_creds = gss_cred_cache_acquire(principal, password, &maj_stat, &min_stat);
+        if (state->cached_creds != NULL) {
+            state->client_creds = gss_cred_cache_entry_creds(state->cached_creds);
+        }
+        // Where the GSS library can't log in with a password (macOS), fall back to the
+        // principal's existing credentials below
+        else if (GSS_ROUTINE_ERROR(maj_stat) != GSS_S_UNAVAILABLE) {
+            ret = gss_error_result(NULL, maj_stat, min_stat);
+            goto end;
+        }
+    }
+
     // If available use the principal to extract its associated credentials
-    else if (principal && *principal) {
+    if (state->client_creds == GSS_C_NO_CREDENTIAL && principal && *principal) {
         gss_name_t name;
         principal_token.length = strlen(principal);
         principal_token.value = (char*)principal;
 
         maj_stat = gss_import_name(&min_stat, &principal_token, GSS_C_NT_USER_NAME, &name);
         if (GSS_ERROR(maj_stat)) {
-            ret = gss_error_result(maj_stat, min_stat);
+            ret = gss_error_result(NULL, maj_stat, min_stat);
             goto end;
         }
 
@@ -180,18 +389,18 @@ gss_result* authenticate_gss_client_init(const char* service,
                                     NULL,
                                     NULL);
         if (GSS_ERROR(maj_stat)) {
-            ret = gss_error_result(maj_stat, min_stat);
+            ret = gss_error_result(NULL, maj_stat, min_stat);
             goto end;
         }
 
         maj_stat = gss_release_name(&min_stat, &name);
         if (GSS_ERROR(maj_stat)) {
-            ret = gss_error_result(maj_stat, min_stat);
+            ret = gss_error_result(NULL, maj_stat, min_stat);
             goto end;
         }
     }
 
-    ret = gss_success_result(AUTH_GSS_COMPLETE);
+    ret = gss_success_result(NULL, AUTH_GSS_COMPLETE);
 end:
     return ret;
 }
@@ -204,23 +413,32 @@ int authenticate_gss_client_clean(gss_client_state* state) {
         gss_delete_sec_context(&min_stat, &state->context, GSS_C_NO_BUFFER);
     if (state->server_name != GSS_C_NO_NAME)
         gss_release_name(&min_stat, &state->server_name);
+    if (state->cached_creds != NULL) {
+        gss_cred_cache_release(state->cached_creds);
+        state->cached_creds = NULL;
+        state->client_creds = GSS_C_NO_CREDENTIAL;
+    }
     if (state->client_creds != GSS_C_NO_CREDENTIAL && !(state->gss_flags & GSS_C_DELEG_FLAG))
         gss_release_cred(&min_stat, &state->client_creds);
     if (state->username != NULL) {
         free(state->username);
         state->username = NULL;
     }
-    if (state->response != NULL) {
-        free(state->response);
-        state->response = NULL;
-    }
 
+    state->response = NULL;
+    state->output = NULL;
+    state->output_length = 0;
+    gss_arena_release(&state->arena);
+
+    gss_context_account(&state->accounted_context, state->context);
+    gss_state_unaccount(KERBEROS_MEMORY_CLIENTS, &state->accounted_bytes);
     return ret;
 }
 
 gss_result* authenticate_gss_client_step(gss_client_state* state,
                                          const char* challenge,
                                          struct gss_channel_bindings_struct* channel_bindings) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_step");
     OM_uint32 maj_stat;
     OM_uint32 min_stat;
     gss_buffer_desc input_token = GSS_C_EMPTY_BUFFER;
@@ -228,25 +446,21 @@ gss_result* authenticate_gss_client_step(gss_client_state* state,
     gss_result* ret = NULL;
     int temp_ret = AUTH_GSS_CONTINUE;
 
-    // Always clear out the old response
-    if (state->response != NULL) {
-        free(state->response);
-        state->response = NULL;
-    }
+    // Always clear out the old response and result
+    state->response = NULL;
+    gss_arena_reset(&state->arena);
 
     // If there is a challenge (data from the server) we need to give it to GSS
     if (challenge && *challenge) {
-        size_t len;
-        input_token.value = base64_decode(challenge, &len);
-        if (input_token.value == NULL) {
-            ret = gss_error_result_with_message("Ran out of memory decoding challenge");
+        if (!gss_arena_decode_token(&state->arena, challenge, &input_token)) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Ran out of memory decoding challenge");
             goto end;
         }
-
-        input_token.length = len;
     }
 
     // Do GSSAPI step
+    KERBEROS_PROBE2(client_step_entry, state, input_token.length);
     maj_stat = gss_init_sec_context(&min_stat,
                                     state->client_creds,
                                     &state->context,
@@ -260,77 +474,44 @@ gss_result* authenticate_gss_client_step(gss_client_state* state,
                                     &output_token,
                                     NULL,
                                     NULL);
+    KERBEROS_PROBE4(client_step_return, state, maj_stat, min_stat, output_token.length);
 
     if ((maj_stat != GSS_S_COMPLETE) && (maj_stat != GSS_S_CONTINUE_NEEDED)) {
-        ret = gss_error_result(maj_stat, min_stat);
+        ret = gss_error_result(&state->result, maj_stat, min_stat);
         goto end;
     }
 
     temp_ret = (maj_stat == GSS_S_COMPLETE) ? AUTH_GSS_COMPLETE : AUTH_GSS_CONTINUE;
     // Grab the client response to send back to the server
     if (output_token.length) {
-        state->response =
-            base64_encode((const unsigned char*)output_token.value, output_token.length);
+        state->response = gss_arena_encode_token(&state->arena, &output_token);
         if (state->response == NULL) {
-            ret = gss_error_result_with_message("Ran out of memory encoding response");
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Ran out of memory encoding response");
             goto end;
         }
 
         maj_stat = gss_release_buffer(&min_stat, &output_token);
     }
 
-    // Try to get the user name if we have completed all GSS operations
+    // The user name is resolved on demand, see `authenticate_gss_client_username`
     if (temp_ret == AUTH_GSS_COMPLETE) {
         state->context_complete = true;
-
-        gss_name_t gssuser = GSS_C_NO_NAME;
-        maj_stat = gss_inquire_context(
-            &min_stat, state->context, &gssuser, NULL, NULL, NULL, NULL, NULL, NULL);
-        if (GSS_ERROR(maj_stat)) {
-            ret = gss_error_result(maj_stat, min_stat);
-            goto end;
-        }
-
-        gss_buffer_desc name_token;
-        name_token.length = 0;
-        maj_stat = gss_display_name(&min_stat, gssuser, &name_token, NULL);
-        if (GSS_ERROR(maj_stat)) {
-            if (name_token.value) {
-                gss_release_buffer(&min_stat, &name_token);
-            }
-            gss_release_name(&min_stat, &gssuser);
-
-            ret = gss_error_result(maj_stat, min_stat);
-            goto end;
-        } else {
-            if (state->username != NULL) {
-                free(state->username);
-                state->username = NULL;
-            }
-            state->username = (char*)malloc(name_token.length + 1);
-            if (state->username == NULL) {
-                ret = gss_error_result_with_message("Ran out of memory allocating username");
-                goto end;
-            }
-            strncpy(state->username, (char*)name_token.value, name_token.length);
-            state->username[name_token.length] = 0;
-            gss_release_buffer(&min_stat, &name_token);
-            gss_release_name(&min_stat, &gssuser);
-        }
     }
 
-    ret = gss_success_result(temp_ret);
+    ret = gss_success_result(&state->result, temp_ret);
 end:
+    gss_client_state_account(state);
     if (output_token.value) {
         gss_release_buffer(&min_stat, &output_token);
     }
-    if (input_token.value) {
-        free(input_token.value);
-    }
     return ret;
 }
 
-gss_result* authenticate_gss_client_unwrap(gss_client_state* state, const char* challenge) {
+gss_result* authenticate_gss_client_unwrap(gss_client_state* state,
+                                           const char* challenge,
+                                           bool binary) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_unwrap");
     OM_uint32 maj_stat;
     OM_uint32 min_stat;
     gss_buffer_desc input_token = GSS_C_EMPTY_BUFFER;
@@ -338,42 +519,56 @@ gss_result* authenticate_gss_client_unwrap(gss_client_state* state, const char*
     int conf = 0;
     gss_result* ret = NULL;
 
-    // Always clear out the old response
-    if (state->response != NULL) {
-        free(state->response);
-        state->response = NULL;
-        state->responseConf = 0;
-    }
+    // Always clear out the old response and result
+    state->response = NULL;
+    state->responseConf = 0;
+    state->output = NULL;
+    state->output_length = 0;
+    gss_arena_reset(&state->arena);
 
     // If there is a challenge (data from the server) we need to give it to GSS
     if (challenge && *challenge) {
-        size_t len;
-        input_token.value = base64_decode(challenge, &len);
-        input_token.length = len;
+        if (!gss_arena_decode_token(&state->arena, challenge, &input_token)) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Ran out of memory decoding challenge");
+            goto end;
+        }
     }
 
     // Do GSSAPI step
+    KERBEROS_PROBE2(unwrap_entry, state, input_token.length);
     maj_stat = gss_unwrap(&min_stat, state->context, &input_token, &output_token, &conf, NULL);
+    KERBEROS_PROBE4(unwrap_return, state, maj_stat, min_stat, output_token.length);
 
     if (maj_stat != GSS_S_COMPLETE) {
-        ret = gss_error_result(maj_stat, min_stat);
+        ret = gss_error_result(&state->result, maj_stat, min_stat);
         goto end;
     }
 
     // Grab the client response
     if (output_token.length) {
-        state->response =
-            base64_encode((const unsigned char*)output_token.value, output_token.length);
+        if (binary) {
+            state->output = gss_arena_copy_token(&state->arena, &output_token);
+            state->output_length = output_token.length;
+        } else {
+            state->response = gss_arena_encode_token(&state->arena, &output_token);
+        }
+
+        if (state->output == NULL && state->response == NULL) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Ran out of memory encoding response");
+            goto end;
+        }
+
         state->responseConf = conf;
         maj_stat = gss_release_buffer(&min_stat, &output_token);
     }
 
-    ret = gss_success_result(AUTH_GSS_COMPLETE);
+    ret = gss_success_result(&state->result, AUTH_GSS_COMPLETE);
 end:
+    gss_client_state_account(state);
     if (output_token.value)
         gss_release_buffer(&min_stat, &output_token);
-    if (input_token.value)
-        free(input_token.value);
 
     return ret;
 }
@@ -381,25 +576,31 @@ end:
 gss_result* authenticate_gss_client_wrap(gss_client_state* state,
                                          const char* challenge,
                                          const char* user,
-                                         int protect) {
+                                         int protect,
+                                         bool binary) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_wrap");
     OM_uint32 maj_stat;
     OM_uint32 min_stat;
     gss_buffer_desc input_token = GSS_C_EMPTY_BUFFER;
     gss_buffer_desc output_token = GSS_C_EMPTY_BUFFER;
     char buf[4096];
     unsigned long buf_size;
+    int conf = 0;
     gss_result* ret = NULL;
 
-    // Always clear out the old response
-    if (state->response != NULL) {
-        free(state->response);
-        state->response = NULL;
-    }
+    // Always clear out the old response and result
+    state->response = NULL;
+    state->responseConf = 0;
+    state->output = NULL;
+    state->output_length = 0;
+    gss_arena_reset(&state->arena);
 
     if (challenge && *challenge) {
-        size_t len;
-        input_token.value = base64_decode(challenge, &len);
-        input_token.length = len;
+        if (!gss_arena_decode_token(&state->arena, challenge, &input_token)) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Ran out of memory decoding challenge");
+            goto end;
+        }
     }
 
     if (user) {
@@ -407,7 +608,6 @@ gss_result* authenticate_gss_client_wrap(gss_client_state* state,
         // server_conf_flags = ((char*) input_token.value)[0];
         ((char*)input_token.value)[0] = 0;
         buf_size = ntohl(*((long*)input_token.value));
-        free(input_token.value);
 #ifdef PRINTFS
         printf("User: %s, %c%c%c\n",
                user,
@@ -428,34 +628,559 @@ gss_result* authenticate_gss_client_wrap(gss_client_state* state,
     }
 
     // Do GSSAPI wrap
+    KERBEROS_PROBE2(wrap_entry, state, input_token.length);
     maj_stat = gss_wrap(
-        &min_stat, state->context, protect, GSS_C_QOP_DEFAULT, &input_token, NULL, &output_token);
+        &min_stat, state->context, protect, GSS_C_QOP_DEFAULT, &input_token, &conf, &output_token);
+    KERBEROS_PROBE4(wrap_return, state, maj_stat, min_stat, output_token.length);
 
     if (maj_stat != GSS_S_COMPLETE) {
-        ret = gss_error_result(maj_stat, min_stat);
+        ret = gss_error_result(&state->result, maj_stat, min_stat);
         goto end;
     }
 
     // Grab the client response to send back to the server
     if (output_token.length) {
-        state->response =
-            base64_encode((const unsigned char*)output_token.value, output_token.length);
-        ;
+        if (binary) {
+            state->output = gss_arena_copy_token(&state->arena, &output_token);
+            state->output_length = output_token.length;
+        } else {
+            state->response = gss_arena_encode_token(&state->arena, &output_token);
+        }
+
+        if (state->output == NULL && state->response == NULL) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Ran out of memory encoding response");
+            goto end;
+        }
+
+        state->responseConf = conf;
         maj_stat = gss_release_buffer(&min_stat, &output_token);
     }
 
-    ret = gss_success_result(AUTH_GSS_COMPLETE);
+    ret = gss_success_result(&state->result, AUTH_GSS_COMPLETE);
+end:
+    gss_client_state_account(state);
+    if (output_token.value)
+        gss_release_buffer(&min_stat, &output_token);
+
+    return ret;
+}
+
+gss_result* authenticate_gss_client_get_mic(gss_client_state* state,
+                                            const gss_buffer_desc* messages,
+                                            size_t count,
+                                            gss_buffer_desc* mics) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_get_mic");
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_buffer_desc mic = GSS_C_EMPTY_BUFFER;
+    gss_result* ret = NULL;
+
+    state->response = NULL;
+    state->output = NULL;
+    state->output_length = 0;
+    gss_arena_reset(&state->arena);
+
+    for (size_t i = 0; i < count; ++i) {
+        KERBEROS_PROBE2(get_mic_entry, state, messages[i].length);
+        maj_stat = gss_get_mic(
+            &min_stat, state->context, GSS_C_QOP_DEFAULT, (gss_buffer_t)&messages[i], &mic);
+        KERBEROS_PROBE4(get_mic_return, state, maj_stat, min_stat, mic.length);
+
+        if (maj_stat != GSS_S_COMPLETE) {
+            ret = gss_error_result(&state->result, maj_stat, min_stat);
+            goto end;
+        }
+
+        mics[i].value = gss_arena_copy_token(&state->arena, &mic);
+        mics[i].length = mic.length;
+        if (mics[i].value == NULL && mic.length > 0) {
+            ret = gss_error_result_with_message(&state->result, "Ran out of memory copying MIC");
+            goto end;
+        }
+
+        gss_release_buffer(&min_stat, &mic);
+    }
+
+    ret = gss_success_result(&state->result, AUTH_GSS_COMPLETE);
+end:
+    gss_client_state_account(state);
+    if (mic.value)
+        gss_release_buffer(&min_stat, &mic);
+
+    return ret;
+}
+
+gss_result* authenticate_gss_client_verify_mic(gss_client_state* state,
+                                               const gss_buffer_desc* messages,
+                                               const gss_buffer_desc* mics,
+                                               size_t count,
+                                               bool* valid) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_verify_mic");
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+
+    for (size_t i = 0; i < count; ++i) {
+        KERBEROS_PROBE2(verify_mic_entry, state, messages[i].length);
+        maj_stat = gss_verify_mic(&min_stat,
+                                  state->context,
+                                  (gss_buffer_t)&messages[i],
+                                  (gss_buffer_t)&mics[i],
+                                  NULL);
+        KERBEROS_PROBE4(verify_mic_return, state, maj_stat, min_stat, mics[i].length);
+
+        // a bad or malformed MIC is an answer, anything else means none of them can be checked.
+        // A MIC which verifies but is a replay, too old, or out of sequence is reported as
+        // supplementary information, and is not valid either, as `gss_unwrap` treats it.
+        if (GSS_CALLING_ERROR(maj_stat)) {
+            return gss_error_result(&state->result, maj_stat, min_stat);
+        }
+
+        switch (GSS_ROUTINE_ERROR(maj_stat)) {
+            case 0:
+                valid[i] = (maj_stat == GSS_S_COMPLETE);
+                break;
+            case GSS_S_BAD_SIG:
+            case GSS_S_DEFECTIVE_TOKEN:
+                valid[i] = false;
+                break;
+            default:
+                return gss_error_result(&state->result, maj_stat, min_stat);
+        }
+    }
+
+    return gss_success_result(&state->result, AUTH_GSS_COMPLETE);
+}
+
+// The IOV layout of a wrap token: HEADER | DATA | PADDING | TRAILER, laid out contiguously that
+// is the same token `gss_wrap` produces, so either end can use either API
+enum { IOV_HEADER, IOV_DATA, IOV_PADDING, IOV_TRAILER, IOV_COUNT };
+
+static void gss_wrap_iov_init(gss_iov_buffer_desc* iov, char* data, size_t length) {
+    memset(iov, 0, sizeof(gss_iov_buffer_desc) * IOV_COUNT);
+    iov[IOV_HEADER].type = GSS_IOV_BUFFER_TYPE_HEADER;
+    iov[IOV_DATA].type = GSS_IOV_BUFFER_TYPE_DATA;
+    iov[IOV_DATA].buffer.value = data;
+    iov[IOV_DATA].buffer.length = length;
+    iov[IOV_PADDING].type = GSS_IOV_BUFFER_TYPE_PADDING;
+    iov[IOV_TRAILER].type = GSS_IOV_BUFFER_TYPE_TRAILER;
+}
+
+gss_result* authenticate_gss_client_wrap_iov_length(gss_client_state* state,
+                                                    size_t length,
+                                                    int protect,
+                                                    size_t* header,
+                                                    size_t* trailer) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_wrap_iov_length");
+#if defined(__APPLE__)
+    return gss_error_result(&state->result, GSS_S_UNAVAILABLE, 0);
+#else
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_iov_buffer_desc iov[IOV_COUNT];
+
+    gss_wrap_iov_init(iov, NULL, length);
+    maj_stat = gss_wrap_iov_length(
+        &min_stat, state->context, protect, GSS_C_QOP_DEFAULT, NULL, iov, IOV_COUNT);
+    if (maj_stat != GSS_S_COMPLETE) {
+        return gss_error_result(&state->result, maj_stat, min_stat);
+    }
+
+    *header = iov[IOV_HEADER].buffer.length;
+    *trailer = iov[IOV_PADDING].buffer.length + iov[IOV_TRAILER].buffer.length;
+    return gss_success_result(&state->result, AUTH_GSS_COMPLETE);
+#endif
+}
+
+gss_result* authenticate_gss_client_wrap_in_place(gss_client_state* state,
+                                                  char* buffer,
+                                                  size_t buffer_length,
+                                                  size_t offset,
+                                                  size_t length,
+                                                  int protect,
+                                                  size_t* token_offset,
+                                                  size_t* token_length) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_wrap_in_place");
+#if defined(__APPLE__)
+    return gss_error_result(&state->result, GSS_S_UNAVAILABLE, 0);
+#else
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_iov_buffer_desc iov[IOV_COUNT];
+    int conf = 0;
+    size_t header;
+    size_t padding;
+    size_t trailer;
+
+    gss_wrap_iov_init(iov, buffer + offset, length);
+    maj_stat = gss_wrap_iov_length(
+        &min_stat, state->context, protect, GSS_C_QOP_DEFAULT, NULL, iov, IOV_COUNT);
+    if (maj_stat != GSS_S_COMPLETE) {
+        return gss_error_result(&state->result, maj_stat, min_stat);
+    }
+
+    header = iov[IOV_HEADER].buffer.length;
+    padding = iov[IOV_PADDING].buffer.length;
+    trailer = iov[IOV_TRAILER].buffer.length;
+    if (header > offset || padding + trailer > buffer_length - offset - length) {
+        return gss_error_result_with_message(&state->result,
+                                             "The buffer has no room for the wrap token");
+    }
+
+    iov[IOV_HEADER].buffer.value = buffer + offset - header;
+    iov[IOV_PADDING].buffer.value = buffer + offset + length;
+    iov[IOV_TRAILER].buffer.value = buffer + offset + length + padding;
+
+    KERBEROS_PROBE2(wrap_entry, state, length);
+    maj_stat =
+        gss_wrap_iov(&min_stat, state->context, protect, GSS_C_QOP_DEFAULT, &conf, iov, IOV_COUNT);
+    KERBEROS_PROBE4(wrap_return, state, maj_stat, min_stat, header + length + padding + trailer);
+
+    if (maj_stat != GSS_S_COMPLETE) {
+        return gss_error_result(&state->result, maj_stat, min_stat);
+    }
+
+    // the padding actually used can be shorter than the estimate, which moves the trailer up
+    if (iov[IOV_PADDING].buffer.length < padding) {
+        memmove(buffer + offset + length + iov[IOV_PADDING].buffer.length,
+                iov[IOV_TRAILER].buffer.value,
+                trailer);
+    }
+
+    *token_offset = offset - header;
+    *token_length = header + length + iov[IOV_PADDING].buffer.length + trailer;
+    return gss_success_result(&state->result, AUTH_GSS_COMPLETE);
+#endif
+}
+
+gss_result* authenticate_gss_client_unwrap_in_place(gss_client_state* state,
+                                                    char* token,
+                                                    size_t length,
+                                                    size_t* data_offset,
+                                                    size_t* data_length) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_unwrap_in_place");
+#if defined(__APPLE__)
+    return gss_error_result(&state->result, GSS_S_UNAVAILABLE, 0);
+#else
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_iov_buffer_desc iov[2];
+    int conf = 0;
+
+    state->responseConf = 0;
+
+    // with a STREAM buffer the mechanism finds the data in the token, and decrypts it there
+    memset(iov, 0, sizeof(iov));
+    iov[0].type = GSS_IOV_BUFFER_TYPE_STREAM;
+    iov[0].buffer.value = token;
+    iov[0].buffer.length = length;
+    iov[1].type = GSS_IOV_BUFFER_TYPE_DATA;
+
+    KERBEROS_PROBE2(unwrap_entry, state, length);
+    maj_stat = gss_unwrap_iov(&min_stat, state->context, &conf, NULL, iov, 2);
+    KERBEROS_PROBE4(unwrap_return, state, maj_stat, min_stat, iov[1].buffer.length);
+
+    if (maj_stat != GSS_S_COMPLETE) {
+        return gss_error_result(&state->result, maj_stat, min_stat);
+    }
+
+    *data_offset = (char*)iov[1].buffer.value - token;
+    *data_length = iov[1].buffer.length;
+    state->responseConf = conf;
+    return gss_success_result(&state->result, AUTH_GSS_COMPLETE);
+#endif
+}
+
+gss_result* authenticate_gss_client_sasl_negotiate(gss_client_state* state,
+                                                   const char* challenge,
+                                                   const char* user,
+                                                   int layer,
+                                                   OM_uint32 max_receive) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_sasl_negotiate");
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_buffer_desc input_token = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc output_token = GSS_C_EMPTY_BUFFER;
+    size_t user_length = strlen(user);
+    unsigned char* message;
+    unsigned char* offer;
+    OM_uint32 max_send;
+    OM_uint32 max_plaintext = 0;
+    gss_result* ret = authenticate_gss_client_unwrap(state, challenge, true);
+    if (ret->code == AUTH_GSS_ERROR) {
+        return ret;
+    }
+
+    // the offer is the supported security layers, followed by the maximum message size
+    if (state->output_length != 4) {
+        ret = gss_error_result_with_message(&state->result, "Invalid SASL security layer offer");
+        goto end;
+    }
+
+    offer = (unsigned char*)state->output;
+    max_send = ((OM_uint32)offer[1] << 16) | ((OM_uint32)offer[2] << 8) | offer[3];
+    if (!(offer[0] & layer)) {
+        ret = gss_error_result_with_message(&state->result,
+                                             "The server does not offer the SASL security layer");
+        goto end;
+    }
+
+    if (layer != GSS_AUTH_P_NONE) {
+        maj_stat = gss_wrap_size_limit(&min_stat,
+                                       state->context,
+                                       layer == GSS_AUTH_P_PRIVACY,
+                                       GSS_C_QOP_DEFAULT,
+                                       max_send,
+                                       &max_plaintext);
+        if (maj_stat != GSS_S_COMPLETE) {
+            ret = gss_error_result(&state->result, maj_stat, min_stat);
+            goto end;
+        }
+
+        if (max_plaintext == 0) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "The server's SASL buffer is too small");
+            goto end;
+        }
+    }
+
+    // select the layer, announce the largest frame we accept, and authorize as `user`. Without a
+    // layer there are no frames, the server's size is echoed as it always has been.
+    message = (unsigned char*)gss_arena_alloc(&state->arena, 4 + user_length);
+    if (message == NULL) {
+        ret = gss_error_result_with_message(&state->result, "Ran out of memory wrapping reply");
+        goto end;
+    }
+
+    memcpy(message, offer, 4);
+    message[0] = (unsigned char)layer;
+    if (layer != GSS_AUTH_P_NONE) {
+        message[1] = (unsigned char)(max_receive >> 16);
+        message[2] = (unsigned char)(max_receive >> 8);
+        message[3] = (unsigned char)max_receive;
+    }
+    memcpy(message + 4, user, user_length);
+    input_token.value = message;
+    input_token.length = 4 + user_length;
+    state->output = NULL;
+    state->output_length = 0;
+
+    KERBEROS_PROBE2(wrap_entry, state, input_token.length);
+    maj_stat =
+        gss_wrap(&min_stat, state->context, 0, GSS_C_QOP_DEFAULT, &input_token, NULL, &output_token);
+    KERBEROS_PROBE4(wrap_return, state, maj_stat, min_stat, output_token.length);
+
+    if (maj_stat != GSS_S_COMPLETE) {
+        ret = gss_error_result(&state->result, maj_stat, min_stat);
+        goto end;
+    }
+
+    state->response = gss_arena_encode_token(&state->arena, &output_token);
+    if (state->response == NULL) {
+        ret = gss_error_result_with_message(&state->result, "Ran out of memory encoding response");
+        goto end;
+    }
+
+    state->sasl_layer = layer;
+    state->sasl_max_send = max_send;
+    state->sasl_max_receive = max_receive;
+    state->sasl_max_plaintext = max_plaintext;
+    ret = gss_success_result(&state->result, AUTH_GSS_COMPLETE);
 end:
+    gss_client_state_account(state);
     if (output_token.value)
         gss_release_buffer(&min_stat, &output_token);
 
-    if (!user && input_token.value)
-        gss_release_buffer(&min_stat, &input_token);
+    return ret;
+}
+
+static void sasl_write_length(char* frame, OM_uint32 length) {
+    frame[0] = (char)(length >> 24);
+    frame[1] = (char)(length >> 16);
+    frame[2] = (char)(length >> 8);
+    frame[3] = (char)length;
+}
+
+static OM_uint32 sasl_read_length(const char* frame) {
+    const unsigned char* bytes = (const unsigned char*)frame;
+    return ((OM_uint32)bytes[0] << 24) | ((OM_uint32)bytes[1] << 16) |
+           ((OM_uint32)bytes[2] << 8) | bytes[3];
+}
+
+gss_result* authenticate_gss_client_sasl_seal(gss_client_state* state,
+                                              const char* data,
+                                              size_t length) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_sasl_seal");
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_buffer_desc input_token = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc output_token = GSS_C_EMPTY_BUFFER;
+    int conf_req = (state->sasl_layer == GSS_AUTH_P_PRIVACY);
+    int conf = 0;
+    std::vector<gss_buffer_desc> tokens;
+    size_t total = 0;
+    size_t offset = 0;
+    char* frames = NULL;
+    size_t written = 0;
+    gss_result* ret = NULL;
+
+    state->response = NULL;
+    state->output = NULL;
+    state->output_length = 0;
+    gss_arena_reset(&state->arena);
+
+    if (state->sasl_layer != GSS_AUTH_P_INTEGRITY && state->sasl_layer != GSS_AUTH_P_PRIVACY) {
+        return gss_error_result_with_message(&state->result,
+                                             "No SASL security layer has been negotiated");
+    }
+
+    // The wrapped tokens are collected first and then framed in a buffer of exactly their size,
+    // sizing it by the server's maximum buffer instead would make the arena hold on to a block of
+    // up to 16MB for the life of the context
+    tokens.reserve((length + state->sasl_max_plaintext - 1) / state->sasl_max_plaintext);
+    while (offset < length) {
+        input_token.value = (void*)(data + offset);
+        input_token.length = length - offset;
+        if (input_token.length > state->sasl_max_plaintext) {
+            input_token.length = state->sasl_max_plaintext;
+        }
+
+        KERBEROS_PROBE2(wrap_entry, state, input_token.length);
+        maj_stat = gss_wrap(
+            &min_stat, state->context, conf_req, GSS_C_QOP_DEFAULT, &input_token, &conf, &output_token);
+        KERBEROS_PROBE4(wrap_return, state, maj_stat, min_stat, output_token.length);
+
+        if (maj_stat != GSS_S_COMPLETE) {
+            ret = gss_error_result(&state->result, maj_stat, min_stat);
+            goto end;
+        }
+
+        if ((conf_req && !conf) || output_token.length > state->sasl_max_send) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Wrapped data does not fit the SASL layer");
+            goto end;
+        }
+
+        tokens.push_back(output_token);
+        output_token = GSS_C_EMPTY_BUFFER;
+        total += 4 + tokens.back().length;
+        offset += input_token.length;
+    }
+
+    frames = (char*)gss_arena_alloc(&state->arena, total);
+    if (frames == NULL && total > 0) {
+        ret = gss_error_result_with_message(&state->result, "Ran out of memory sealing data");
+        goto end;
+    }
+
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        sasl_write_length(frames + written, (OM_uint32)tokens[i].length);
+        memcpy(frames + written + 4, tokens[i].value, tokens[i].length);
+        written += 4 + tokens[i].length;
+    }
+
+    state->output = frames;
+    state->output_length = written;
+    ret = gss_success_result(&state->result, AUTH_GSS_COMPLETE);
+end:
+    gss_client_state_account(state);
+    if (output_token.value)
+        gss_release_buffer(&min_stat, &output_token);
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        gss_release_buffer(&min_stat, &tokens[i]);
+    }
+
+    return ret;
+}
+
+gss_result* authenticate_gss_client_sasl_unseal(gss_client_state* state,
+                                                const char* data,
+                                                size_t length,
+                                                size_t* consumed) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_client_sasl_unseal");
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_buffer_desc input_token = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc output_token = GSS_C_EMPTY_BUFFER;
+    int conf = 0;
+    size_t complete = 0;
+    size_t offset = 0;
+    char* plaintext;
+    size_t written = 0;
+    gss_result* ret = NULL;
+
+    *consumed = 0;
+    state->response = NULL;
+    state->output = NULL;
+    state->output_length = 0;
+    gss_arena_reset(&state->arena);
+
+    if (state->sasl_layer != GSS_AUTH_P_INTEGRITY && state->sasl_layer != GSS_AUTH_P_PRIVACY) {
+        return gss_error_result_with_message(&state->result,
+                                             "No SASL security layer has been negotiated");
+    }
+
+    // find the complete frames first, their plaintext is no larger than their tokens
+    while (length - complete >= 4) {
+        OM_uint32 frame_length = sasl_read_length(data + complete);
+        if (frame_length > state->sasl_max_receive) {
+            return gss_error_result_with_message(
+                &state->result, "SASL frame exceeds the negotiated maximum buffer size");
+        }
+
+        if (length - complete - 4 < frame_length) {
+            break;
+        }
+
+        complete += 4 + frame_length;
+    }
+
+    plaintext = (char*)gss_arena_alloc(&state->arena, complete);
+    if (plaintext == NULL && complete > 0) {
+        ret = gss_error_result_with_message(&state->result, "Ran out of memory unsealing data");
+        goto end;
+    }
+
+    while (offset < complete) {
+        input_token.length = sasl_read_length(data + offset);
+        input_token.value = (void*)(data + offset + 4);
+
+        KERBEROS_PROBE2(unwrap_entry, state, input_token.length);
+        maj_stat = gss_unwrap(&min_stat, state->context, &input_token, &output_token, &conf, NULL);
+        KERBEROS_PROBE4(unwrap_return, state, maj_stat, min_stat, output_token.length);
+
+        if (maj_stat != GSS_S_COMPLETE) {
+            ret = gss_error_result(&state->result, maj_stat, min_stat);
+            goto end;
+        }
+
+        if ((state->sasl_layer == GSS_AUTH_P_PRIVACY && !conf) ||
+            written + output_token.length > complete) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Unwrapped data does not match the SASL layer");
+            goto end;
+        }
+
+        memcpy(plaintext + written, output_token.value, output_token.length);
+        written += output_token.length;
+        offset += 4 + input_token.length;
+        gss_release_buffer(&min_stat, &output_token);
+    }
+
+    *consumed = complete;
+    state->output = plaintext;
+    state->output_length = written;
+    ret = gss_success_result(&state->result, AUTH_GSS_COMPLETE);
+end:
+    gss_client_state_account(state);
+    if (output_token.value)
+        gss_release_buffer(&min_stat, &output_token);
 
     return ret;
 }
 
 gss_result* authenticate_gss_server_init(const char* service, gss_server_state* state) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_server_init");
     OM_uint32 maj_stat;
     OM_uint32 min_stat;
     size_t service_len;
@@ -470,6 +1195,9 @@ gss_result* authenticate_gss_server_init(const char* service, gss_server_state*
     state->username = NULL;
     state->targetname = NULL;
     state->response = NULL;
+    state->accounted_bytes = 0;
+    state->accounted_context = false;
+    gss_server_state_account(state);
 
     // Server name may be empty which means we aren't going to create our own creds
     service_len = strlen(service);
@@ -482,7 +1210,7 @@ gss_result* authenticate_gss_server_init(const char* service, gss_server_state*
             &min_stat, &name_token, GSS_C_NT_HOSTBASED_SERVICE, &state->server_name);
 
         if (GSS_ERROR(maj_stat)) {
-            ret = gss_error_result(maj_stat, min_stat);
+            ret = gss_error_result(NULL, maj_stat, min_stat);
             goto end;
         }
 
@@ -497,12 +1225,12 @@ gss_result* authenticate_gss_server_init(const char* service, gss_server_state*
                                     NULL);
 
         if (GSS_ERROR(maj_stat)) {
-            ret = gss_error_result(maj_stat, min_stat);
+            ret = gss_error_result(NULL, maj_stat, min_stat);
             goto end;
         }
     }
 
-    ret = gss_success_result(AUTH_GSS_COMPLETE);
+    ret = gss_success_result(NULL, AUTH_GSS_COMPLETE);
 end:
     return ret;
 }
@@ -529,39 +1257,50 @@ int authenticate_gss_server_clean(gss_server_state* state) {
         free(state->targetname);
         state->targetname = NULL;
     }
-    if (state->response != NULL) {
-        free(state->response);
-        state->response = NULL;
-    }
 
+    state->response = NULL;
+    gss_arena_release(&state->arena);
+
+    gss_context_account(&state->accounted_context, state->context);
+    gss_state_unaccount(KERBEROS_MEMORY_SERVERS, &state->accounted_bytes);
     return ret;
 }
 
 gss_result* authenticate_gss_server_step(gss_server_state* state, const char* challenge) {
+    KERBEROS_STATS_SCOPE("authenticate_gss_server_step");
     OM_uint32 maj_stat;
     OM_uint32 min_stat;
     gss_buffer_desc input_token = GSS_C_EMPTY_BUFFER;
     gss_buffer_desc output_token = GSS_C_EMPTY_BUFFER;
-    gss_name_t target_name = GSS_C_NO_NAME;
     // int ret = AUTH_GSS_CONTINUE;
     gss_result* ret = NULL;
 
-    // Always clear out the old response
-    if (state->response != NULL) {
-        free(state->response);
-        state->response = NULL;
+    // Always clear out the old response and result, and any names resolved for the previous step
+    state->response = NULL;
+    gss_arena_reset(&state->arena);
+    if (state->username != NULL) {
+        free(state->username);
+        state->username = NULL;
+    }
+    if (state->targetname != NULL) {
+        free(state->targetname);
+        state->targetname = NULL;
     }
 
     // If there is a challenge (data from the server) we need to give it to GSS
     if (challenge && *challenge) {
-        size_t len;
-        input_token.value = base64_decode(challenge, &len);
-        input_token.length = len;
+        if (!gss_arena_decode_token(&state->arena, challenge, &input_token)) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Ran out of memory decoding challenge");
+            goto end;
+        }
     } else {
-        ret = gss_error_result_with_message("No challenge parameter in request from client");
+        ret = gss_error_result_with_message(&state->result,
+                                             "No challenge parameter in request from client");
         goto end;
     }
 
+    KERBEROS_PROBE2(server_step_entry, state, input_token.length);
     maj_stat = gss_accept_sec_context(&min_stat,
                                       &state->context,
                                       state->server_creds,
@@ -573,69 +1312,134 @@ gss_result* authenticate_gss_server_step(gss_server_state* state, const char* ch
                                       NULL,
                                       NULL,
                                       &state->client_creds);
+    KERBEROS_PROBE4(server_step_return, state, maj_stat, min_stat, output_token.length);
 
     if (GSS_ERROR(maj_stat)) {
-        ret = gss_error_result(maj_stat, min_stat);
+        ret = gss_error_result(&state->result, maj_stat, min_stat);
         goto end;
     }
 
     // Grab the server response to send back to the client
     if (output_token.length) {
-        state->response =
-            base64_encode((const unsigned char*)output_token.value, output_token.length);
-        ;
-        maj_stat = gss_release_buffer(&min_stat, &output_token);
-    }
-
-    // Get the user name
-    maj_stat = gss_display_name(&min_stat, state->client_name, &output_token, NULL);
-    if (GSS_ERROR(maj_stat)) {
-        ret = gss_error_result(maj_stat, min_stat);
-        goto end;
-    }
-    state->username = (char*)malloc(output_token.length + 1);
-    strncpy(state->username, (char*)output_token.value, output_token.length);
-    state->username[output_token.length] = 0;
-
-    // Get the target name if no server creds were supplied
-    if (state->server_creds == GSS_C_NO_CREDENTIAL) {
-        maj_stat = gss_inquire_context(
-            &min_stat, state->context, NULL, &target_name, NULL, NULL, NULL, NULL, NULL);
-        if (GSS_ERROR(maj_stat)) {
-            ret = gss_error_result(maj_stat, min_stat);
+        state->response = gss_arena_encode_token(&state->arena, &output_token);
+        if (state->response == NULL) {
+            ret = gss_error_result_with_message(&state->result,
+                                                 "Ran out of memory encoding response");
             goto end;
         }
 
-        // Free output token if necessary before reusing
-        if (output_token.length)
-            gss_release_buffer(&min_stat, &output_token);
-
-        maj_stat = gss_display_name(&min_stat, target_name, &output_token, NULL);
-        if (GSS_ERROR(maj_stat)) {
-            ret = gss_error_result(maj_stat, min_stat);
-            goto end;
-        }
-        state->targetname = (char*)malloc(output_token.length + 1);
-        strncpy(state->targetname, (char*)output_token.value, output_token.length);
-        state->targetname[output_token.length] = 0;
+        maj_stat = gss_release_buffer(&min_stat, &output_token);
     }
 
-    ret = gss_success_result(AUTH_GSS_COMPLETE);
+    // The user and target names are resolved on demand, see `authenticate_gss_server_username`
+    // and `authenticate_gss_server_targetname`
+    ret = gss_success_result(&state->result, AUTH_GSS_COMPLETE);
     state->context_complete = true;
 end:
-    if (target_name != GSS_C_NO_NAME)
-        gss_release_name(&min_stat, &target_name);
+    gss_server_state_account(state);
     if (output_token.length)
         gss_release_buffer(&min_stat, &output_token);
-    if (input_token.value)
-        free(input_token.value);
     return ret;
 }
 
+// Copies the display form of `name` into a newly allocated string, or returns NULL
+static char* gss_display_name_dup(gss_name_t name) {
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_buffer_desc name_token = GSS_C_EMPTY_BUFFER;
+    char* result = NULL;
+
+    maj_stat = gss_display_name(&min_stat, name, &name_token, NULL);
+    if (GSS_ERROR(maj_stat)) {
+        if (name_token.value) {
+            gss_release_buffer(&min_stat, &name_token);
+        }
+
+        return NULL;
+    }
+
+    result = (char*)malloc(name_token.length + 1);
+    if (result != NULL) {
+        memcpy(result, name_token.value, name_token.length);
+        result[name_token.length] = 0;
+    }
+
+    gss_release_buffer(&min_stat, &name_token);
+    return result;
+}
+
+const char* authenticate_gss_client_username(gss_client_state* state) {
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_name_t gssuser = GSS_C_NO_NAME;
+
+    if (state->username != NULL || !state->context_complete) {
+        return state->username;
+    }
+
+    maj_stat = gss_inquire_context(
+        &min_stat, state->context, &gssuser, NULL, NULL, NULL, NULL, NULL, NULL);
+    if (GSS_ERROR(maj_stat)) {
+        return NULL;
+    }
+
+    state->username = gss_display_name_dup(gssuser);
+    gss_release_name(&min_stat, &gssuser);
+    gss_client_state_account(state);
+    return state->username;
+}
+
+const char* authenticate_gss_server_username(gss_server_state* state) {
+    if (state->username == NULL && state->client_name != GSS_C_NO_NAME) {
+        state->username = gss_display_name_dup(state->client_name);
+        gss_server_state_account(state);
+    }
+
+    return state->username;
+}
+
+const char* authenticate_gss_server_targetname(gss_server_state* state) {
+    OM_uint32 maj_stat;
+    OM_uint32 min_stat;
+    gss_name_t target_name = GSS_C_NO_NAME;
+
+    // The target name is only reported when no server creds were supplied
+    if (state->targetname != NULL || state->server_creds != GSS_C_NO_CREDENTIAL ||
+        state->context == GSS_C_NO_CONTEXT) {
+        return state->targetname;
+    }
+
+    maj_stat = gss_inquire_context(
+        &min_stat, state->context, NULL, &target_name, NULL, NULL, NULL, NULL, NULL);
+    if (GSS_ERROR(maj_stat)) {
+        return NULL;
+    }
+
+    state->targetname = gss_display_name_dup(target_name);
+    gss_release_name(&min_stat, &target_name);
+    gss_server_state_account(state);
+    return state->targetname;
+}
+
+gss_result* authenticate_gss_localname(const char* principal) {
+    char* localname = NULL;
+    gss_result* result = NULL;
+
+    krb5_error_code code = gss_localname_lookup(principal, &localname);
+    if (code) {
+        return gss_error_result_with_message_and_code(NULL, krb5_get_err_text(NULL, code), code);
+    }
+
+    result = gss_success_result(NULL, AUTH_GSS_COMPLETE);
+    result->data = localname;
+    return result;
+}
+
 gss_result* authenticate_user_krb5pwd(const char* user,
                                       const char* pswd,
                                       const char* service,
                                       const char* default_realm) {
+    KERBEROS_STATS_SCOPE("authenticate_user_krb5pwd");
     krb5_context kcontext = NULL;
     krb5_error_code code;
     krb5_principal client = NULL;
@@ -653,20 +1457,24 @@ gss_result* authenticate_user_krb5pwd(const char* user,
 
     code = krb5_init_context(&kcontext);
     if (code) {
-        result =
-            gss_error_result_with_message_and_code("Cannot initialize Kerberos5 context", code);
+        result = gss_error_result_with_message_and_code(
+            NULL, "Cannot initialize Kerberos5 context", code);
         return result;
     }
 
+    gss_trace_context(kcontext);
+
     ret = krb5_parse_name(kcontext, service, &server);
     if (ret) {
-        result = gss_error_result_with_message_and_code(krb5_get_err_text(kcontext, ret), ret);
+        result = gss_error_result_with_message_and_code(
+            NULL, krb5_get_err_text(kcontext, ret), ret);
         goto end;
     }
 
     code = krb5_unparse_name(kcontext, server, &name);
     if (code) {
-        result = gss_error_result_with_message_and_code(krb5_get_err_text(kcontext, code), code);
+        result = gss_error_result_with_message_and_code(
+            NULL, krb5_get_err_text(kcontext, code), code);
         goto end;
     }
 
@@ -674,7 +1482,7 @@ gss_result* authenticate_user_krb5pwd(const char* user,
     name = NULL;
     name = (char*)malloc(256);
     if (name == NULL) {
-        result = gss_error_result_with_message("Ran out of memory allocating name");
+        result = gss_error_result_with_message(NULL, "Ran out of memory allocating name");
         goto end;
     }
 
@@ -687,7 +1495,8 @@ gss_result* authenticate_user_krb5pwd(const char* user,
 
     code = krb5_parse_name(kcontext, name, &client);
     if (code) {
-        result = gss_error_result_with_message_and_code(krb5_get_err_text(kcontext, code), code);
+        result = gss_error_result_with_message_and_code(
+            NULL, krb5_get_err_text(kcontext, code), code);
         goto end;
     }
 
@@ -703,14 +1512,14 @@ gss_result* authenticate_user_krb5pwd(const char* user,
     verifyRet = krb5_get_init_creds_password(
         kcontext, &creds, client, (char*)pswd, NULL, NULL, 0, NULL, &gic_options);
     if (verifyRet) {
-        result = gss_error_result_with_message_and_code(krb5_get_err_text(kcontext, verifyRet),
-                                                        verifyRet);
+        result = gss_error_result_with_message_and_code(
+            NULL, krb5_get_err_text(kcontext, verifyRet), verifyRet);
         krb5_free_cred_contents(kcontext, &creds);
         goto end;
     }
 
     krb5_free_cred_contents(kcontext, &creds);
-    result = gss_success_result(1);
+    result = gss_success_result(NULL, 1);
 
 end:
     if (name) {
@@ -727,58 +1536,161 @@ end:
     return result;
 }
 
-static gss_result* gss_success_result(int ret) {
-    gss_result* result = (gss_result*)malloc(sizeof(gss_result));
+static gss_result* gss_success_result(gss_result* slot, int ret) {
+    gss_result* result = (slot != NULL) ? slot : (gss_result*)malloc(sizeof(gss_result));
     result->code = ret;
     result->message = NULL;
+    result->data = NULL;
+    result->major_status = GSS_S_COMPLETE;
+    result->minor_status = 0;
+    return result;
+}
+
+// Only the status codes are recorded in the result. Errors are created on the worker thread, so
+// this is also where a pair's text is formatted the first time it occurs, leaving only a cache
+// lookup for `gss_status_message` when the error is reported on the main thread.
+static gss_result* gss_error_result(gss_result* slot, OM_uint32 err_maj, OM_uint32 err_min) {
+    gss_result* result = gss_success_result(slot, AUTH_GSS_ERROR);
+    result->major_status = err_maj;
+    result->minor_status = err_min;
+    gss_status_message_prepare(err_maj, err_min);
+    return result;
+}
+
+// A slot is never freed, so its message can refer to the caller's (static) text
+static gss_result* gss_error_result_with_message(gss_result* slot, const char* message) {
+    gss_result* result = gss_success_result(slot, AUTH_GSS_ERROR);
+    result->message = (slot != NULL) ? (char*)message : strdup(message);
     return result;
 }
 
-static gss_result* gss_error_result(OM_uint32 err_maj, OM_uint32 err_min) {
+static gss_result* gss_error_result_with_message_and_code(gss_result* slot,
+                                                          const char* message,
+                                                          int code) {
+    gss_result* result = gss_success_result(slot, AUTH_GSS_ERROR);
+    result->message = (char*)malloc(strlen(message) + 20);
+    sprintf(result->message, "%s (%d)", message, code);
+    result->minor_status = (OM_uint32)code;
+    return result;
+}
+
+void gss_result_free(gss_result* result) {
+    free(result->message);
+    free(result->data);
+    free(result);
+}
+
+#define STATUS_MESSAGE_CACHE_SIZE 256
+
+// Most recently used pairs first, the least recently used pair is evicted once the cache is full
+typedef std::pair<uint64_t, std::string> status_message_entry;
+
+static std::mutex status_message_mutex;
+static std::list<status_message_entry> status_message_lru;
+static std::unordered_map<uint64_t, std::list<status_message_entry>::iterator> status_messages;
+
+static std::string gss_display_status_text(OM_uint32 status, int type) {
     OM_uint32 maj_stat, min_stat;
     OM_uint32 msg_ctx = 0;
     gss_buffer_desc status_string;
-    char buf_maj[512];
-    char buf_min[512];
-    gss_result* result;
+    std::string text;
 
     do {
-        maj_stat = gss_display_status(
-            &min_stat, err_maj, GSS_C_GSS_CODE, GSS_C_NO_OID, &msg_ctx, &status_string);
-        if (GSS_ERROR(maj_stat))
+        maj_stat = gss_display_status(&min_stat, status, type, GSS_C_NO_OID, &msg_ctx, &status_string);
+        if (GSS_ERROR(maj_stat)) {
             break;
-        strncpy(buf_maj, (char*)status_string.value, sizeof(buf_maj));
-        gss_release_buffer(&min_stat, &status_string);
+        }
 
-        maj_stat = gss_display_status(
-            &min_stat, err_min, GSS_C_MECH_CODE, GSS_C_NULL_OID, &msg_ctx, &status_string);
-        if (!GSS_ERROR(maj_stat)) {
-            strncpy(buf_min, (char*)status_string.value, sizeof(buf_min));
-            gss_release_buffer(&min_stat, &status_string);
+        if (!text.empty()) {
+            text.append(", ");
         }
-    } while (!GSS_ERROR(maj_stat) && msg_ctx != 0);
+        text.append((char*)status_string.value, status_string.length);
+        gss_release_buffer(&min_stat, &status_string);
+    } while (msg_ctx != 0);
 
-    result = (gss_result*)malloc(sizeof(gss_result));
-    result->code = AUTH_GSS_ERROR;
-    result->message = (char*)malloc(sizeof(char) * 1024 + 2);
-    sprintf(result->message, "%s: %s", buf_maj, buf_min);
+    return text;
+}
 
-    return result;
+static bool gss_status_message_cached(uint64_t key, std::string* message) {
+    std::lock_guard<std::mutex> lock(status_message_mutex);
+    auto it = status_messages.find(key);
+    if (it == status_messages.end()) {
+        return false;
+    }
+
+    status_message_lru.splice(status_message_lru.begin(), status_message_lru, it->second);
+    if (message != NULL) {
+        *message = it->second->second;
+    }
+    return true;
 }
 
-static gss_result* gss_error_result_with_message(const char* message) {
-    gss_result* result = (gss_result*)malloc(sizeof(gss_result));
-    result->code = AUTH_GSS_ERROR;
-    result->message = strdup(message);
-    return result;
+static std::string gss_status_message_format(uint64_t key,
+                                             OM_uint32 major_status,
+                                             OM_uint32 minor_status) {
+    std::string message = gss_display_status_text(major_status, GSS_C_GSS_CODE);
+    message.append(": ");
+    message.append(gss_display_status_text(minor_status, GSS_C_MECH_CODE));
+
+    std::lock_guard<std::mutex> lock(status_message_mutex);
+    if (status_messages.find(key) != status_messages.end()) {
+        // formatted concurrently by another thread
+        return message;
+    }
+
+    if (status_messages.size() >= STATUS_MESSAGE_CACHE_SIZE) {
+        status_messages.erase(status_message_lru.back().first);
+        status_message_lru.pop_back();
+    }
+
+    status_message_lru.push_front(std::make_pair(key, message));
+    status_messages[key] = status_message_lru.begin();
+    return message;
 }
 
-static gss_result* gss_error_result_with_message_and_code(const char* message, int code) {
-    gss_result* result = (gss_result*)malloc(sizeof(gss_result));
-    result->code = AUTH_GSS_ERROR;
-    result->message = (char*)malloc(strlen(message) + 20);
-    sprintf(result->message, "%s (%d)", message, code);
-    return result;
+void gss_status_message_prepare(OM_uint32 major_status, OM_uint32 minor_status) {
+    uint64_t key = ((uint64_t)major_status << 32) | minor_status;
+    if (!gss_status_message_cached(key, NULL)) {
+        gss_status_message_format(key, major_status, minor_status);
+    }
+}
+
+std::string gss_status_message(OM_uint32 major_status, OM_uint32 minor_status) {
+    uint64_t key = ((uint64_t)major_status << 32) | minor_status;
+    std::string message;
+    if (gss_status_message_cached(key, &message)) {
+        return message;
+    }
+
+    return gss_status_message_format(key, major_status, minor_status);
+}
+
+bool gss_status_retryable(OM_uint32 major_status, OM_uint32 minor_status) {
+    switch (GSS_ROUTINE_ERROR(major_status)) {
+        case GSS_S_CREDENTIALS_EXPIRED:
+        case GSS_S_CONTEXT_EXPIRED:
+            return true;
+        case 0:
+        case GSS_S_FAILURE:
+            break;
+        default:
+            return false;
+    }
+
+    switch ((krb5_error_code)minor_status) {
+        case KRB5_KDC_UNREACH:
+        case KRB5_REALM_CANT_RESOLVE:
+        case KRB5KDC_ERR_SVC_UNAVAILABLE:
+        case KRB5KRB_AP_ERR_REPEAT:
+        case KRB5KRB_AP_ERR_TKT_EXPIRED:
+        case ETIMEDOUT:
+        case ECONNREFUSED:
+        case ECONNRESET:
+        case EAGAIN:
+            return true;
+        default:
+            return false;
+    }
 }
 
 #if defined(__clang__)
@@ -14,12 +14,17 @@
  * limitations under the License.
  **/
 
+#include <string>
+
 extern "C" {
     #include <gssapi/gssapi.h>
     #include <gssapi/gssapi_generic.h>
     #include <gssapi/gssapi_krb5.h>
 }
 
+#include "kerberos_gss_arena.h"
+#include "kerberos_gss_cred_cache.h"
+
 #define krb5_get_err_text(context, code) error_message(code)
 
 #define AUTH_GSS_ERROR -1
@@ -34,6 +39,10 @@ typedef struct {
     int code;
     char* message;
     char* data;
+    // GSS status codes of a failed call. krb5 errors are reported as the minor status, which is
+    // also how the krb5 mechanism reports them through GSS.
+    OM_uint32 major_status;
+    OM_uint32 minor_status;
 } gss_result;
 
 typedef struct {
@@ -42,10 +51,27 @@ typedef struct {
     gss_OID mech_oid;
     long int gss_flags;
     gss_cred_id_t client_creds;
+    gss_cred_cache_entry* cached_creds;
     char* username;
+    // allocated from `arena`, valid until the next operation
     char* response;
     int responseConf;
+    // the raw output of a binary unwrap or wrap, in place of `response`, also from `arena`
+    char* output;
+    size_t output_length;
+    // the SASL security layer (a `GSS_AUTH_P_*`, 0 until negotiated) and its buffer sizes: the
+    // largest frame the server accepts and that we accept, and the plaintext fitting in the former
+    int sasl_layer;
+    OM_uint32 sasl_max_send;
+    OM_uint32 sasl_max_receive;
+    OM_uint32 sasl_max_plaintext;
     bool context_complete;
+    // the result of the last step, unwrap or wrap
+    gss_result result;
+    gss_arena arena;
+    // what this state currently contributes to the native memory accounting
+    size_t accounted_bytes;
+    bool accounted_context;
 } gss_client_state;
 
 typedef struct {
@@ -56,17 +82,46 @@ typedef struct {
     gss_cred_id_t client_creds;
     char* username;
     char* targetname;
+    // allocated from `arena`, valid until the next operation
     char* response;
     bool context_complete;
+    // the result of the last step
+    gss_result result;
+    gss_arena arena;
+    // what this state currently contributes to the native memory accounting
+    size_t accounted_bytes;
+    bool accounted_context;
 } gss_server_state;
 
+// The text for a GSS status code pair. Formatting goes through `gss_display_status`, so results
+// are kept in a bounded LRU cache of the most recently reported pairs.
+std::string gss_status_message(OM_uint32 major_status, OM_uint32 minor_status);
+
+// Formats and caches the text for a status pair unless it is already cached. Called on the worker
+// thread as errors are created, so reporting them on the main thread is only a cache lookup.
+void gss_status_message_prepare(OM_uint32 major_status, OM_uint32 minor_status);
+
+// Whether a failure with this status is likely transient (KDC unreachable, expired credentials)
+// such that retrying the operation with a new context may succeed.
+bool gss_status_retryable(OM_uint32 major_status, OM_uint32 minor_status);
+
+// Frees the result of an initialization or a stateless call. Step, unwrap and wrap instead return
+// the result slot of their state, which stays valid until the next operation on that state and
+// must not be freed.
+void gss_result_free(gss_result* result);
+
+// States come from a pool of previously freed ones when possible. A state must be cleaned up
+// (`authenticate_gss_*_clean`) before it is freed.
 gss_client_state* gss_client_state_new();
 gss_server_state* gss_server_state_new();
+void gss_client_state_free(gss_client_state* state);
+void gss_server_state_free(gss_server_state* state);
 
 gss_result* server_principal_details(const char* service, const char* hostname);
 
 gss_result* authenticate_gss_client_init(const char* service,
                                          const char* principal,
+                                         const char* password,
                                          long int gss_flags,
                                          gss_server_state* delegatestate,
                                          gss_OID mech_oid,
@@ -76,11 +131,83 @@ int authenticate_gss_client_clean(gss_client_state* state);
 gss_result* authenticate_gss_client_step(gss_client_state* state,
                                          const char* challenge,
                                          struct gss_channel_bindings_struct* channel_bindings);
-gss_result* authenticate_gss_client_unwrap(gss_client_state* state, const char* challenge);
+// With `binary`, the output is left as is in `output` rather than base64 encoded in `response`
+gss_result* authenticate_gss_client_unwrap(gss_client_state* state,
+                                           const char* challenge,
+                                           bool binary);
 gss_result* authenticate_gss_client_wrap(gss_client_state* state,
                                          const char* challenge,
                                          const char* user,
-                                         int protect);
+                                         int protect,
+                                         bool binary);
+// Message integrity codes for each of `count` messages, in a single call. `get_mic` points
+// `mics[i]` at the MIC of `messages[i]`, copied to `arena`. `verify_mic` sets `valid[i]` to
+// whether `mics[i]` is a valid MIC of `messages[i]`; it only fails when a MIC couldn't be checked
+// at all, e.g. because the context has expired.
+gss_result* authenticate_gss_client_get_mic(gss_client_state* state,
+                                            const gss_buffer_desc* messages,
+                                            size_t count,
+                                            gss_buffer_desc* mics);
+gss_result* authenticate_gss_client_verify_mic(gss_client_state* state,
+                                               const gss_buffer_desc* messages,
+                                               const gss_buffer_desc* mics,
+                                               size_t count,
+                                               bool* valid);
+
+// In-place message protection with `gss_wrap_iov`. `wrap_iov_length` reports the bytes needed
+// before a message of `length` bytes for the token header, and after it for padding and the
+// trailer. `wrap_in_place` encrypts or signs `buffer[offset, offset + length)` where it is and
+// writes the header and trailer around it, reporting where the token starts and how long it is.
+// `unwrap_in_place` verifies and decrypts a whole token in `token`, reporting where its data is.
+// Neither allocates, and both use the caller's memory.
+gss_result* authenticate_gss_client_wrap_iov_length(gss_client_state* state,
+                                                    size_t length,
+                                                    int protect,
+                                                    size_t* header,
+                                                    size_t* trailer);
+gss_result* authenticate_gss_client_wrap_in_place(gss_client_state* state,
+                                                  char* buffer,
+                                                  size_t buffer_length,
+                                                  size_t offset,
+                                                  size_t length,
+                                                  int protect,
+                                                  size_t* token_offset,
+                                                  size_t* token_length);
+gss_result* authenticate_gss_client_unwrap_in_place(gss_client_state* state,
+                                                    char* token,
+                                                    size_t length,
+                                                    size_t* data_offset,
+                                                    size_t* data_length);
+
+// The final client message of a SASL GSSAPI exchange (RFC 4752): unwraps the server's security
+// layer offer, selects `layer` if offered, and wraps the reply authorizing `user` into `response`.
+// `max_receive` is the largest frame we accept once a protecting layer is in place.
+gss_result* authenticate_gss_client_sasl_negotiate(gss_client_state* state,
+                                                   const char* challenge,
+                                                   const char* user,
+                                                   int layer,
+                                                   OM_uint32 max_receive);
+
+// The data channel of a negotiated SASL security layer. Sealing splits `data` into chunks which fit
+// the server's buffer, and wraps each into a frame prefixed with its length. Unsealing unwraps
+// every complete frame at the start of `data`, reporting how many bytes it used in `consumed`.
+// Either way the result goes to `output`.
+gss_result* authenticate_gss_client_sasl_seal(gss_client_state* state,
+                                              const char* data,
+                                              size_t length);
+gss_result* authenticate_gss_client_sasl_unseal(gss_client_state* state,
+                                                const char* data,
+                                                size_t length,
+                                                size_t* consumed);
+// Resolve the peer names of a context on first use and cache them in the state, these return
+// NULL if the name is not available (yet).
+const char* authenticate_gss_client_username(gss_client_state* state);
+const char* authenticate_gss_server_username(gss_server_state* state);
+const char* authenticate_gss_server_targetname(gss_server_state* state);
+
+// Maps a principal to its local account name, `data` is NULL when there is no mapping
+gss_result* authenticate_gss_localname(const char* principal);
+
 gss_result* authenticate_gss_server_init(const char* service, gss_server_state* state);
 int authenticate_gss_server_clean(gss_server_state* state);
 gss_result* authenticate_gss_server_step(gss_server_state* state, const char* challenge);
@@ -0,0 +1,123 @@
+#include "kerberos_gss_arena.h"
+#include "../kerberos_memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GSS_ARENA_ALIGNMENT 16
+// Heap blocks are at least this large, which fits a base64 AP-REQ and its decoded form
+#define GSS_ARENA_MIN_BLOCK_SIZE 8192
+
+#define GSS_ARENA_ALIGN(size) \
+    (((size) + GSS_ARENA_ALIGNMENT - 1) & ~(size_t)(GSS_ARENA_ALIGNMENT - 1))
+
+struct gss_arena_block {
+    gss_arena_block* next;
+    size_t size;
+    size_t used;
+};
+
+// the usable memory of a block starts after its (aligned) header
+#define GSS_ARENA_BLOCK_DATA(block) ((char*)(block) + GSS_ARENA_ALIGN(sizeof(gss_arena_block)))
+
+static gss_arena_block* gss_arena_block_new(size_t size) {
+    gss_arena_block* block =
+        (gss_arena_block*)malloc(GSS_ARENA_ALIGN(sizeof(gss_arena_block)) + size);
+    if (block == NULL) {
+        return NULL;
+    }
+
+    KerberosMemoryArenaAllocated();
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static void gss_arena_free_blocks(gss_arena* arena) {
+    gss_arena_block* block = arena->blocks;
+    while (block != NULL) {
+        gss_arena_block* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->blocks = NULL;
+    arena->heap_bytes = 0;
+}
+
+void gss_arena_init(gss_arena* arena) {
+    arena->inline_used = 0;
+    arena->blocks = NULL;
+    arena->heap_bytes = 0;
+}
+
+void gss_arena_reset(gss_arena* arena) {
+    arena->inline_used = 0;
+
+    // the last operation overflowed into several blocks, replace them with one which fits it
+    if (arena->blocks != NULL && arena->blocks->next != NULL) {
+        size_t size = arena->heap_bytes;
+        gss_arena_free_blocks(arena);
+        arena->blocks = gss_arena_block_new(size);
+        if (arena->blocks != NULL) {
+            arena->heap_bytes = size;
+        }
+    }
+
+    if (arena->blocks != NULL) {
+        arena->blocks->used = 0;
+    }
+}
+
+void gss_arena_release(gss_arena* arena) {
+    gss_arena_free_blocks(arena);
+    arena->inline_used = 0;
+}
+
+void* gss_arena_alloc(gss_arena* arena, size_t size) {
+    size = GSS_ARENA_ALIGN(size);
+    if (arena->inline_used + size <= GSS_ARENA_INLINE_SIZE) {
+        void* result = arena->inline_data + arena->inline_used;
+        arena->inline_used += size;
+        return result;
+    }
+
+    gss_arena_block* block = arena->blocks;
+    if (block == NULL || block->used + size > block->size) {
+        size_t block_size = GSS_ARENA_MIN_BLOCK_SIZE;
+        if (block != NULL && block->size * 2 > block_size) {
+            block_size = block->size * 2;
+        }
+        if (size > block_size) {
+            block_size = size;
+        }
+
+        block = gss_arena_block_new(block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->heap_bytes += block_size;
+    }
+
+    void* result = GSS_ARENA_BLOCK_DATA(block) + block->used;
+    block->used += size;
+    return result;
+}
+
+char* gss_arena_strdup(gss_arena* arena, const char* string) {
+    size_t length = strlen(string);
+    char* result = (char*)gss_arena_alloc(arena, length + 1);
+    if (result != NULL) {
+        memcpy(result, string, length + 1);
+    }
+
+    return result;
+}
+
+size_t gss_arena_heap_bytes(const gss_arena* arena) {
+    return arena->heap_bytes;
+}
@@ -0,0 +1,40 @@
+#ifndef KERBEROS_GSS_ARENA_H
+#define KERBEROS_GSS_ARENA_H
+
+#include <stddef.h>
+
+// Requests up to this many bytes in total per operation are served from inside the state
+#define GSS_ARENA_INLINE_SIZE 256
+
+typedef struct gss_arena_block gss_arena_block;
+
+// Memory for the tokens a client or server state handles during one operation: the decoded input
+// token and the encoded response. Everything is released at once when the next operation resets
+// the arena, so allocations are only valid until then. Small operations are served from inline
+// storage and larger ones from heap blocks, which are kept across resets and coalesced into a
+// single block fitting the largest operation seen, so a warmed up state allocates nothing for
+// repeated operations. Not thread safe, a state runs one operation at a time.
+typedef struct {
+    alignas(16) char inline_data[GSS_ARENA_INLINE_SIZE];
+    size_t inline_used;
+    gss_arena_block* blocks;
+    size_t heap_bytes;
+} gss_arena;
+
+void gss_arena_init(gss_arena* arena);
+
+// Releases every allocation, keeping the heap storage for the next operation
+void gss_arena_reset(gss_arena* arena);
+
+// Releases every allocation and the heap storage
+void gss_arena_release(gss_arena* arena);
+
+// Returns `size` bytes aligned for any fundamental type, or NULL if out of memory
+void* gss_arena_alloc(gss_arena* arena, size_t size);
+
+char* gss_arena_strdup(gss_arena* arena, const char* string);
+
+// The heap storage currently held, for memory accounting
+size_t gss_arena_heap_bytes(const gss_arena* arena);
+
+#endif
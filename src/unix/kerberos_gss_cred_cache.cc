@@ -0,0 +1,264 @@
+#include "kerberos_gss_cred_cache.h"
+#include "../kerberos_memory.h"
+
+#if !defined(__APPLE__)
+extern "C" {
+    #include <gssapi/gssapi_ext.h>
+    #include <gssapi/gssapi_krb5.h>
+}
+#endif
+
+#include <string.h>
+#include <time.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+// Credentials are considered expired this many seconds before the KDC says they are, so that
+// a context is never established with a ticket which runs out mid-handshake.
+#define CRED_CACHE_EXPIRY_SKEW 60
+// Credentials are opaque, this approximates what the krb5 mechanism holds for a TGT in memory
+#define CRED_CACHE_ESTIMATED_CRED_BYTES 4096
+// Large enough for the AES-256 key passwords are compared by
+#define CRED_CACHE_KEY_BYTES 32
+
+// Entries keep the key krb5 derives from the password they were acquired with, salted for the
+// principal the same way the KDC does it, which is enough to tell whether a later login uses the
+// same password without keeping the password itself
+struct gss_cred_cache_entry {
+    unsigned char key[CRED_CACHE_KEY_BYTES];
+    size_t key_length;
+    gss_cred_id_t creds;
+    time_t expires;
+    int refs;
+};
+
+// What an entry is accounted for in `KERBEROS_MEMORY_CREDENTIALS`
+#define CRED_CACHE_ENTRY_BYTES (sizeof(gss_cred_cache_entry) + CRED_CACHE_ESTIMATED_CRED_BYTES)
+
+static std::mutex cache_mutex;
+static std::condition_variable cache_cond;
+static std::map<std::string, gss_cred_cache_entry*> cache;
+static std::set<std::string> inflight;
+
+// Overwrites memory holding secrets in a way the compiler can't drop as a dead store
+static void scrub(void* data, size_t length) {
+    volatile unsigned char* bytes = (volatile unsigned char*)data;
+    while (length--) {
+        *bytes++ = 0;
+    }
+}
+
+// Derives the key of `password` for `principal` with `krb5_c_string_to_key`. A zero
+// `key_length` means no key could be derived, and such a key never matches.
+static void password_key(const char* principal,
+                         const char* password,
+                         unsigned char* key,
+                         size_t* key_length) {
+    *key_length = 0;
+#if !defined(__APPLE__)
+    krb5_context kcontext = NULL;
+    krb5_principal name = NULL;
+    krb5_data salt;
+    krb5_data secret;
+    krb5_keyblock keyblock;
+
+    memset(&salt, 0, sizeof(salt));
+    memset(&keyblock, 0, sizeof(keyblock));
+    memset(&secret, 0, sizeof(secret));
+    secret.length = (unsigned int)strlen(password);
+    secret.data = (char*)password;
+
+    if (krb5_init_context(&kcontext)) {
+        return;
+    }
+
+    if (krb5_parse_name(kcontext, principal, &name) == 0 &&
+        krb5_principal2salt(kcontext, name, &salt) == 0 &&
+        krb5_c_string_to_key(
+            kcontext, ENCTYPE_AES256_CTS_HMAC_SHA1_96, &secret, &salt, &keyblock) == 0 &&
+        keyblock.length <= CRED_CACHE_KEY_BYTES) {
+        memcpy(key, keyblock.contents, keyblock.length);
+        *key_length = keyblock.length;
+    }
+
+    // krb5 zeroes key contents before freeing them
+    krb5_free_keyblock_contents(kcontext, &keyblock);
+    krb5_free_data_contents(kcontext, &salt);
+    if (name != NULL) {
+        krb5_free_principal(kcontext, name);
+    }
+
+    krb5_free_context(kcontext);
+#endif
+}
+
+// Compares the keys in constant time
+static bool password_matches(gss_cred_cache_entry* entry,
+                             const unsigned char* key,
+                             size_t key_length) {
+    unsigned char diff = 0;
+    if (key_length == 0 || entry->key_length != key_length) {
+        return false;
+    }
+
+    for (size_t i = 0; i < key_length; ++i) {
+        diff |= (unsigned char)(entry->key[i] ^ key[i]);
+    }
+
+    return diff == 0;
+}
+
+static bool entry_expired(gss_cred_cache_entry* entry) {
+    return entry->expires != 0 && time(NULL) + CRED_CACHE_EXPIRY_SKEW >= entry->expires;
+}
+
+// must be called with `cache_mutex` held
+static void entry_unref(gss_cred_cache_entry* entry) {
+    OM_uint32 min_stat;
+    if (--entry->refs > 0) {
+        return;
+    }
+
+    if (entry->creds != GSS_C_NO_CREDENTIAL) {
+        gss_release_cred(&min_stat, &entry->creds);
+    }
+
+    KerberosMemoryFreed(KERBEROS_MEMORY_CREDENTIALS, CRED_CACHE_ENTRY_BYTES);
+    scrub(entry->key, sizeof(entry->key));
+    delete entry;
+}
+
+// Drops the cache's reference to expired entries, they are freed once no client uses them.
+// Must be called with `cache_mutex` held.
+static void evict_expired() {
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (entry_expired(it->second)) {
+            entry_unref(it->second);
+            it = cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+static OM_uint32 acquire_creds_with_password(OM_uint32* min_stat,
+                                             const char* principal,
+                                             const char* password,
+                                             gss_cred_id_t* creds,
+                                             OM_uint32* time_rec) {
+#if defined(__APPLE__)
+    *min_stat = 0;
+    return GSS_S_UNAVAILABLE;
+#else
+    OM_uint32 maj_stat;
+    OM_uint32 tmp_stat;
+    gss_name_t name = GSS_C_NO_NAME;
+    gss_buffer_desc principal_token = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc password_token = GSS_C_EMPTY_BUFFER;
+
+    principal_token.length = strlen(principal);
+    principal_token.value = (char*)principal;
+    maj_stat = gss_import_name(min_stat, &principal_token, GSS_C_NT_USER_NAME, &name);
+    if (GSS_ERROR(maj_stat)) {
+        return maj_stat;
+    }
+
+    password_token.length = strlen(password);
+    password_token.value = (char*)password;
+    maj_stat = gss_acquire_cred_with_password(min_stat,
+                                              name,
+                                              &password_token,
+                                              GSS_C_INDEFINITE,
+                                              GSS_C_NO_OID_SET,
+                                              GSS_C_INITIATE,
+                                              creds,
+                                              NULL,
+                                              time_rec);
+
+    gss_release_name(&tmp_stat, &name);
+    return maj_stat;
+#endif
+}
+
+gss_cred_cache_entry* gss_cred_cache_acquire(const char* principal,
+                                             const char* password,
+                                             OM_uint32* maj_stat,
+                                             OM_uint32* min_stat) {
+    std::string key(principal);
+    unsigned char password_key_bytes[CRED_CACHE_KEY_BYTES] = {0};
+    size_t password_key_length;
+
+    // string-to-key is deliberately slow, so it runs before the lock is taken
+    password_key(principal, password, password_key_bytes, &password_key_length);
+
+    std::unique_lock<std::mutex> lock(cache_mutex);
+    evict_expired();
+
+    // Only one thread logs in a given principal at a time, concurrent callers wait for its result
+    for (;;) {
+        auto it = cache.find(key);
+        if (it != cache.end() && !entry_expired(it->second) &&
+            password_matches(it->second, password_key_bytes, password_key_length)) {
+            it->second->refs++;
+            *maj_stat = GSS_S_COMPLETE;
+            *min_stat = 0;
+            scrub(password_key_bytes, sizeof(password_key_bytes));
+            return it->second;
+        }
+
+        if (inflight.find(key) == inflight.end()) {
+            break;
+        }
+
+        cache_cond.wait(lock);
+    }
+
+    inflight.insert(key);
+    lock.unlock();
+
+    gss_cred_id_t creds = GSS_C_NO_CREDENTIAL;
+    OM_uint32 time_rec = 0;
+    *maj_stat = acquire_creds_with_password(min_stat, principal, password, &creds, &time_rec);
+
+    lock.lock();
+    inflight.erase(key);
+    cache_cond.notify_all();
+
+    // A failed login leaves any existing entry in place, so a bad password can't evict it
+    if (GSS_ERROR(*maj_stat)) {
+        scrub(password_key_bytes, sizeof(password_key_bytes));
+        return NULL;
+    }
+
+    gss_cred_cache_entry* entry = new gss_cred_cache_entry;
+    memcpy(entry->key, password_key_bytes, sizeof(entry->key));
+    entry->key_length = password_key_length;
+    scrub(password_key_bytes, sizeof(password_key_bytes));
+    entry->creds = creds;
+    entry->expires = (time_rec == GSS_C_INDEFINITE) ? 0 : time(NULL) + time_rec;
+    entry->refs = 2;  // one for the cache, one for the caller
+    KerberosMemoryAllocated(KERBEROS_MEMORY_CREDENTIALS, CRED_CACHE_ENTRY_BYTES);
+
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        entry_unref(it->second);
+        it->second = entry;
+    } else {
+        cache.insert(std::make_pair(key, entry));
+    }
+
+    return entry;
+}
+
+gss_cred_id_t gss_cred_cache_entry_creds(gss_cred_cache_entry* entry) {
+    return entry->creds;
+}
+
+void gss_cred_cache_release(gss_cred_cache_entry* entry) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    entry_unref(entry);
+}
@@ -0,0 +1,28 @@
+#ifndef KERBEROS_GSS_CRED_CACHE_H
+#define KERBEROS_GSS_CRED_CACHE_H
+
+extern "C" {
+    #include <gssapi/gssapi.h>
+}
+
+// A reference counted set of initiator credentials acquired with a password. Entries are
+// shared between every client state initialized with the same principal, and live in process
+// memory only (no credential cache is written to disk).
+typedef struct gss_cred_cache_entry gss_cred_cache_entry;
+
+// Returns a referenced entry for `principal`, acquiring new credentials with `password` if
+// there is no cached entry, the cached entry has expired, or it was acquired with a different
+// password. On failure NULL is returned and the GSS status codes are written to `maj_stat` and
+// `min_stat`. Safe to call from multiple threads.
+gss_cred_cache_entry* gss_cred_cache_acquire(const char* principal,
+                                             const char* password,
+                                             OM_uint32* maj_stat,
+                                             OM_uint32* min_stat);
+
+// The credentials held by an entry, valid until the entry is released
+gss_cred_id_t gss_cred_cache_entry_creds(gss_cred_cache_entry* entry);
+
+// Drops a reference obtained from `gss_cred_cache_acquire`
+void gss_cred_cache_release(gss_cred_cache_entry* entry);
+
+#endif
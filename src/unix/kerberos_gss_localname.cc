@@ -0,0 +1,127 @@
+#include "kerberos_gss_localname.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#define LOCALNAME_MAX_LENGTH 256
+
+// `localname` is only meaningful for principals with a mapping
+struct localname_entry {
+    std::string principal;
+    bool mapped;
+    std::string localname;
+    time_t expires;
+};
+
+static std::mutex localname_mutex;
+static std::list<localname_entry> localname_lru;
+static std::unordered_map<std::string, std::list<localname_entry>::iterator> localname_index;
+
+// A krb5 context must not be used by two threads at once, so rather than serializing lookups on
+// one shared context each thread keeps its own. Lookups run on the threadpool, whose threads
+// live as long as the process, so the profile is still only loaded once per thread.
+struct localname_thread_context {
+    krb5_context context = NULL;
+
+    ~localname_thread_context() {
+        if (context != NULL) {
+            krb5_free_context(context);
+        }
+    }
+};
+
+static thread_local localname_thread_context localname_context;
+
+static char* localname_dup(const localname_entry& entry) {
+    return entry.mapped ? strdup(entry.localname.c_str()) : NULL;
+}
+
+// Looks a principal up in the cache, must be called with `localname_mutex` held. Expired
+// entries are removed and reported as misses.
+static bool localname_cached(const std::string& key, char** localname) {
+    auto it = localname_index.find(key);
+    if (it == localname_index.end()) {
+        return false;
+    }
+
+    if (time(NULL) >= it->second->expires) {
+        localname_lru.erase(it->second);
+        localname_index.erase(it);
+        return false;
+    }
+
+    localname_lru.splice(localname_lru.begin(), localname_lru, it->second);
+    *localname = localname_dup(*it->second);
+    return true;
+}
+
+krb5_error_code gss_localname_lookup(const char* principal, char** localname) {
+    krb5_error_code code;
+    krb5_principal name = NULL;
+    char buf[LOCALNAME_MAX_LENGTH];
+    std::string key(principal);
+
+    *localname = NULL;
+    {
+        std::lock_guard<std::mutex> lock(localname_mutex);
+        if (localname_cached(key, localname)) {
+            return 0;
+        }
+    }
+
+    // The mapping is evaluated without the lock, so a slow lookup (e.g. an `auth_to_local` rule
+    // querying a directory) doesn't hold up cache hits for other principals. Concurrent misses
+    // for one principal may each evaluate it, the last result is the one cached.
+    krb5_context context = localname_context.context;
+    if (context == NULL) {
+        if ((code = krb5_init_context(&context))) {
+            return code;
+        }
+
+        localname_context.context = context;
+    }
+
+    if ((code = krb5_parse_name(context, principal, &name))) {
+        return code;
+    }
+
+    bool mapped = true;
+    code = krb5_aname_to_localname(context, name, sizeof(buf), buf);
+    krb5_free_principal(context, name);
+    if (code == KRB5_LNAME_NOTRANS || code == KRB5_NO_LOCALNAME) {
+        mapped = false;
+    } else if (code) {
+        return code;
+    }
+
+    localname_entry entry;
+    entry.principal = key;
+    entry.mapped = mapped;
+    entry.localname = mapped ? std::string(buf) : std::string();
+    entry.expires = time(NULL) + LOCALNAME_CACHE_TTL;
+
+    std::lock_guard<std::mutex> lock(localname_mutex);
+    // another thread may have cached the principal while the lock was released
+    auto it = localname_index.find(key);
+    if (it != localname_index.end()) {
+        *it->second = entry;
+        localname_lru.splice(localname_lru.begin(), localname_lru, it->second);
+    } else {
+        localname_lru.push_front(entry);
+        localname_index[key] = localname_lru.begin();
+        if (localname_lru.size() > LOCALNAME_CACHE_SIZE) {
+            localname_index.erase(localname_lru.back().principal);
+            localname_lru.pop_back();
+        }
+    }
+
+    *localname = localname_dup(localname_lru.front());
+    return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef KERBEROS_GSS_LOCALNAME_H
+#define KERBEROS_GSS_LOCALNAME_H
+
+extern "C" {
+    #include <gssapi/gssapi_krb5.h>
+}
+
+// Maximum number of principal to local name mappings kept in memory
+#define LOCALNAME_CACHE_SIZE 1024
+// Seconds a mapping is cached for, so changes to the `auth_to_local` rules or to the accounts
+// they resolve against are picked up without restarting the process
+#define LOCALNAME_CACHE_TTL 300
+
+// Maps a principal to a local account name following the `auth_to_local` rules of the Kerberos
+// configuration. Results (including the absence of a mapping) are served from a bounded LRU
+// cache for up to `LOCALNAME_CACHE_TTL` seconds, and misses are evaluated against a long-lived
+// krb5 context per thread so the profile is only loaded once per thread. On success 0 is returned and `localname` is set to a newly allocated string,
+// or NULL if the principal has no local name. Safe to call from multiple threads.
+krb5_error_code gss_localname_lookup(const char* principal, char** localname);
+
+#endif
@@ -0,0 +1,844 @@
+#include "kerberos_gss_mock.h"
+#include "../kerberos_trace.h"
+
+extern "C" {
+    #include <gssapi/gssapi.h>
+    #include <gssapi/gssapi_ext.h>
+    #include <gssapi/gssapi_generic.h>
+    #include <gssapi/gssapi_krb5.h>
+}
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+// Lifetime reported for contexts and credentials, in seconds
+#define GSS_MOCK_LIFETIME 36000
+
+#define GSS_MOCK_AP_REQ "mock-ap-req"
+#define GSS_MOCK_AP_REP "mock-ap-rep"
+#define GSS_MOCK_WRAP_PREFIX "mock-wrap"
+#define GSS_MOCK_MIC_PREFIX "mock-mic"
+
+static const char* call_names[GSS_MOCK_CALLS] = {"initSecContext",
+                                                 "acceptSecContext",
+                                                 "wrap",
+                                                 "unwrap",
+                                                 "acquireCred",
+                                                 "getInitCredsPassword",
+                                                 "keytab"};
+
+static std::mutex mock_mutex;
+static gss_mock_config mock_config = gss_mock_default_config();
+static std::atomic<uint64_t> mock_draws(0);
+static std::atomic<uint64_t> mock_counts[GSS_MOCK_CALLS];
+
+struct gss_cred_id_struct {
+    std::string principal;
+    gss_cred_usage_t usage;
+};
+
+struct gss_ctx_id_struct {
+    bool initiator;
+    bool open;
+    OM_uint32 flags;
+    std::string source;
+    std::string target;
+    // MICs carry a sequence number so that replays can be detected, see `gss_verify_mic`
+    uint32_t mic_sequence;
+    std::set<uint32_t> mics_seen;
+};
+
+// the position in the keytab, see `krb5_kt_start_seq_get`
+struct gss_mock_kt_cursor {
+    std::vector<std::string> principals;
+    size_t next;
+};
+
+// a keytab handle is never dereferenced, only compared against NULL
+static int mock_keytab;
+
+const char* gss_mock_call_name(int call) {
+    return call_names[call];
+}
+
+gss_mock_config gss_mock_default_config() {
+    gss_mock_config config;
+    config.seed = 0;
+    config.realm = "MOCK.LOCAL";
+    config.principal = "user@MOCK.LOCAL";
+    for (int call = 0; call < GSS_MOCK_CALLS; ++call) {
+        config.calls[call].distribution = GSS_MOCK_CONSTANT;
+        config.calls[call].latency = 0;
+        config.calls[call].spread = 0;
+        config.calls[call].error_rate = 0;
+        config.calls[call].error_code = KRB5_KDC_UNREACH;
+    }
+
+    config.calls[GSS_MOCK_ACCEPT_SEC_CONTEXT].error_code = KRB5KRB_AP_ERR_MODIFIED;
+    config.calls[GSS_MOCK_WRAP].error_code = KRB5KRB_AP_ERR_MODIFIED;
+    config.calls[GSS_MOCK_UNWRAP].error_code = KRB5KRB_AP_ERR_MODIFIED;
+    config.calls[GSS_MOCK_KEYTAB].error_code = KRB5_KT_NOTFOUND;
+    return config;
+}
+
+void gss_mock_configure(const gss_mock_config& config) {
+    std::lock_guard<std::mutex> lock(mock_mutex);
+    mock_config = config;
+    mock_draws = 0;
+    for (int call = 0; call < GSS_MOCK_CALLS; ++call) {
+        mock_counts[call] = 0;
+    }
+}
+
+uint64_t gss_mock_calls(int call) {
+    return mock_counts[call].load();
+}
+
+// The next draw in [0, 1) of the sequence for `seed` (splitmix64)
+static double mock_random(uint64_t seed) {
+    uint64_t z = seed + (mock_draws.fetch_add(1) + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z = z ^ (z >> 31);
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double mock_delay(const gss_mock_behaviour& behaviour, uint64_t seed) {
+    switch (behaviour.distribution) {
+        case GSS_MOCK_UNIFORM:
+            return behaviour.latency + (behaviour.spread - behaviour.latency) * mock_random(seed);
+        case GSS_MOCK_EXPONENTIAL:
+            return -behaviour.latency * log(1.0 - mock_random(seed));
+        case GSS_MOCK_LOGNORMAL: {
+            // Box-Muller
+            double u1 = 1.0 - mock_random(seed);
+            double u2 = mock_random(seed);
+            double normal = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+            return behaviour.latency * exp(behaviour.spread * normal);
+        }
+        case GSS_MOCK_CONSTANT:
+        default:
+            return behaviour.latency;
+    }
+}
+
+// Applies the configured behaviour of `call`, returning the krb5 error code to fail with, or 0
+static int32_t mock_enter(int call) {
+    gss_mock_behaviour behaviour;
+    uint64_t seed;
+    mock_counts[call]++;
+    {
+        std::lock_guard<std::mutex> lock(mock_mutex);
+        behaviour = mock_config.calls[call];
+        seed = mock_config.seed;
+    }
+
+    double delay = mock_delay(behaviour, seed);
+    if (delay > 0) {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delay));
+    }
+
+    // always drawn, so that changing an error rate leaves the delays of a sequence unchanged
+    bool fail = mock_random(seed) < behaviour.error_rate;
+    if (KerberosTraceEnabled()) {
+        char line[128];
+        int len = snprintf(line,
+                           sizeof(line),
+                           "mock %s: delayed %.3f ms%s",
+                           call_names[call],
+                           delay,
+                           fail ? ", injected failure" : "");
+        KerberosTraceRecord(line, (size_t)len);
+    }
+
+    return fail ? behaviour.error_code : 0;
+}
+
+static void mock_settings(std::string* realm, std::string* principal, std::string* password) {
+    std::lock_guard<std::mutex> lock(mock_mutex);
+    if (realm != NULL) *realm = mock_config.realm;
+    if (principal != NULL) *principal = mock_config.principal;
+    if (password != NULL) *password = mock_config.password;
+}
+
+static bool mock_in_keytab(const std::string& principal) {
+    std::lock_guard<std::mutex> lock(mock_mutex);
+    if (mock_config.keytab.empty()) {
+        return true;
+    }
+
+    for (const std::string& entry : mock_config.keytab) {
+        if (entry == principal) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static OM_uint32 mock_failure(OM_uint32* minor_status, OM_uint32 major_status, int32_t code) {
+    *minor_status = (OM_uint32)code;
+    return major_status;
+}
+
+// Buffers are released with `gss_release_buffer`, which frees their value
+static void mock_buffer(gss_buffer_t buffer, const std::string& value) {
+    buffer->value = malloc(value.size());
+    memcpy(buffer->value, value.data(), value.size());
+    buffer->length = value.size();
+}
+
+static void mock_empty_buffer(gss_buffer_t buffer) {
+    if (buffer != GSS_C_NO_BUFFER) {
+        buffer->length = 0;
+        buffer->value = NULL;
+    }
+}
+
+static bool mock_oid_equal(gss_OID a, gss_OID b) {
+    return a != GSS_C_NO_OID && b != GSS_C_NO_OID && a->length == b->length &&
+           memcmp(a->elements, b->elements, a->length) == 0;
+}
+
+// Names are real GSS names, so they can be displayed and released by the system library
+static gss_name_t mock_name(const std::string& principal) {
+    OM_uint32 min_stat;
+    gss_name_t name = GSS_C_NO_NAME;
+    gss_buffer_desc token = {principal.size(), (void*)principal.data()};
+    gss_import_name(&min_stat, &token, GSS_C_NT_USER_NAME, &name);
+    return name;
+}
+
+// The krb5 principal `name` refers to, turning host based service names into `service/host`
+static std::string mock_principal(gss_name_t name) {
+    OM_uint32 min_stat;
+    gss_buffer_desc token = GSS_C_EMPTY_BUFFER;
+    gss_OID type = GSS_C_NO_OID;
+    if (GSS_ERROR(gss_display_name(&min_stat, name, &token, &type))) {
+        return std::string();
+    }
+
+    std::string realm;
+    mock_settings(&realm, NULL, NULL);
+    std::string principal((const char*)token.value, token.length);
+    gss_release_buffer(&min_stat, &token);
+    if (mock_oid_equal(type, GSS_C_NT_HOSTBASED_SERVICE) ||
+        mock_oid_equal(type, gss_krb5_nt_service_name)) {
+        size_t at = principal.find('@');
+        std::string host = (at == std::string::npos) ? "localhost" : principal.substr(at + 1);
+        return principal.substr(0, at) + "/" + host + "@" + realm;
+    }
+
+    if (principal.find('@') == std::string::npos) {
+        principal += "@" + realm;
+    }
+
+    return principal;
+}
+
+static std::vector<std::string> mock_split(gss_buffer_t token) {
+    std::vector<std::string> fields;
+    std::string value;
+    if (token != GSS_C_NO_BUFFER && token->length != 0) {
+        value.assign((const char*)token->value, token->length);
+    }
+
+    size_t start = 0;
+    size_t end;
+    while ((end = value.find('\n', start)) != std::string::npos) {
+        fields.push_back(value.substr(start, end - start));
+        start = end + 1;
+    }
+
+    fields.push_back(value.substr(start));
+    return fields;
+}
+
+extern "C" {
+
+OM_uint32 KRB5_CALLCONV gss_init_sec_context(OM_uint32* minor_status,
+                                             gss_cred_id_t claimant_cred_handle,
+                                             gss_ctx_id_t* context_handle,
+                                             gss_name_t target_name,
+                                             gss_OID mech_type,
+                                             OM_uint32 req_flags,
+                                             OM_uint32 time_req,
+                                             gss_channel_bindings_t input_chan_bindings,
+                                             gss_buffer_t input_token,
+                                             gss_OID* actual_mech_type,
+                                             gss_buffer_t output_token,
+                                             OM_uint32* ret_flags,
+                                             OM_uint32* time_rec) {
+    gss_ctx_id_t context = *context_handle;
+    *minor_status = 0;
+    mock_empty_buffer(output_token);
+
+    if (context == GSS_C_NO_CONTEXT) {
+        // the first step is where the service ticket is fetched from the KDC
+        int32_t code = mock_enter(GSS_MOCK_INIT_SEC_CONTEXT);
+        if (code) {
+            return mock_failure(minor_status, GSS_S_FAILURE, code);
+        }
+
+        context = new gss_ctx_id_struct();
+        context->initiator = true;
+        context->open = !(req_flags & GSS_C_MUTUAL_FLAG);
+        context->flags = req_flags | GSS_C_INTEG_FLAG | GSS_C_CONF_FLAG;
+        if (claimant_cred_handle != GSS_C_NO_CREDENTIAL) {
+            context->source = claimant_cred_handle->principal;
+        } else {
+            mock_settings(NULL, &context->source, NULL);
+        }
+
+        context->target = mock_principal(target_name);
+        *context_handle = context;
+
+        mock_buffer(output_token,
+                    std::string(GSS_MOCK_AP_REQ) + "\n" + context->source + "\n" +
+                        context->target + "\n" + std::to_string(context->flags));
+    } else {
+        std::vector<std::string> fields = mock_split(input_token);
+        if (context->open || fields[0] != GSS_MOCK_AP_REP) {
+            return GSS_S_DEFECTIVE_TOKEN;
+        }
+
+        context->open = true;
+    }
+
+    if (actual_mech_type != NULL) *actual_mech_type = (gss_OID)gss_mech_krb5;
+    if (ret_flags != NULL) *ret_flags = context->flags;
+    if (time_rec != NULL) *time_rec = GSS_MOCK_LIFETIME;
+    return context->open ? GSS_S_COMPLETE : GSS_S_CONTINUE_NEEDED;
+}
+
+OM_uint32 KRB5_CALLCONV gss_accept_sec_context(OM_uint32* minor_status,
+                                               gss_ctx_id_t* context_handle,
+                                               gss_cred_id_t acceptor_cred_handle,
+                                               gss_buffer_t input_token_buffer,
+                                               gss_channel_bindings_t input_chan_bindings,
+                                               gss_name_t* src_name,
+                                               gss_OID* mech_type,
+                                               gss_buffer_t output_token,
+                                               OM_uint32* ret_flags,
+                                               OM_uint32* time_rec,
+                                               gss_cred_id_t* delegated_cred_handle) {
+    *minor_status = 0;
+    mock_empty_buffer(output_token);
+    if (delegated_cred_handle != NULL) {
+        *delegated_cred_handle = GSS_C_NO_CREDENTIAL;
+    }
+
+    int32_t code = mock_enter(GSS_MOCK_ACCEPT_SEC_CONTEXT);
+    if (code) {
+        return mock_failure(minor_status, GSS_S_FAILURE, code);
+    }
+
+    if (*context_handle != GSS_C_NO_CONTEXT) {
+        return GSS_S_FAILURE;
+    }
+
+    std::vector<std::string> fields = mock_split(input_token_buffer);
+    if (fields.size() != 4 || fields[0] != GSS_MOCK_AP_REQ) {
+        return GSS_S_DEFECTIVE_TOKEN;
+    }
+
+    if (!mock_in_keytab(fields[2])) {
+        return mock_failure(minor_status, GSS_S_FAILURE, KRB5_KT_NOTFOUND);
+    }
+
+    gss_ctx_id_t context = new gss_ctx_id_struct();
+    context->initiator = false;
+    context->open = true;
+    context->flags = (OM_uint32)strtoul(fields[3].c_str(), NULL, 10);
+    context->source = fields[1];
+    context->target = fields[2];
+    *context_handle = context;
+
+    if (src_name != NULL) {
+        *src_name = mock_name(context->source);
+    }
+
+    if ((context->flags & GSS_C_DELEG_FLAG) && delegated_cred_handle != NULL) {
+        *delegated_cred_handle = new gss_cred_id_struct{context->source, GSS_C_INITIATE};
+    }
+
+    if (context->flags & GSS_C_MUTUAL_FLAG) {
+        mock_buffer(output_token, GSS_MOCK_AP_REP);
+    }
+
+    if (mech_type != NULL) *mech_type = (gss_OID)gss_mech_krb5;
+    if (ret_flags != NULL) *ret_flags = context->flags;
+    if (time_rec != NULL) *time_rec = GSS_MOCK_LIFETIME;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_delete_sec_context(OM_uint32* minor_status,
+                                               gss_ctx_id_t* context_handle,
+                                               gss_buffer_t output_token) {
+    *minor_status = 0;
+    mock_empty_buffer(output_token);
+    if (*context_handle == GSS_C_NO_CONTEXT) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    delete *context_handle;
+    *context_handle = GSS_C_NO_CONTEXT;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_inquire_context(OM_uint32* minor_status,
+                                            gss_ctx_id_t context_handle,
+                                            gss_name_t* src_name,
+                                            gss_name_t* targ_name,
+                                            OM_uint32* lifetime_rec,
+                                            gss_OID* mech_type,
+                                            OM_uint32* ctx_flags,
+                                            int* locally_initiated,
+                                            int* open) {
+    *minor_status = 0;
+    if (context_handle == GSS_C_NO_CONTEXT) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    if (src_name != NULL) *src_name = mock_name(context_handle->source);
+    if (targ_name != NULL) *targ_name = mock_name(context_handle->target);
+    if (lifetime_rec != NULL) *lifetime_rec = GSS_MOCK_LIFETIME;
+    if (mech_type != NULL) *mech_type = (gss_OID)gss_mech_krb5;
+    if (ctx_flags != NULL) *ctx_flags = context_handle->flags;
+    if (locally_initiated != NULL) *locally_initiated = context_handle->initiator;
+    if (open != NULL) *open = context_handle->open;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_wrap(OM_uint32* minor_status,
+                                 gss_ctx_id_t context_handle,
+                                 int conf_req_flag,
+                                 gss_qop_t qop_req,
+                                 gss_buffer_t input_message_buffer,
+                                 int* conf_state,
+                                 gss_buffer_t output_message_buffer) {
+    *minor_status = 0;
+    mock_empty_buffer(output_message_buffer);
+    if (context_handle == GSS_C_NO_CONTEXT || !context_handle->open) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    int32_t code = mock_enter(GSS_MOCK_WRAP);
+    if (code) {
+        return mock_failure(minor_status, GSS_S_FAILURE, code);
+    }
+
+    std::string token(GSS_MOCK_WRAP_PREFIX);
+    token += conf_req_flag ? '1' : '0';
+    token.append((const char*)input_message_buffer->value, input_message_buffer->length);
+    mock_buffer(output_message_buffer, token);
+    if (conf_state != NULL) *conf_state = conf_req_flag ? 1 : 0;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_wrap_size_limit(OM_uint32* minor_status,
+                                            gss_ctx_id_t context_handle,
+                                            int conf_req_flag,
+                                            gss_qop_t qop_req,
+                                            OM_uint32 req_output_size,
+                                            OM_uint32* max_input_size) {
+    // a wrapped message is the prefix, the confidentiality flag and the message
+    static const OM_uint32 header = sizeof(GSS_MOCK_WRAP_PREFIX);
+    *minor_status = 0;
+    if (context_handle == GSS_C_NO_CONTEXT || !context_handle->open) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    *max_input_size = (req_output_size > header) ? req_output_size - header : 0;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_unwrap(OM_uint32* minor_status,
+                                   gss_ctx_id_t context_handle,
+                                   gss_buffer_t input_message_buffer,
+                                   gss_buffer_t output_message_buffer,
+                                   int* conf_state,
+                                   gss_qop_t* qop_state) {
+    static const size_t header = sizeof(GSS_MOCK_WRAP_PREFIX);
+    *minor_status = 0;
+    mock_empty_buffer(output_message_buffer);
+    if (context_handle == GSS_C_NO_CONTEXT || !context_handle->open) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    int32_t code = mock_enter(GSS_MOCK_UNWRAP);
+    if (code) {
+        return mock_failure(minor_status, GSS_S_BAD_SIG, code);
+    }
+
+    const char* token = (const char*)input_message_buffer->value;
+    if (input_message_buffer->length < header ||
+        memcmp(token, GSS_MOCK_WRAP_PREFIX, header - 1) != 0) {
+        return GSS_S_DEFECTIVE_TOKEN;
+    }
+
+    mock_buffer(output_message_buffer,
+                std::string(token + header, input_message_buffer->length - header));
+    if (conf_state != NULL) *conf_state = (token[header - 1] == '1');
+    if (qop_state != NULL) *qop_state = GSS_C_QOP_DEFAULT;
+    return GSS_S_COMPLETE;
+}
+
+// A MIC is the prefix, a sequence number and a hash of both the sequence number and the message,
+// FNV-1a, all in hex
+#define GSS_MOCK_MIC_LENGTH (sizeof(GSS_MOCK_MIC_PREFIX) - 1 + 8 + 16)
+
+static std::string mock_mic(uint32_t sequence, gss_buffer_t message) {
+    char sequence_hex[9];
+    snprintf(sequence_hex, sizeof(sequence_hex), "%08x", sequence);
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < 8; ++i) {
+        hash = (hash ^ (unsigned char)sequence_hex[i]) * 1099511628211ULL;
+    }
+
+    const unsigned char* bytes = (const unsigned char*)message->value;
+    for (size_t i = 0; i < message->length; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+
+    char digest[17];
+    snprintf(digest, sizeof(digest), "%016llx", (unsigned long long)hash);
+    return std::string(GSS_MOCK_MIC_PREFIX) + sequence_hex + digest;
+}
+
+OM_uint32 KRB5_CALLCONV gss_get_mic(OM_uint32* minor_status,
+                                    gss_ctx_id_t context_handle,
+                                    gss_qop_t qop_req,
+                                    gss_buffer_t message_buffer,
+                                    gss_buffer_t message_token) {
+    *minor_status = 0;
+    mock_empty_buffer(message_token);
+    if (context_handle == GSS_C_NO_CONTEXT || !context_handle->open) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    int32_t code = mock_enter(GSS_MOCK_WRAP);
+    if (code) {
+        return mock_failure(minor_status, GSS_S_FAILURE, code);
+    }
+
+    mock_buffer(message_token, mock_mic(context_handle->mic_sequence++, message_buffer));
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_verify_mic(OM_uint32* minor_status,
+                                       gss_ctx_id_t context_handle,
+                                       gss_buffer_t message_buffer,
+                                       gss_buffer_t message_token,
+                                       gss_qop_t* qop_state) {
+    *minor_status = 0;
+    if (context_handle == GSS_C_NO_CONTEXT || !context_handle->open) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    int32_t code = mock_enter(GSS_MOCK_UNWRAP);
+    if (code) {
+        return mock_failure(minor_status, GSS_S_FAILURE, code);
+    }
+
+    const size_t header = sizeof(GSS_MOCK_MIC_PREFIX) - 1;
+    const char* token = (const char*)message_token->value;
+    if (message_token->length != GSS_MOCK_MIC_LENGTH ||
+        memcmp(token, GSS_MOCK_MIC_PREFIX, header) != 0) {
+        return GSS_S_DEFECTIVE_TOKEN;
+    }
+
+    uint32_t sequence = (uint32_t)strtoul(std::string(token + header, 8).c_str(), NULL, 16);
+    std::string expected = mock_mic(sequence, message_buffer);
+    if (memcmp(token, expected.data(), expected.size()) != 0) {
+        return GSS_S_BAD_SIG;
+    }
+
+    if (qop_state != NULL) *qop_state = GSS_C_QOP_DEFAULT;
+
+    // like krb5, a MIC which verifies but was seen before is reported as a duplicate
+    if (!context_handle->mics_seen.insert(sequence).second) {
+        return GSS_S_COMPLETE | GSS_S_DUPLICATE_TOKEN;
+    }
+
+    return GSS_S_COMPLETE;
+}
+
+// The IOV calls produce and accept the same tokens as `gss_wrap`/`gss_unwrap`: the header is the
+// prefix and the confidentiality flag, there is no padding or trailer
+static gss_iov_buffer_desc* mock_iov_buffer(gss_iov_buffer_desc* iov,
+                                            int iov_count,
+                                            OM_uint32 type) {
+    for (int i = 0; i < iov_count; ++i) {
+        if ((iov[i].type & ~GSS_IOV_BUFFER_FLAG_ALLOCATE) == type) {
+            return &iov[i];
+        }
+    }
+
+    return NULL;
+}
+
+OM_uint32 KRB5_CALLCONV gss_wrap_iov_length(OM_uint32* minor_status,
+                                            gss_ctx_id_t context_handle,
+                                            int conf_req_flag,
+                                            gss_qop_t qop_req,
+                                            int* conf_state,
+                                            gss_iov_buffer_desc* iov,
+                                            int iov_count) {
+    *minor_status = 0;
+    if (context_handle == GSS_C_NO_CONTEXT || !context_handle->open) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    gss_iov_buffer_desc* header = mock_iov_buffer(iov, iov_count, GSS_IOV_BUFFER_TYPE_HEADER);
+    if (header == NULL) {
+        return GSS_S_CALL_BAD_STRUCTURE;
+    }
+
+    header->buffer.length = sizeof(GSS_MOCK_WRAP_PREFIX);
+    for (OM_uint32 type : {GSS_IOV_BUFFER_TYPE_PADDING, GSS_IOV_BUFFER_TYPE_TRAILER}) {
+        gss_iov_buffer_desc* buffer = mock_iov_buffer(iov, iov_count, type);
+        if (buffer != NULL) buffer->buffer.length = 0;
+    }
+
+    if (conf_state != NULL) *conf_state = conf_req_flag ? 1 : 0;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_wrap_iov(OM_uint32* minor_status,
+                                     gss_ctx_id_t context_handle,
+                                     int conf_req_flag,
+                                     gss_qop_t qop_req,
+                                     int* conf_state,
+                                     gss_iov_buffer_desc* iov,
+                                     int iov_count) {
+    static const size_t header_length = sizeof(GSS_MOCK_WRAP_PREFIX);
+    *minor_status = 0;
+    if (context_handle == GSS_C_NO_CONTEXT || !context_handle->open) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    int32_t code = mock_enter(GSS_MOCK_WRAP);
+    if (code) {
+        return mock_failure(minor_status, GSS_S_FAILURE, code);
+    }
+
+    gss_iov_buffer_desc* header = mock_iov_buffer(iov, iov_count, GSS_IOV_BUFFER_TYPE_HEADER);
+    if (header == NULL || header->buffer.length < header_length) {
+        return GSS_S_CALL_BAD_STRUCTURE;
+    }
+
+    char* value = (char*)header->buffer.value;
+    memcpy(value, GSS_MOCK_WRAP_PREFIX, header_length - 1);
+    value[header_length - 1] = conf_req_flag ? '1' : '0';
+    header->buffer.length = header_length;
+    for (OM_uint32 type : {GSS_IOV_BUFFER_TYPE_PADDING, GSS_IOV_BUFFER_TYPE_TRAILER}) {
+        gss_iov_buffer_desc* buffer = mock_iov_buffer(iov, iov_count, type);
+        if (buffer != NULL) buffer->buffer.length = 0;
+    }
+
+    if (conf_state != NULL) *conf_state = conf_req_flag ? 1 : 0;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_unwrap_iov(OM_uint32* minor_status,
+                                       gss_ctx_id_t context_handle,
+                                       int* conf_state,
+                                       gss_qop_t* qop_state,
+                                       gss_iov_buffer_desc* iov,
+                                       int iov_count) {
+    static const size_t header_length = sizeof(GSS_MOCK_WRAP_PREFIX);
+    *minor_status = 0;
+    if (context_handle == GSS_C_NO_CONTEXT || !context_handle->open) {
+        return GSS_S_NO_CONTEXT;
+    }
+
+    int32_t code = mock_enter(GSS_MOCK_UNWRAP);
+    if (code) {
+        return mock_failure(minor_status, GSS_S_BAD_SIG, code);
+    }
+
+    // only the STREAM layout is supported
+    gss_iov_buffer_desc* stream = mock_iov_buffer(iov, iov_count, GSS_IOV_BUFFER_TYPE_STREAM);
+    gss_iov_buffer_desc* data = mock_iov_buffer(iov, iov_count, GSS_IOV_BUFFER_TYPE_DATA);
+    if (stream == NULL || data == NULL) {
+        return GSS_S_CALL_BAD_STRUCTURE;
+    }
+
+    const char* token = (const char*)stream->buffer.value;
+    if (stream->buffer.length < header_length ||
+        memcmp(token, GSS_MOCK_WRAP_PREFIX, header_length - 1) != 0) {
+        return GSS_S_DEFECTIVE_TOKEN;
+    }
+
+    data->buffer.value = (void*)(token + header_length);
+    data->buffer.length = stream->buffer.length - header_length;
+    if (conf_state != NULL) *conf_state = (token[header_length - 1] == '1');
+    if (qop_state != NULL) *qop_state = GSS_C_QOP_DEFAULT;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_acquire_cred(OM_uint32* minor_status,
+                                         gss_name_t desired_name,
+                                         OM_uint32 time_req,
+                                         gss_OID_set desired_mechs,
+                                         gss_cred_usage_t cred_usage,
+                                         gss_cred_id_t* output_cred_handle,
+                                         gss_OID_set* actual_mechs,
+                                         OM_uint32* time_rec) {
+    *minor_status = 0;
+    *output_cred_handle = GSS_C_NO_CREDENTIAL;
+    int32_t code = mock_enter(GSS_MOCK_ACQUIRE_CRED);
+    if (code) {
+        return mock_failure(minor_status, GSS_S_NO_CRED, code);
+    }
+
+    std::string principal;
+    if (desired_name != GSS_C_NO_NAME) {
+        principal = mock_principal(desired_name);
+    } else if (cred_usage != GSS_C_ACCEPT) {
+        mock_settings(NULL, &principal, NULL);
+    }
+
+    if (cred_usage == GSS_C_ACCEPT && !principal.empty() && !mock_in_keytab(principal)) {
+        return mock_failure(minor_status, GSS_S_NO_CRED, KRB5_KT_NOTFOUND);
+    }
+
+    *output_cred_handle = new gss_cred_id_struct{principal, cred_usage};
+    if (actual_mechs != NULL) *actual_mechs = GSS_C_NO_OID_SET;
+    if (time_rec != NULL) *time_rec = GSS_MOCK_LIFETIME;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_acquire_cred_with_password(OM_uint32* minor_status,
+                                                       const gss_name_t desired_name,
+                                                       const gss_buffer_t password,
+                                                       OM_uint32 time_req,
+                                                       const gss_OID_set desired_mechs,
+                                                       gss_cred_usage_t cred_usage,
+                                                       gss_cred_id_t* output_cred_handle,
+                                                       gss_OID_set* actual_mechs,
+                                                       OM_uint32* time_rec) {
+    *minor_status = 0;
+    *output_cred_handle = GSS_C_NO_CREDENTIAL;
+    int32_t code = mock_enter(GSS_MOCK_ACQUIRE_CRED);
+    if (code) {
+        return mock_failure(minor_status, GSS_S_FAILURE, code);
+    }
+
+    std::string expected;
+    mock_settings(NULL, NULL, &expected);
+    if (!expected.empty() &&
+        expected != std::string((const char*)password->value, password->length)) {
+        return mock_failure(minor_status, GSS_S_FAILURE, KRB5KDC_ERR_PREAUTH_FAILED);
+    }
+
+    *output_cred_handle = new gss_cred_id_struct{mock_principal(desired_name), cred_usage};
+    if (actual_mechs != NULL) *actual_mechs = GSS_C_NO_OID_SET;
+    if (time_rec != NULL) *time_rec = GSS_MOCK_LIFETIME;
+    return GSS_S_COMPLETE;
+}
+
+OM_uint32 KRB5_CALLCONV gss_release_cred(OM_uint32* minor_status, gss_cred_id_t* cred_handle) {
+    *minor_status = 0;
+    if (*cred_handle == GSS_C_NO_CREDENTIAL) {
+        return GSS_S_NO_CRED;
+    }
+
+    delete *cred_handle;
+    *cred_handle = GSS_C_NO_CREDENTIAL;
+    return GSS_S_COMPLETE;
+}
+
+// Keytab entries carry real principals, parsed and freed with the system library
+
+krb5_error_code KRB5_CALLCONV krb5_kt_default(krb5_context context, krb5_keytab* id) {
+    krb5_error_code code = mock_enter(GSS_MOCK_KEYTAB);
+    if (code) {
+        return code;
+    }
+
+    *id = (krb5_keytab)&mock_keytab;
+    return 0;
+}
+
+krb5_error_code KRB5_CALLCONV krb5_kt_start_seq_get(krb5_context context,
+                                                    krb5_keytab keytab,
+                                                    krb5_kt_cursor* cursor) {
+    gss_mock_kt_cursor* position = new gss_mock_kt_cursor();
+    {
+        std::lock_guard<std::mutex> lock(mock_mutex);
+        position->principals = mock_config.keytab;
+    }
+
+    position->next = 0;
+    *cursor = (krb5_kt_cursor)position;
+    return 0;
+}
+
+krb5_error_code KRB5_CALLCONV krb5_kt_next_entry(krb5_context context,
+                                                 krb5_keytab keytab,
+                                                 krb5_keytab_entry* entry,
+                                                 krb5_kt_cursor* cursor) {
+    gss_mock_kt_cursor* position = (gss_mock_kt_cursor*)*cursor;
+    if (position->next >= position->principals.size()) {
+        return KRB5_KT_END;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    return krb5_parse_name(
+        context, position->principals[position->next++].c_str(), &entry->principal);
+}
+
+krb5_error_code KRB5_CALLCONV krb5_kt_end_seq_get(krb5_context context,
+                                                  krb5_keytab keytab,
+                                                  krb5_kt_cursor* cursor) {
+    delete (gss_mock_kt_cursor*)*cursor;
+    *cursor = NULL;
+    return 0;
+}
+
+krb5_error_code KRB5_CALLCONV krb5_kt_close(krb5_context context, krb5_keytab keytab) {
+    return 0;
+}
+
+krb5_error_code KRB5_CALLCONV krb5_free_keytab_entry_contents(krb5_context context,
+                                                              krb5_keytab_entry* entry) {
+    krb5_free_principal(context, entry->principal);
+    entry->principal = NULL;
+    return 0;
+}
+
+krb5_error_code KRB5_CALLCONV krb5_get_init_creds_password(krb5_context context,
+                                                           krb5_creds* creds,
+                                                           krb5_principal client,
+                                                           const char* password,
+                                                           krb5_prompter_fct prompter,
+                                                           void* data,
+                                                           krb5_deltat start_time,
+                                                           const char* in_tkt_service,
+                                                           krb5_get_init_creds_opt* options) {
+    krb5_error_code code = mock_enter(GSS_MOCK_GET_INIT_CREDS_PASSWORD);
+    if (code) {
+        return code;
+    }
+
+    std::string expected;
+    mock_settings(NULL, NULL, &expected);
+    if (!expected.empty() && expected != password) {
+        return KRB5KDC_ERR_PREAUTH_FAILED;
+    }
+
+    return 0;
+}
+
+}  // extern "C"
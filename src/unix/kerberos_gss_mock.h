@@ -0,0 +1,80 @@
+#ifndef KERBEROS_GSS_MOCK_H
+#define KERBEROS_GSS_MOCK_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// A stand-in for the parts of GSSAPI and krb5 which need a KDC or a keytab: establishing and
+// accepting contexts, wrap/unwrap and MICs, acquiring credentials, password verification and keytab
+// iteration. It is compiled into the addon in place of those calls when building with
+// `node-gyp rebuild -- -Dkerberos_gss_mock=true` (Linux only); names, status text and everything
+// else still come from the system libraries. Tokens are plain text and carry no cryptography,
+// so it must never be used outside of tests and benchmarks.
+//
+// Every mocked call sleeps for a delay drawn from a configurable distribution and then fails
+// with a configurable probability. Draws come from a single seeded sequence, so a sequential
+// run is reproducible.
+
+// The groups of calls whose latency and failures are configured together
+enum gss_mock_call {
+    GSS_MOCK_INIT_SEC_CONTEXT,
+    GSS_MOCK_ACCEPT_SEC_CONTEXT,
+    // also `gss_get_mic` and `gss_verify_mic` respectively
+    GSS_MOCK_WRAP,
+    GSS_MOCK_UNWRAP,
+    GSS_MOCK_ACQUIRE_CRED,
+    GSS_MOCK_GET_INIT_CREDS_PASSWORD,
+    GSS_MOCK_KEYTAB,
+    GSS_MOCK_CALLS
+};
+
+enum gss_mock_distribution {
+    GSS_MOCK_CONSTANT,
+    GSS_MOCK_UNIFORM,
+    GSS_MOCK_EXPONENTIAL,
+    GSS_MOCK_LOGNORMAL
+};
+
+typedef struct {
+    gss_mock_distribution distribution;
+    // In milliseconds: the delay (constant), the lower bound (uniform), the mean (exponential)
+    // or the median (lognormal)
+    double latency;
+    // The upper bound in milliseconds (uniform) or the shape parameter (lognormal)
+    double spread;
+    // Probability in [0, 1] of failing the call after the delay
+    double error_rate;
+    // The krb5 error code of injected failures, reported as the minor status by GSS calls
+    int32_t error_code;
+} gss_mock_behaviour;
+
+typedef struct {
+    uint64_t seed;
+    std::string realm;
+    // The principal of the default initiator credentials
+    std::string principal;
+    // When set, the only password accepted for any principal
+    std::string password;
+    // The principals listed by keytab iteration. When set, contexts can only be accepted, and
+    // acceptor credentials acquired, for these principals.
+    std::vector<std::string> keytab;
+    gss_mock_behaviour calls[GSS_MOCK_CALLS];
+} gss_mock_config;
+
+// The camelCase name of a call group, as used by the JS configuration
+const char* gss_mock_call_name(int call);
+
+// No latency or failures, the realm `MOCK.LOCAL` and the principal `user@MOCK.LOCAL`
+gss_mock_config gss_mock_default_config();
+
+// The number of calls made to a call group since the last `gss_mock_configure`, e.g. to count
+// the requests which would have reached a KDC
+uint64_t gss_mock_calls(int call);
+
+// Replaces the configuration, restarts the random sequence and resets the call counts. Safe to
+// call while calls are in flight, which pick up the new behaviour on their next call.
+void gss_mock_configure(const gss_mock_config& config);
+
+#endif
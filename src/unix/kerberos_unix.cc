@@ -1,48 +1,175 @@
 #include <memory>
+#include <vector>
 
 #include "../kerberos.h"
+#include "../kerberos_challenge.h"
+#include "../kerberos_context_table.h"
+#include "../kerberos_slab.h"
+#include "../kerberos_trace.h"
 #include "../kerberos_worker.h"
 
+#ifdef KERBEROS_GSS_MOCK
+#include "kerberos_gss_mock.h"
+#endif
+
 #define GSS_MECH_OID_KRB5 9
 #define GSS_MECH_OID_SPNEGO 6
 
+// SASL security layer buffers are announced in three bytes
+#define SASL_DEFAULT_BUFFER_SIZE 65536
+#define SASL_MAX_BUFFER_SIZE 0xFFFFFF
+
 static char krb5_mech_oid_bytes[] = "\x2a\x86\x48\x86\xf7\x12\x01\x02\x02";
 gss_OID_desc krb5_mech_oid = {9, &krb5_mech_oid_bytes};
 
 static char spnego_mech_oid_bytes[] = "\x2b\x06\x01\x05\x05\x02";
 gss_OID_desc spnego_mech_oid = {6, &spnego_mech_oid_bytes};
 
+// Maps a SASL `qop` name (RFC 2222) to its security layer, or 0 if it isn't one
+static int SaslLayer(const std::string& qop) {
+    if (qop.empty() || qop == "auth") {
+        return GSS_AUTH_P_NONE;
+    } else if (qop == "auth-int") {
+        return GSS_AUTH_P_INTEGRITY;
+    } else if (qop == "auth-conf") {
+        return GSS_AUTH_P_PRIVACY;
+    }
+
+    return 0;
+}
+
+// A Buffer sharing `length` bytes of `buffer`'s memory from `offset`, like `buffer.subarray`
+static v8::Local<v8::Object> BufferView(v8::Local<v8::Object> buffer,
+                                        size_t offset,
+                                        size_t length) {
+    v8::Local<v8::Uint8Array> view = buffer.As<v8::Uint8Array>();
+    return node::Buffer::New(
+               v8::Isolate::GetCurrent(), view->Buffer(), view->ByteOffset() + offset, length)
+        .ToLocalChecked();
+}
+
+// Collects the memory of `value`, a Buffer or, for a batch, an array of Buffers, into `buffers`,
+// and the Buffers themselves into `pinned` so that they can be kept referenced while they are in
+// use. Throws and returns false if `value` is neither.
+static bool MessageBuffers(v8::Local<v8::Value> value,
+                           bool batch,
+                           const char* name,
+                           v8::Local<v8::Array> pinned,
+                           std::vector<gss_buffer_desc>* buffers) {
+    v8::Local<v8::Array> array;
+    if (batch && value->IsArray()) {
+        array = value.As<v8::Array>();
+    } else if (!batch && node::Buffer::HasInstance(value)) {
+        array = Nan::New<v8::Array>(1);
+        Nan::Set(array, 0, value);
+    } else {
+        std::string message = std::string("`") + name + "` must be " +
+                              (batch ? "an array of Buffers" : "a Buffer");
+        Nan::ThrowTypeError(message.c_str());
+        return false;
+    }
+
+    uint32_t offset = pinned->Length();
+    for (uint32_t i = 0; i < array->Length(); ++i) {
+        v8::Local<v8::Value> element = Nan::Get(array, i).ToLocalChecked();
+        if (!node::Buffer::HasInstance(element)) {
+            std::string message = std::string("`") + name + "` must be an array of Buffers";
+            Nan::ThrowTypeError(message.c_str());
+            return false;
+        }
+
+        gss_buffer_desc buffer;
+        buffer.value = node::Buffer::Data(element);
+        buffer.length = node::Buffer::Length(element);
+        buffers->push_back(buffer);
+        Nan::Set(pinned, offset + i, element);
+    }
+
+    return true;
+}
+
+// Builds the error reported for a failed operation. The GSS status text was already formatted and
+// cached on the worker thread when the error was created, see `gss_status_message_prepare`.
+static v8::Local<v8::Value> GssError(gss_result* result) {
+    std::string message = (result->message != NULL)
+                              ? std::string(result->message)
+                              : gss_status_message(result->major_status, result->minor_status);
+    v8::Local<v8::Value> error = Nan::Error(message.c_str());
+    v8::Local<v8::Object> object = Nan::To<v8::Object>(error).ToLocalChecked();
+    Nan::Set(object, Nan::New("majorCode").ToLocalChecked(), Nan::New(result->major_status));
+    Nan::Set(object, Nan::New("minorCode").ToLocalChecked(), Nan::New(result->minor_status));
+    Nan::Set(object,
+             Nan::New("retryable").ToLocalChecked(),
+             Nan::New(gss_status_retryable(result->major_status, result->minor_status)));
+
+    // completions run with their operation marked current, see `KerberosWorker`
+    uint64_t operation_id = KerberosTraceCurrentOperationId();
+    if (operation_id != 0) {
+        Nan::Set(object,
+                 Nan::New("operationId").ToLocalChecked(),
+                 Nan::New<v8::Number>((double)operation_id));
+    }
+    return error;
+}
+
+// A wrap token only hides its data when confidentiality was applied. Otherwise it carries the
+// plaintext, so like decrypted output it gets a Buffer of its own rather than a slab slice.
+static v8::Local<v8::Object> WrappedBuffer(const char* data, size_t length, bool confidential) {
+    if (confidential) {
+        return KerberosSlabBuffer(data, length);
+    }
+
+    return Nan::CopyBuffer(data, (uint32_t)length).ToLocalChecked();
+}
+
+static v8::Local<v8::Value> StringOrNull(const char* value) {
+    if (value == NULL) {
+        return Nan::Null();
+    }
+
+    return Nan::New(value).ToLocalChecked();
+}
+
 /// KerberosClient
 KerberosClient::~KerberosClient() {
     if (_state != NULL) {
-        authenticate_gss_client_clean(_state);
-        _state = NULL;
+        ReleaseState();
     }
 }
 
+void KerberosClient::ReleaseState() {
+    authenticate_gss_client_clean(_state);
+    gss_client_state_free(_state);
+    _state = NULL;
+    KerberosMemoryReport();
+}
+
 NAN_METHOD(KerberosClient::Step) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    std::string challenge(*Nan::Utf8String(info[0]));
-    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[0]);
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    bool details = BooleanOptionValue(options, "details", false);
 
     KerberosWorker::Run(callback, "kerberos:ClientStep", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
-        std::shared_ptr<gss_result> result(
-            authenticate_gss_client_step(client->state(), challenge.c_str(), NULL), ResultDeleter);
+        gss_result* result = authenticate_gss_client_step(client->state(), challenge->c_str(), NULL);
 
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
-                worker->Call(2, argv);
-                return;
-            }
-
-            v8::Local<v8::Value> response = Nan::Null();
-            if (client->state()->response != NULL) {
-                response = Nan::New(client->state()->response).ToLocalChecked();
+                argv[0] = GssError(result);
+            } else if (details) {
+                argv[1] = client->StepResult();
+            } else {
+                argv[1] = StringOrNull(client->state()->response);
             }
 
-            v8::Local<v8::Value> argv[] = {Nan::Null(), response};
+            client->EndOperation();
             worker->Call(2, argv);
         });
     });
@@ -50,22 +177,34 @@ NAN_METHOD(KerberosClient::Step) {
 
 NAN_METHOD(KerberosClient::UnwrapData) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    std::string challenge(*Nan::Utf8String(info[0]));
-    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[0]);
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    bool binary = BooleanOptionValue(options, "binary", false);
 
     KerberosWorker::Run(callback, "kerberos:ClientUnwrap", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
-        std::shared_ptr<gss_result> result(
-            authenticate_gss_client_unwrap(client->state(), challenge.c_str()), ResultDeleter);
+        gss_result* result =
+            authenticate_gss_client_unwrap(client->state(), challenge->c_str(), binary);
 
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
-                worker->Call(2, argv);
-                return;
+                argv[0] = GssError(result);
+            } else if (binary) {
+                // plaintext gets memory of its own, a slab slice would expose the whole slab
+                argv[1] = Nan::CopyBuffer(client->state()->output,
+                                          (uint32_t)client->state()->output_length)
+                              .ToLocalChecked();
+            } else {
+                argv[1] = Nan::New(client->state()->response).ToLocalChecked();
             }
 
-            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::New(client->state()->response).ToLocalChecked()};
+            client->EndOperation();
             worker->Call(2, argv);
         });
     });
@@ -73,99 +212,563 @@ NAN_METHOD(KerberosClient::UnwrapData) {
 
 NAN_METHOD(KerberosClient::WrapData) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    std::string challenge(*Nan::Utf8String(info[0]));
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[0]);
     v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
     Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
     std::string user = StringOptionValue(options, "user");
+    bool binary = BooleanOptionValue(options, "binary", false);
 
     int protect = 0; // NOTE: this should be an option
 
     KerberosWorker::Run(callback, "kerberos:ClientWrap", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
-        std::shared_ptr<gss_result> result(authenticate_gss_client_wrap(
-            client->state(), challenge.c_str(), user.c_str(), protect), ResultDeleter);
+        gss_result* result = authenticate_gss_client_wrap(
+            client->state(), challenge->c_str(), user.c_str(), protect, binary);
 
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
-                worker->Call(2, argv);
-                return;
+                argv[0] = GssError(result);
+            } else if (binary) {
+                argv[1] = WrappedBuffer(client->state()->output,
+                                        client->state()->output_length,
+                                        client->state()->responseConf != 0);
+            } else {
+                argv[1] = Nan::New(client->state()->response).ToLocalChecked();
+            }
+
+            client->EndOperation();
+            worker->Call(2, argv);
+        });
+    });
+}
+
+// Signs one message, or each of a batch of them in a single dispatch, resolving to Buffers
+void KerberosClient::GetMicOperation(const Nan::FunctionCallbackInfo<v8::Value>& info,
+                                     bool batch) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    v8::Local<v8::Array> pinned = Nan::New<v8::Array>();
+    std::shared_ptr<std::vector<gss_buffer_desc>> messages =
+        std::make_shared<std::vector<gss_buffer_desc>>();
+    if (!MessageBuffers(info[0], batch, batch ? "messages" : "message", pinned, messages.get())) {
+        return;
+    }
+
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    // the messages are signed where they are, so they stay referenced until the MICs are made
+    Nan::Persistent<v8::Array>* inputs = new Nan::Persistent<v8::Array>(pinned);
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+    std::shared_ptr<std::vector<gss_buffer_desc>> mics =
+        std::make_shared<std::vector<gss_buffer_desc>>(messages->size());
+
+    KerberosWorker::Run(callback, "kerberos:ClientGetMic", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        gss_result* result = authenticate_gss_client_get_mic(
+            client->state(), messages->data(), messages->size(), mics->data());
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
+            if (result->code == AUTH_GSS_ERROR) {
+                argv[0] = GssError(result);
+            } else if (batch) {
+                v8::Local<v8::Array> results = Nan::New<v8::Array>((int)mics->size());
+                for (size_t i = 0; i < mics->size(); ++i) {
+                    const gss_buffer_desc& mic = (*mics)[i];
+                    Nan::Set(
+                        results, (uint32_t)i, KerberosSlabBuffer((char*)mic.value, mic.length));
+                }
+
+                argv[1] = results;
+            } else {
+                argv[1] = KerberosSlabBuffer((char*)(*mics)[0].value, (*mics)[0].length);
+            }
+
+            inputs->Reset();
+            delete inputs;
+            client->EndOperation();
+            worker->Call(2, argv);
+        });
+    });
+}
+
+// Checks one MIC, or a batch of them in a single dispatch, resolving to whether each is valid
+void KerberosClient::VerifyMicOperation(const Nan::FunctionCallbackInfo<v8::Value>& info,
+                                        bool batch) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    v8::Local<v8::Array> pinned = Nan::New<v8::Array>();
+    std::shared_ptr<std::vector<gss_buffer_desc>> messages =
+        std::make_shared<std::vector<gss_buffer_desc>>();
+    std::shared_ptr<std::vector<gss_buffer_desc>> mics =
+        std::make_shared<std::vector<gss_buffer_desc>>();
+    if (!MessageBuffers(info[0], batch, batch ? "messages" : "message", pinned, messages.get()) ||
+        !MessageBuffers(info[1], batch, batch ? "mics" : "mic", pinned, mics.get())) {
+        return;
+    }
+
+    if (messages->size() != mics->size()) {
+        return Nan::ThrowRangeError("There must be one MIC for each message");
+    }
+
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    Nan::Persistent<v8::Array>* inputs = new Nan::Persistent<v8::Array>(pinned);
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    size_t count = messages->size();
+    std::shared_ptr<bool> valid(new bool[count](), std::default_delete<bool[]>());
+
+    KerberosWorker::Run(callback, "kerberos:ClientVerifyMic", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        gss_result* result = authenticate_gss_client_verify_mic(
+            client->state(), messages->data(), mics->data(), count, valid.get());
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
+            if (result->code == AUTH_GSS_ERROR) {
+                argv[0] = GssError(result);
+            } else if (batch) {
+                v8::Local<v8::Array> results = Nan::New<v8::Array>((int)count);
+                for (size_t i = 0; i < count; ++i) {
+                    Nan::Set(results, (uint32_t)i, Nan::New(valid.get()[i]));
+                }
+
+                argv[1] = results;
+            } else {
+                argv[1] = Nan::New(valid.get()[0]);
             }
 
-            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::New(client->state()->response).ToLocalChecked()};
+            inputs->Reset();
+            delete inputs;
+            client->EndOperation();
             worker->Call(2, argv);
         });
     });
 }
 
+NAN_METHOD(KerberosClient::GetMic) {
+    GetMicOperation(info, false);
+}
+
+NAN_METHOD(KerberosClient::GetMics) {
+    GetMicOperation(info, true);
+}
+
+NAN_METHOD(KerberosClient::VerifyMic) {
+    VerifyMicOperation(info, false);
+}
+
+NAN_METHOD(KerberosClient::VerifyMics) {
+    VerifyMicOperation(info, true);
+}
+
+NAN_METHOD(KerberosClient::WrapOverhead) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    size_t length = (size_t)Nan::To<double>(info[0]).FromJust();
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    int protect = BooleanOptionValue(options, "protect", true) ? 1 : 0;
+
+    KerberosWorker::Run(callback, "kerberos:ClientWrapOverhead", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        size_t header = 0;
+        size_t trailer = 0;
+        gss_result* result = authenticate_gss_client_wrap_iov_length(
+            client->state(), length, protect, &header, &trailer);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
+            if (result->code == AUTH_GSS_ERROR) {
+                argv[0] = GssError(result);
+            } else {
+                v8::Local<v8::Object> overhead = Nan::New<v8::Object>();
+                Nan::Set(overhead,
+                         Nan::New("header").ToLocalChecked(),
+                         Nan::New<v8::Number>((double)header));
+                Nan::Set(overhead,
+                         Nan::New("trailer").ToLocalChecked(),
+                         Nan::New<v8::Number>((double)trailer));
+                argv[1] = overhead;
+            }
+
+            client->EndOperation();
+            worker->Call(2, argv);
+        });
+    });
+}
+
+NAN_METHOD(KerberosClient::WrapInto) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    if (!node::Buffer::HasInstance(info[0])) {
+        return Nan::ThrowTypeError("`buffer` must be a Buffer");
+    }
+
+    v8::Local<v8::Object> buffer = Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    size_t buffer_length = node::Buffer::Length(buffer);
+    double offset = Nan::To<double>(info[1]).FromJust();
+    double length = Nan::To<double>(info[2]).FromJust();
+    if (!(offset >= 0) || !(length >= 0) || offset + length > buffer_length) {
+        return Nan::ThrowRangeError("The message is not within the buffer");
+    }
+
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    // the Buffer is referenced until the operation completes, its memory is wrapped in place
+    Nan::Persistent<v8::Object>* target = new Nan::Persistent<v8::Object>(buffer);
+    char* data = node::Buffer::Data(buffer);
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[3]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[4]).ToLocalChecked());
+    int protect = BooleanOptionValue(options, "protect", true) ? 1 : 0;
+
+    KerberosWorker::Run(callback, "kerberos:ClientWrapInto", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        size_t token_offset = 0;
+        size_t token_length = 0;
+        gss_result* result = authenticate_gss_client_wrap_in_place(client->state(),
+                                                                   data,
+                                                                   buffer_length,
+                                                                   (size_t)offset,
+                                                                   (size_t)length,
+                                                                   protect,
+                                                                   &token_offset,
+                                                                   &token_length);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
+            if (result->code == AUTH_GSS_ERROR) {
+                argv[0] = GssError(result);
+            } else {
+                argv[1] = BufferView(Nan::New(*target), token_offset, token_length);
+            }
+
+            target->Reset();
+            delete target;
+            client->EndOperation();
+            worker->Call(2, argv);
+        });
+    });
+}
+
+NAN_METHOD(KerberosClient::UnwrapInPlace) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    if (!node::Buffer::HasInstance(info[0])) {
+        return Nan::ThrowTypeError("`buffer` must be a Buffer");
+    }
+
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    v8::Local<v8::Object> buffer = Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    Nan::Persistent<v8::Object>* target = new Nan::Persistent<v8::Object>(buffer);
+    char* token = node::Buffer::Data(buffer);
+    size_t length = node::Buffer::Length(buffer);
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+
+    KerberosWorker::Run(callback, "kerberos:ClientUnwrapInPlace", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        size_t data_offset = 0;
+        size_t data_length = 0;
+        gss_result* result = authenticate_gss_client_unwrap_in_place(
+            client->state(), token, length, &data_offset, &data_length);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
+            if (result->code == AUTH_GSS_ERROR) {
+                argv[0] = GssError(result);
+            } else {
+                argv[1] = BufferView(Nan::New(*target), data_offset, data_length);
+            }
+
+            target->Reset();
+            delete target;
+            client->EndOperation();
+            worker->Call(2, argv);
+        });
+    });
+}
+
+// Steps the context until it is complete, then negotiates the SASL security layer, so that each
+// server payload of a SASL GSSAPI exchange takes a single dispatch
+NAN_METHOD(KerberosClient::SaslStep) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    int layer = SaslLayer(StringOptionValue(options, "qop"));
+    if (layer == 0) {
+        return Nan::ThrowTypeError("`qop` must be one of 'auth', 'auth-int' or 'auth-conf'");
+    }
+
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[0]);
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    std::string user = StringOptionValue(options, "user");
+    OM_uint32 max_receive = UInt32OptionValue(options, "maxBufferSize", SASL_DEFAULT_BUFFER_SIZE);
+    bool negotiate = client->state()->context_complete;
+
+    if (max_receive == 0 || max_receive > SASL_MAX_BUFFER_SIZE) {
+        max_receive = SASL_MAX_BUFFER_SIZE;
+    }
+
+    KerberosWorker::Run(callback, "kerberos:ClientSaslStep", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        gss_result* result =
+            negotiate ? authenticate_gss_client_sasl_negotiate(
+                            client->state(), challenge->c_str(), user.c_str(), layer, max_receive)
+                      : authenticate_gss_client_step(client->state(), challenge->c_str(), NULL);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
+            if (result->code == AUTH_GSS_ERROR) {
+                argv[0] = GssError(result);
+            } else {
+                argv[1] = StringOrNull(client->state()->response);
+            }
+
+            client->EndOperation();
+            worker->Call(2, argv);
+        });
+    });
+}
+
+NAN_METHOD(KerberosClient::SaslWrap) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    // not wrapped by `defineOperation`, so the arguments are checked here
+    if (!node::Buffer::HasInstance(info[0])) {
+        return Nan::ThrowTypeError("`data` must be a Buffer");
+    }
+
+    if (!info[1]->IsFunction()) {
+        return Nan::ThrowTypeError("`callback` must be a function");
+    }
+
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    // the Buffer is referenced until the operation completes, so it is used without a copy
+    v8::Local<v8::Object> data = Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    Nan::Persistent<v8::Object>* input = new Nan::Persistent<v8::Object>(data);
+    const char* bytes = node::Buffer::Data(data);
+    size_t length = node::Buffer::Length(data);
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+
+    KerberosWorker::Run(callback, "kerberos:ClientSaslWrap", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        gss_result* result = authenticate_gss_client_sasl_seal(client->state(), bytes, length);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
+            if (result->code == AUTH_GSS_ERROR) {
+                argv[0] = GssError(result);
+            } else {
+                // sealing fails unless confidentiality was applied as the layer requires
+                argv[1] = WrappedBuffer(client->state()->output,
+                                        client->state()->output_length,
+                                        client->state()->sasl_layer == GSS_AUTH_P_PRIVACY);
+            }
+
+            input->Reset();
+            delete input;
+            client->EndOperation();
+            worker->Call(2, argv);
+        });
+    });
+}
+
+NAN_METHOD(KerberosClient::SaslUnwrap) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    // not wrapped by `defineOperation`, so the arguments are checked here
+    if (!node::Buffer::HasInstance(info[0])) {
+        return Nan::ThrowTypeError("`data` must be a Buffer");
+    }
+
+    if (!info[1]->IsFunction()) {
+        return Nan::ThrowTypeError("`callback` must be a function");
+    }
+
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    v8::Local<v8::Object> data = Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    Nan::Persistent<v8::Object>* input = new Nan::Persistent<v8::Object>(data);
+    const char* bytes = node::Buffer::Data(data);
+    size_t length = node::Buffer::Length(data);
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+
+    KerberosWorker::Run(callback, "kerberos:ClientSaslUnwrap", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        size_t consumed = 0;
+        gss_result* result =
+            authenticate_gss_client_sasl_unseal(client->state(), bytes, length, &consumed);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null(), Nan::Null()};
+            if (result->code == AUTH_GSS_ERROR) {
+                argv[0] = GssError(result);
+            } else {
+                // plaintext, so not from the slab, see `UnwrapData`
+                argv[1] = Nan::CopyBuffer(client->state()->output,
+                                          (uint32_t)client->state()->output_length)
+                              .ToLocalChecked();
+                argv[2] = Nan::New<v8::Number>((double)consumed);
+            }
+
+            input->Reset();
+            delete input;
+            client->EndOperation();
+            worker->Call(3, argv);
+        });
+    });
+}
+
 /// KerberosServer
 KerberosServer::~KerberosServer() {
     if (_state != NULL) {
-        authenticate_gss_server_clean(_state);
-        _state = NULL;
+        ReleaseState();
     }
 }
 
+void KerberosServer::ReleaseState() {
+    authenticate_gss_server_clean(_state);
+    gss_server_state_free(_state);
+    _state = NULL;
+    KerberosMemoryReport();
+}
+
 NAN_METHOD(KerberosServer::Step) {
     KerberosServer* server = Nan::ObjectWrap::Unwrap<KerberosServer>(info.This());
-    std::string challenge(*Nan::Utf8String(info[0]));
-    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+    if (!server->BeginOperation()) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[0]);
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    bool details = BooleanOptionValue(options, "details", false);
 
     KerberosWorker::Run(callback, "kerberos:ServerStep", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
-        std::shared_ptr<gss_result> result(
-            authenticate_gss_server_step(server->state(), challenge.c_str()), ResultDeleter);
+        gss_result* result = authenticate_gss_server_step(server->state(), challenge->c_str());
 
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
-                worker->Call(2, argv);
-                return;
-            }
-
-            v8::Local<v8::Value> response = Nan::Null();
-            if (server->state()->response != NULL) {
-                response = Nan::New(server->state()->response).ToLocalChecked();
+                argv[0] = GssError(result);
+            } else if (details) {
+                argv[1] = server->StepResult();
+            } else {
+                argv[1] = StringOrNull(server->state()->response);
             }
 
-            v8::Local<v8::Value> argv[] = {Nan::Null(), response};
+            server->EndOperation();
             worker->Call(2, argv);
         });
     });
 }
 
-/// Global Methods
-NAN_METHOD(InitializeClient) {
-    std::string service(*Nan::Utf8String(info[0]));
-    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
-    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+// Maps a principal to its local name, returning null when there is no mapping
+static void LocalNameResult(Nan::ReturnValue<v8::Value> returnValue, const char* principal) {
+    std::shared_ptr<gss_result> result(authenticate_gss_localname(principal), ResultDeleter);
+    if (result->code == AUTH_GSS_ERROR) {
+        Nan::ThrowError(GssError(result.get()));
+        return;
+    }
 
-    std::string principal = StringOptionValue(options, "principal");
-    uint32_t gss_flags =
+    if (result->data == NULL) {
+        returnValue.Set(Nan::Null());
+        return;
+    }
+
+    returnValue.Set(Nan::New(result->data).ToLocalChecked());
+}
+
+NAN_METHOD(KerberosServer::LocalName) {
+    KerberosServer* server = Nan::ObjectWrap::Unwrap<KerberosServer>(info.This());
+    const char* username = ServerUserName(server->state(), server->_pending == 0);
+    if (username == NULL) {
+        info.GetReturnValue().Set(Nan::Null());
+        return;
+    }
+
+    LocalNameResult(info.GetReturnValue(), username);
+}
+
+// The options shared by `initializeClient` and `initializeClientHandle`
+struct ClientOptions {
+    std::string principal;
+    std::string password;
+    uint32_t gss_flags;
+    gss_OID mech_oid;
+};
+
+static ClientOptions ParseClientOptions(v8::Local<v8::Object> options) {
+    ClientOptions result;
+    result.principal = StringOptionValue(options, "principal");
+    result.password = StringOptionValue(options, "password");
+    if (result.principal.empty() && !result.password.empty()) {
+        result.principal = StringOptionValue(options, "user");
+    }
+
+    result.gss_flags =
         UInt32OptionValue(options, "gssFlags", GSS_C_MUTUAL_FLAG | GSS_C_SEQUENCE_FLAG);
     uint32_t mech_oid_int = UInt32OptionValue(options, "mechOID", 0);
-    gss_OID mech_oid = GSS_C_NO_OID;
+    result.mech_oid = GSS_C_NO_OID;
     if (mech_oid_int == GSS_MECH_OID_KRB5) {
-        mech_oid = &krb5_mech_oid;
+        result.mech_oid = &krb5_mech_oid;
     } else if (mech_oid_int == GSS_MECH_OID_SPNEGO) {
-        mech_oid = &spnego_mech_oid;
+        result.mech_oid = &spnego_mech_oid;
     }
 
+    return result;
+}
+
+/// Global Methods
+NAN_METHOD(InitializeClient) {
+    std::string service(*Nan::Utf8String(info[0]));
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+
+    ClientOptions client_options = ParseClientOptions(options);
+
     KerberosWorker::Run(callback, "kerberos:InitializeClient", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
         gss_client_state* client_state = gss_client_state_new();
         std::shared_ptr<gss_result> result(authenticate_gss_client_init(
-            service.c_str(), principal.c_str(), gss_flags, NULL, mech_oid, client_state), ResultDeleter);
+            service.c_str(),
+            client_options.principal.c_str(),
+            client_options.password.c_str(),
+            client_options.gss_flags,
+            NULL,
+            client_options.mech_oid,
+            client_state), ResultDeleter);
 
         // must clean up state if we won't be using it, smart pointers won't help here unfortunately
         // because we can't `release` a shared pointer.
         if (result->code == AUTH_GSS_ERROR) {
-            free(client_state);
+            authenticate_gss_client_clean(client_state);
+            gss_client_state_free(client_state);
         }
 
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
+                v8::Local<v8::Value> argv[] = {GssError(result.get()), Nan::Null()};
                 worker->Call(2, argv);
                 return;
             }
@@ -188,13 +791,14 @@ NAN_METHOD(InitializeServer) {
         // must clean up state if we won't be using it, smart pointers won't help here unfortunately
         // because we can't `release` a shared pointer.
         if (result->code == AUTH_GSS_ERROR) {
-            free(server_state);
+            authenticate_gss_server_clean(server_state);
+            gss_server_state_free(server_state);
         }
 
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
+                v8::Local<v8::Value> argv[] = {GssError(result.get()), Nan::Null()};
                 worker->Call(2, argv);
                 return;
             }
@@ -217,7 +821,7 @@ NAN_METHOD(PrincipalDetails) {
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
+                v8::Local<v8::Value> argv[] = {GssError(result.get()), Nan::Null()};
                 worker->Call(2, argv);
                 return;
             }
@@ -249,7 +853,7 @@ NAN_METHOD(CheckPassword) {
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
+                v8::Local<v8::Value> argv[] = {GssError(result.get()), Nan::Null()};
                 worker->Call(2, argv);
             } else {
                 v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
@@ -258,3 +862,417 @@ NAN_METHOD(CheckPassword) {
         });
     });
 }
+
+NAN_METHOD(ToLocalName) {
+    std::string principal(*Nan::Utf8String(info[0]));
+    LocalNameResult(info.GetReturnValue(), principal.c_str());
+}
+
+/// Handle-based contexts
+static void ClientContextCleanup(gss_client_state* state) {
+    authenticate_gss_client_clean(state);
+}
+
+static void ServerContextCleanup(gss_server_state* state) {
+    authenticate_gss_server_clean(state);
+}
+
+static ContextTable<gss_client_state> client_contexts(CONTEXT_HANDLE_TAG_CLIENT,
+                                                      ClientContextCleanup);
+static ContextTable<gss_server_state> server_contexts(CONTEXT_HANDLE_TAG_SERVER,
+                                                      ServerContextCleanup);
+
+static bool HandleValue(v8::Local<v8::Value> value, uint64_t* handle) {
+    if (!value->IsNumber()) {
+        return false;
+    }
+
+    double number = Nan::To<double>(value).FromJust();
+    if (!(number >= 0) || number >= (double)(1ULL << 53)) {
+        return false;
+    }
+
+    *handle = (uint64_t)number;
+    return true;
+}
+
+// Pins a handle's state for an operation. Throws `not_live` if the handle isn't live, or that it
+// is busy if another operation is still running against it.
+template <typename State>
+static State* PinHandle(ContextTable<State>& table, uint64_t handle, const char* not_live) {
+    State* state = table.Pin(handle);
+    if (state == NULL) {
+        Nan::ThrowError(table.Lookup(handle) != NULL
+                            ? "Context handle already has an operation in progress"
+                            : not_live);
+    }
+
+    return state;
+}
+
+NAN_METHOD(InitializeClientHandle) {
+    std::string service(*Nan::Utf8String(info[0]));
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+
+    ClientOptions client_options = ParseClientOptions(options);
+
+    uint64_t handle;
+    gss_client_state* client_state = client_contexts.Allocate(&handle);
+    if (client_state == NULL) {
+        delete callback;
+        Nan::ThrowError("Client context table is full");
+        return;
+    }
+
+    KerberosWorker::Run(callback, "kerberos:InitializeClientHandle", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        std::shared_ptr<gss_result> result(authenticate_gss_client_init(
+            service.c_str(),
+            client_options.principal.c_str(),
+            client_options.password.c_str(),
+            client_options.gss_flags,
+            NULL,
+            client_options.mech_oid,
+            client_state), ResultDeleter);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            client_contexts.Unpin(handle);
+            if (result->code == AUTH_GSS_ERROR) {
+                client_contexts.Release(handle);
+                v8::Local<v8::Value> argv[] = {GssError(result.get()), Nan::Null()};
+                worker->Call(2, argv);
+                return;
+            }
+
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::New<v8::Number>((double)handle)};
+            worker->Call(2, argv);
+        });
+    });
+}
+
+NAN_METHOD(InitializeServerHandle) {
+    std::string service(*Nan::Utf8String(info[0]));
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+
+    uint64_t handle;
+    gss_server_state* server_state = server_contexts.Allocate(&handle);
+    if (server_state == NULL) {
+        delete callback;
+        Nan::ThrowError("Server context table is full");
+        return;
+    }
+
+    KerberosWorker::Run(callback, "kerberos:InitializeServerHandle", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        std::shared_ptr<gss_result> result(
+            authenticate_gss_server_init(service.c_str(), server_state), ResultDeleter);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            server_contexts.Unpin(handle);
+            if (result->code == AUTH_GSS_ERROR) {
+                server_contexts.Release(handle);
+                v8::Local<v8::Value> argv[] = {GssError(result.get()), Nan::Null()};
+                worker->Call(2, argv);
+                return;
+            }
+
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::New<v8::Number>((double)handle)};
+            worker->Call(2, argv);
+        });
+    });
+}
+
+NAN_METHOD(StepHandle) {
+    uint64_t handle;
+    if (!HandleValue(info[0], &handle)) {
+        Nan::ThrowTypeError("Invalid context handle");
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[1]);
+    if (ContextHandleTag(handle) == CONTEXT_HANDLE_TAG_SERVER) {
+        gss_server_state* state = PinHandle(server_contexts, handle, "Context handle is not live");
+        if (state == NULL) {
+            return;
+        }
+
+        Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+        KerberosWorker::Run(callback, "kerberos:ServerStep", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+            gss_result* result = authenticate_gss_server_step(state, challenge->c_str());
+
+            return onFinished([=](KerberosWorker* worker) {
+                Nan::HandleScope scope;
+                // the result and response belong to the state, read them before it can be recycled
+                v8::Local<v8::Value> response = StringOrNull(state->response);
+                v8::Local<v8::Value> error = Nan::Null();
+                if (result->code == AUTH_GSS_ERROR) {
+                    error = GssError(result);
+                    response = Nan::Null();
+                }
+                server_contexts.Unpin(handle);
+
+                v8::Local<v8::Value> argv[] = {error, response};
+                worker->Call(2, argv);
+            });
+        });
+        return;
+    }
+
+    gss_client_state* state = PinHandle(client_contexts, handle, "Context handle is not live");
+    if (state == NULL) {
+        return;
+    }
+
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    KerberosWorker::Run(callback, "kerberos:ClientStep", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        gss_result* result = authenticate_gss_client_step(state, challenge->c_str(), NULL);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            // the result and response belong to the state, read them before it can be recycled
+            v8::Local<v8::Value> response = StringOrNull(state->response);
+            v8::Local<v8::Value> error = Nan::Null();
+            if (result->code == AUTH_GSS_ERROR) {
+                error = GssError(result);
+                response = Nan::Null();
+            }
+            client_contexts.Unpin(handle);
+
+            v8::Local<v8::Value> argv[] = {error, response};
+            worker->Call(2, argv);
+        });
+    });
+}
+
+NAN_METHOD(UnwrapHandle) {
+    uint64_t handle;
+    gss_client_state* state;
+    if (!HandleValue(info[0], &handle)) {
+        Nan::ThrowError("Context handle is not a live client context");
+        return;
+    }
+
+    state = PinHandle(client_contexts, handle, "Context handle is not a live client context");
+    if (state == NULL) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[1]);
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+
+    KerberosWorker::Run(callback, "kerberos:ClientUnwrap", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        gss_result* result = authenticate_gss_client_unwrap(state, challenge->c_str(), false);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            // the result and response belong to the state, read them before it can be recycled
+            v8::Local<v8::Value> response = StringOrNull(state->response);
+            v8::Local<v8::Value> error = Nan::Null();
+            if (result->code == AUTH_GSS_ERROR) {
+                error = GssError(result);
+                response = Nan::Null();
+            }
+            client_contexts.Unpin(handle);
+
+            v8::Local<v8::Value> argv[] = {error, response};
+            worker->Call(2, argv);
+        });
+    });
+}
+
+NAN_METHOD(WrapHandle) {
+    uint64_t handle;
+    gss_client_state* state;
+    if (!HandleValue(info[0], &handle)) {
+        Nan::ThrowError("Context handle is not a live client context");
+        return;
+    }
+
+    state = PinHandle(client_contexts, handle, "Context handle is not a live client context");
+    if (state == NULL) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[1]);
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[2]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[3]).ToLocalChecked());
+    std::string user = StringOptionValue(options, "user");
+
+    int protect = 0; // NOTE: this should be an option
+
+    KerberosWorker::Run(callback, "kerberos:ClientWrap", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        gss_result* result = authenticate_gss_client_wrap(
+            state, challenge->c_str(), user.c_str(), protect, false);
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            // the result and response belong to the state, read them before it can be recycled
+            v8::Local<v8::Value> response = StringOrNull(state->response);
+            v8::Local<v8::Value> error = Nan::Null();
+            if (result->code == AUTH_GSS_ERROR) {
+                error = GssError(result);
+                response = Nan::Null();
+            }
+            client_contexts.Unpin(handle);
+
+            v8::Local<v8::Value> argv[] = {error, response};
+            worker->Call(2, argv);
+        });
+    });
+}
+
+NAN_METHOD(HandleInfo) {
+    uint64_t handle;
+    if (!HandleValue(info[0], &handle)) {
+        Nan::ThrowTypeError("Invalid context handle");
+        return;
+    }
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    if (ContextHandleTag(handle) == CONTEXT_HANDLE_TAG_SERVER) {
+        gss_server_state* state = server_contexts.Lookup(handle);
+        if (state == NULL) {
+            info.GetReturnValue().Set(Nan::Null());
+            return;
+        }
+
+        bool idle = server_contexts.Idle(handle);
+        Nan::Set(result, Nan::New("username").ToLocalChecked(), StringOrNull(ServerUserName(state, idle)));
+        Nan::Set(result, Nan::New("response").ToLocalChecked(), StringOrNull(state->response));
+        Nan::Set(result, Nan::New("targetName").ToLocalChecked(), StringOrNull(ServerTargetName(state, idle)));
+        Nan::Set(result, Nan::New("contextComplete").ToLocalChecked(), Nan::New(state->context_complete));
+        info.GetReturnValue().Set(result);
+        return;
+    }
+
+    gss_client_state* state = client_contexts.Lookup(handle);
+    if (state == NULL) {
+        info.GetReturnValue().Set(Nan::Null());
+        return;
+    }
+
+    bool idle = client_contexts.Idle(handle);
+    Nan::Set(result, Nan::New("username").ToLocalChecked(), StringOrNull(ClientUserName(state, idle)));
+    Nan::Set(result, Nan::New("response").ToLocalChecked(), StringOrNull(state->response));
+    Nan::Set(result, Nan::New("responseConf").ToLocalChecked(), Nan::New(state->responseConf));
+    Nan::Set(result, Nan::New("contextComplete").ToLocalChecked(), Nan::New(state->context_complete));
+    info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(ReleaseHandle) {
+    uint64_t handle;
+    if (!HandleValue(info[0], &handle)) {
+        Nan::ThrowTypeError("Invalid context handle");
+        return;
+    }
+
+    bool released = (ContextHandleTag(handle) == CONTEXT_HANDLE_TAG_SERVER)
+                        ? server_contexts.Release(handle)
+                        : client_contexts.Release(handle);
+    KerberosMemoryReport();
+    info.GetReturnValue().Set(Nan::New(released));
+}
+
+NAN_METHOD(HandleTableStats) {
+    v8::Local<v8::Object> clients = Nan::New<v8::Object>();
+    Nan::Set(clients, Nan::New("live").ToLocalChecked(), Nan::New(client_contexts.live()));
+    Nan::Set(clients, Nan::New("capacity").ToLocalChecked(), Nan::New(client_contexts.capacity()));
+
+    v8::Local<v8::Object> servers = Nan::New<v8::Object>();
+    Nan::Set(servers, Nan::New("live").ToLocalChecked(), Nan::New(server_contexts.live()));
+    Nan::Set(servers, Nan::New("capacity").ToLocalChecked(), Nan::New(server_contexts.capacity()));
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("clients").ToLocalChecked(), clients);
+    Nan::Set(result, Nan::New("servers").ToLocalChecked(), servers);
+    info.GetReturnValue().Set(result);
+}
+
+#ifdef KERBEROS_GSS_MOCK
+static bool MockDistribution(const std::string& name, gss_mock_distribution* distribution) {
+    static const std::pair<const char*, gss_mock_distribution> distributions[] = {
+        {"constant", GSS_MOCK_CONSTANT},
+        {"uniform", GSS_MOCK_UNIFORM},
+        {"exponential", GSS_MOCK_EXPONENTIAL},
+        {"lognormal", GSS_MOCK_LOGNORMAL}};
+    for (const auto& entry : distributions) {
+        if (name == entry.first) {
+            *distribution = entry.second;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Replaces the whole mock configuration, anything not given is reset to its default
+NAN_METHOD(ConfigureMock) {
+    gss_mock_config config = gss_mock_default_config();
+    v8::Local<v8::Object> options = info[0]->IsObject()
+                                        ? Nan::To<v8::Object>(info[0]).ToLocalChecked()
+                                        : Nan::New<v8::Object>();
+
+    config.seed = (uint64_t)NumberOptionValue(options, "seed", 0);
+    std::string realm = StringOptionValue(options, "realm");
+    if (!realm.empty()) {
+        config.realm = realm;
+    }
+
+    std::string principal = StringOptionValue(options, "principal");
+    if (!principal.empty()) {
+        config.principal = principal;
+    }
+
+    config.password = StringOptionValue(options, "password");
+
+    v8::Local<v8::Value> keytab = Nan::Get(options, Nan::New("keytab").ToLocalChecked())
+                                      .FromMaybe(v8::Local<v8::Value>(Nan::Undefined()));
+    if (keytab->IsArray()) {
+        v8::Local<v8::Array> entries = keytab.As<v8::Array>();
+        for (uint32_t i = 0; i < entries->Length(); ++i) {
+            v8::Local<v8::Value> entry = Nan::Get(entries, i).ToLocalChecked();
+            config.keytab.push_back(*Nan::Utf8String(entry));
+        }
+    }
+
+    v8::Local<v8::Value> calls = Nan::Get(options, Nan::New("calls").ToLocalChecked())
+                                     .FromMaybe(v8::Local<v8::Value>(Nan::Undefined()));
+    for (int call = 0; calls->IsObject() && call < GSS_MOCK_CALLS; ++call) {
+        v8::Local<v8::Value> value =
+            Nan::Get(Nan::To<v8::Object>(calls).ToLocalChecked(),
+                     Nan::New(gss_mock_call_name(call)).ToLocalChecked())
+                .ToLocalChecked();
+        if (!value->IsObject()) {
+            continue;
+        }
+
+        v8::Local<v8::Object> behaviour = Nan::To<v8::Object>(value).ToLocalChecked();
+        gss_mock_behaviour& target = config.calls[call];
+        std::string distribution = StringOptionValue(behaviour, "distribution");
+        if (!distribution.empty() && !MockDistribution(distribution, &target.distribution)) {
+            Nan::ThrowTypeError("Unknown latency distribution");
+            return;
+        }
+
+        target.latency = NumberOptionValue(behaviour, "latency", target.latency);
+        target.spread = NumberOptionValue(behaviour, "spread", target.spread);
+        target.error_rate = NumberOptionValue(behaviour, "errorRate", target.error_rate);
+        target.error_code =
+            (int32_t)NumberOptionValue(behaviour, "errorCode", target.error_code);
+    }
+
+    gss_mock_configure(config);
+}
+
+NAN_METHOD(MockCalls) {
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    for (int call = 0; call < GSS_MOCK_CALLS; ++call) {
+        Nan::Set(result,
+                 Nan::New(gss_mock_call_name(call)).ToLocalChecked(),
+                 Nan::New<v8::Number>((double)gss_mock_calls(call)));
+    }
+
+    info.GetReturnValue().Set(result);
+}
+#endif
@@ -1,6 +1,7 @@
 #include <memory>
 
 #include "../kerberos.h"
+#include "../kerberos_challenge.h"
 #include "../kerberos_worker.h"
 
 #define GSS_MECH_OID_KRB5 9
@@ -37,37 +38,58 @@ NAN_INLINE std::wstring WStringOptionValue(v8::Local<v8::Object> options, const
     return to_wstring(*(Nan::Utf8String(value)));
 }
 
+// SSPI only produces base64 output, binary results are decoded from it
+static v8::Local<v8::Value> DecodedResponse(const char* response) {
+    if (response == NULL) {
+        return Nan::NewBuffer(0).ToLocalChecked();
+    }
+
+    v8::Local<v8::String> encoded = Nan::New(response).ToLocalChecked();
+    ssize_t length = Nan::DecodeBytes(encoded, Nan::BASE64);
+    v8::Local<v8::Object> buffer = Nan::NewBuffer((uint32_t)length).ToLocalChecked();
+    Nan::DecodeWrite(node::Buffer::Data(buffer), length, encoded, Nan::BASE64);
+    return buffer;
+}
+
 /// KerberosClient
 KerberosClient::~KerberosClient() {
     if (_state != NULL) {
-        auth_sspi_client_clean(_state);
-        _state = NULL;
+        ReleaseState();
     }
 }
 
+void KerberosClient::ReleaseState() {
+    auth_sspi_client_clean(_state);
+    _state = NULL;
+}
+
 NAN_METHOD(KerberosClient::Step) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    std::string challenge(*Nan::Utf8String(info[0]));
-    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[0]);
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    bool details = BooleanOptionValue(options, "details", false);
 
     KerberosWorker::Run(callback, "kerberos:ClientStep", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
         std::shared_ptr<sspi_result> result(
-            auth_sspi_client_step(client->state(), (SEC_CHAR*)challenge.c_str(), NULL), ResultDeleter);
+            auth_sspi_client_step(client->state(), (SEC_CHAR*)challenge->c_str(), NULL), ResultDeleter);
 
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
-                worker->Call(2, argv);
-                return;
-            }
-
-            v8::Local<v8::Value> response = Nan::Null();
-            if (client->state()->response != NULL) {
-                response = Nan::New(client->state()->response).ToLocalChecked();
+                argv[0] = Nan::Error(result->message);
+            } else if (details) {
+                argv[1] = client->StepResult();
+            } else if (client->state()->response != NULL) {
+                argv[1] = Nan::New(client->state()->response).ToLocalChecked();
             }
 
-            v8::Local<v8::Value> argv[] = {Nan::Null(), response};
+            client->EndOperation();
             worker->Call(2, argv);
         });
     });
@@ -75,22 +97,31 @@ NAN_METHOD(KerberosClient::Step) {
 
 NAN_METHOD(KerberosClient::UnwrapData) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    std::string challenge(*Nan::Utf8String(info[0]));
-    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[0]);
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    bool binary = BooleanOptionValue(options, "binary", false);
 
     KerberosWorker::Run(callback, "kerberos:ClientUnwrap", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
         std::shared_ptr<sspi_result> result(
-            auth_sspi_client_unwrap(client->state(), (SEC_CHAR*)challenge.c_str()), ResultDeleter);
+            auth_sspi_client_unwrap(client->state(), (SEC_CHAR*)challenge->c_str()), ResultDeleter);
 
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
-                worker->Call(2, argv);
-                return;
+                argv[0] = Nan::Error(result->message);
+            } else if (binary) {
+                argv[1] = DecodedResponse(client->state()->response);
+            } else {
+                argv[1] = Nan::New(client->state()->response).ToLocalChecked();
             }
 
-            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::New(client->state()->response).ToLocalChecked()};
+            client->EndOperation();
             worker->Call(2, argv);
         });
     });
@@ -98,31 +129,121 @@ NAN_METHOD(KerberosClient::UnwrapData) {
 
 NAN_METHOD(KerberosClient::WrapData) {
     KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
-    std::string challenge(*Nan::Utf8String(info[0]));
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[0]);
     v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
     Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
     std::string user = StringOptionValue(options, "user");
+    bool binary = BooleanOptionValue(options, "binary", false);
     int protect = 0; // NOTE: this should be an option
 
     KerberosWorker::Run(callback, "kerberos:ClientWrap", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
         std::shared_ptr<sspi_result> result(auth_sspi_client_wrap(
-            client->state(), (SEC_CHAR*)challenge.c_str(), (SEC_CHAR*)user.c_str(), user.length(), protect), ResultDeleter);
+            client->state(), (SEC_CHAR*)challenge->c_str(), (SEC_CHAR*)user.c_str(), user.length(), protect), ResultDeleter);
 
         return onFinished([=](KerberosWorker* worker) {
             Nan::HandleScope scope;
 
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
             if (result->code == AUTH_GSS_ERROR) {
-                v8::Local<v8::Value> argv[] = {Nan::Error(result->message), Nan::Null()};
-                worker->Call(2, argv);
-                return;
+                argv[0] = Nan::Error(result->message);
+            } else if (binary) {
+                argv[1] = DecodedResponse(client->state()->response);
+            } else {
+                argv[1] = Nan::New(client->state()->response).ToLocalChecked();
+            }
+
+            client->EndOperation();
+            worker->Call(2, argv);
+        });
+    });
+}
+
+// See the unix implementation
+NAN_METHOD(KerberosClient::SaslStep) {
+    KerberosClient* client = Nan::ObjectWrap::Unwrap<KerberosClient>(info.This());
+    v8::Local<v8::Object> options = Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    std::string qop = StringOptionValue(options, "qop");
+    if (!qop.empty() && qop != "auth") {
+        return Nan::ThrowError("SASL security layers are not implemented yet for windows");
+    }
+
+    if (!client->BeginOperation()) {
+        return;
+    }
+
+    std::shared_ptr<KerberosChallenge> challenge = KerberosChallenge::From(info[0]);
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
+    std::string user = StringOptionValue(options, "user");
+    bool negotiate = client->state()->context_complete;
+
+    KerberosWorker::Run(callback, "kerberos:ClientSaslStep", [=](KerberosWorker::SetOnFinishedHandler onFinished) {
+        std::shared_ptr<sspi_result> result;
+        if (!negotiate) {
+            result.reset(auth_sspi_client_step(client->state(), (SEC_CHAR*)challenge->c_str(), NULL), ResultDeleter);
+        } else {
+            result.reset(auth_sspi_client_unwrap(client->state(), (SEC_CHAR*)challenge->c_str()), ResultDeleter);
+            if (result->code != AUTH_GSS_ERROR) {
+                // the reply doesn't depend on the offer, see `auth_sspi_client_wrap`
+                result.reset(auth_sspi_client_wrap(
+                    client->state(), (SEC_CHAR*)"", (SEC_CHAR*)user.c_str(), user.length(), 0), ResultDeleter);
+            }
+        }
+
+        return onFinished([=](KerberosWorker* worker) {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::Null()};
+            if (result->code == AUTH_GSS_ERROR) {
+                argv[0] = Nan::Error(result->message);
+            } else if (client->state()->response != NULL) {
+                argv[1] = Nan::New(client->state()->response).ToLocalChecked();
             }
 
-            v8::Local<v8::Value> argv[] = {Nan::Null(), Nan::New(client->state()->response).ToLocalChecked()};
+            client->EndOperation();
             worker->Call(2, argv);
         });
     });
 }
 
+NAN_METHOD(KerberosClient::GetMic) {
+    Nan::ThrowError("`KerberosClient::GetMic` is not implemented yet for windows");
+}
+
+NAN_METHOD(KerberosClient::GetMics) {
+    Nan::ThrowError("`KerberosClient::GetMics` is not implemented yet for windows");
+}
+
+NAN_METHOD(KerberosClient::VerifyMic) {
+    Nan::ThrowError("`KerberosClient::VerifyMic` is not implemented yet for windows");
+}
+
+NAN_METHOD(KerberosClient::VerifyMics) {
+    Nan::ThrowError("`KerberosClient::VerifyMics` is not implemented yet for windows");
+}
+
+NAN_METHOD(KerberosClient::WrapOverhead) {
+    Nan::ThrowError("`KerberosClient::WrapOverhead` is not implemented yet for windows");
+}
+
+NAN_METHOD(KerberosClient::WrapInto) {
+    Nan::ThrowError("`KerberosClient::WrapInto` is not implemented yet for windows");
+}
+
+NAN_METHOD(KerberosClient::UnwrapInPlace) {
+    Nan::ThrowError("`KerberosClient::UnwrapInPlace` is not implemented yet for windows");
+}
+
+NAN_METHOD(KerberosClient::SaslWrap) {
+    Nan::ThrowError("`KerberosClient::SaslWrap` is not implemented yet for windows");
+}
+
+NAN_METHOD(KerberosClient::SaslUnwrap) {
+    Nan::ThrowError("`KerberosClient::SaslUnwrap` is not implemented yet for windows");
+}
+
 /// KerberosServer
 KerberosServer::~KerberosServer() {
     // if (_state != NULL) {
@@ -131,13 +252,21 @@ KerberosServer::~KerberosServer() {
     // }
 }
 
+void KerberosServer::ReleaseState() {
+    _state = NULL;
+}
+
 NAN_METHOD(KerberosServer::Step) {
     KerberosServer* server = Nan::ObjectWrap::Unwrap<KerberosServer>(info.This());
     std::string challenge(*Nan::Utf8String(info[0]));
-    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[1]).ToLocalChecked());
+    Nan::Callback* callback = new Nan::Callback(Nan::To<v8::Function>(info[2]).ToLocalChecked());
     Nan::ThrowError("`KerberosServer::Step` is not implemented yet for windows");
 }
 
+NAN_METHOD(KerberosServer::LocalName) {
+    Nan::ThrowError("`KerberosServer::LocalName` is not implemented yet for windows");
+}
+
 /// Global Methods
 NAN_METHOD(InitializeClient) {
     std::wstring service = to_wstring(*(Nan::Utf8String(info[0])));
@@ -192,3 +321,39 @@ NAN_METHOD(PrincipalDetails) {
 NAN_METHOD(CheckPassword) {
     Nan::ThrowError("`checkPassword` is not implemented yet for windows");
 }
+
+NAN_METHOD(ToLocalName) {
+    Nan::ThrowError("`toLocalName` is not implemented yet for windows");
+}
+
+NAN_METHOD(InitializeClientHandle) {
+    Nan::ThrowError("`initializeClientHandle` is not implemented yet for windows");
+}
+
+NAN_METHOD(InitializeServerHandle) {
+    Nan::ThrowError("`initializeServerHandle` is not implemented yet for windows");
+}
+
+NAN_METHOD(StepHandle) {
+    Nan::ThrowError("`stepHandle` is not implemented yet for windows");
+}
+
+NAN_METHOD(WrapHandle) {
+    Nan::ThrowError("`wrapHandle` is not implemented yet for windows");
+}
+
+NAN_METHOD(UnwrapHandle) {
+    Nan::ThrowError("`unwrapHandle` is not implemented yet for windows");
+}
+
+NAN_METHOD(HandleInfo) {
+    Nan::ThrowError("`handleInfo` is not implemented yet for windows");
+}
+
+NAN_METHOD(ReleaseHandle) {
+    Nan::ThrowError("`releaseHandle` is not implemented yet for windows");
+}
+
+NAN_METHOD(HandleTableStats) {
+    Nan::ThrowError("`handleTableStats` is not implemented yet for windows");
+}
@@ -0,0 +1,112 @@
+'use strict';
+const CnameCache = require('../lib/auth_processes/cname_cache').CnameCache;
+const MongoAuthProcess = require('..').processes.MongoAuthProcess;
+const expect = require('chai').expect;
+
+function fakeResolver(answers) {
+  const resolver = (host, callback) => {
+    resolver.queries.push(host);
+    const answer = answers[host];
+    setTimeout(() => {
+      if (answer instanceof Error) return callback(answer);
+      callback(null, answer);
+    }, 5);
+  };
+
+  resolver.queries = [];
+  return resolver;
+}
+
+function dnsError(code) {
+  const err = new Error(`queryCname ${code}`);
+  err.code = code;
+  return err;
+}
+
+function resolve(cache, host) {
+  return new Promise((resolve, reject) => {
+    cache.resolve(host, (err, records) => (err ? reject(err) : resolve(records)));
+  });
+}
+
+describe('CNAME cache', function() {
+  it('should be shared by all MongoAuthProcess instances', function() {
+    expect(MongoAuthProcess.cnameCache).to.be.an.instanceof(CnameCache);
+    expect(MongoAuthProcess.cnameCache.stats()).to.have.keys([
+      'size',
+      'hits',
+      'negativeHits',
+      'misses',
+      'coalesced',
+      'errors'
+    ]);
+  });
+
+  it('should reuse answers until they expire', function() {
+    const resolver = fakeResolver({ db: ['db.example.com'] });
+    const cache = new CnameCache({ ttl: 30, resolveCname: resolver });
+
+    return resolve(cache, 'db')
+      .then(() => resolve(cache, 'db'))
+      .then(records => {
+        expect(records).to.eql(['db.example.com']);
+        expect(resolver.queries).to.have.length(1);
+        expect(cache.stats()).to.include({ hits: 1, misses: 1, size: 1 });
+      })
+      .then(() => new Promise(done => setTimeout(done, 40)))
+      .then(() => resolve(cache, 'db'))
+      .then(() => {
+        expect(resolver.queries).to.have.length(2);
+        expect(cache.stats()).to.include({ hits: 1, misses: 2 });
+      });
+  });
+
+  it('should send a single query for concurrent lookups', function() {
+    const resolver = fakeResolver({ db: ['db.example.com'] });
+    const cache = new CnameCache({ resolveCname: resolver });
+
+    return Promise.all([resolve(cache, 'db'), resolve(cache, 'db'), resolve(cache, 'db')]).then(
+      results => {
+        results.forEach(records => expect(records).to.eql(['db.example.com']));
+        expect(resolver.queries).to.have.length(1);
+        expect(cache.stats()).to.include({ misses: 1, coalesced: 2 });
+      }
+    );
+  });
+
+  it('should only cache answers saying the host has no CNAME', function() {
+    const resolver = fakeResolver({ plain: dnsError('ENODATA'), flaky: dnsError('ETIMEOUT') });
+    const cache = new CnameCache({ resolveCname: resolver });
+    const failure = host =>
+      resolve(cache, host).then(
+        () => expect.fail('the lookup should fail'),
+        err => err.code
+      );
+
+    return failure('plain')
+      .then(() => failure('plain'))
+      .then(code => {
+        expect(code).to.equal('ENODATA');
+        return failure('flaky');
+      })
+      .then(() => failure('flaky'))
+      .then(code => {
+        expect(code).to.equal('ETIMEOUT');
+        expect(resolver.queries).to.eql(['plain', 'flaky', 'flaky']);
+        expect(cache.stats()).to.include({ negativeHits: 1, errors: 3, size: 1 });
+      });
+  });
+
+  it('should evict the oldest hosts when full', function() {
+    const resolver = fakeResolver({ a: ['a.example.com'], b: ['b.example.com'] });
+    const cache = new CnameCache({ maxEntries: 1, resolveCname: resolver });
+
+    return resolve(cache, 'a')
+      .then(() => resolve(cache, 'b'))
+      .then(() => resolve(cache, 'a'))
+      .then(() => {
+        expect(resolver.queries).to.eql(['a', 'b', 'a']);
+        expect(cache.stats().size).to.equal(1);
+      });
+  });
+});
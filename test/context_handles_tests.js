@@ -0,0 +1,77 @@
+'use strict';
+const kerberos = require('..');
+const chai = require('chai');
+const expect = chai.expect;
+const os = require('os');
+
+describe('Context handles', function() {
+  before(function() {
+    if (os.type() === 'Windows_NT') this.skip();
+  });
+
+  it('should allocate and release server handles', function() {
+    const before = kerberos.handleTableStats().servers.live;
+    return kerberos.initializeServerHandle('').then(handle => {
+      expect(handle).to.be.a('number');
+      expect(kerberos.handleTableStats().servers.live).to.equal(before + 1);
+
+      const info = kerberos.handleInfo(handle);
+      expect(info.contextComplete).to.be.false;
+      expect(info.username).to.be.null;
+
+      expect(kerberos.releaseHandle(handle)).to.be.true;
+      expect(kerberos.releaseHandle(handle)).to.be.false;
+      expect(kerberos.handleInfo(handle)).to.be.null;
+      expect(kerberos.handleTableStats().servers.live).to.equal(before);
+    });
+  });
+
+  it('should not resolve a stale handle to a recycled slot', function() {
+    return kerberos
+      .initializeServerHandle('')
+      .then(first => {
+        kerberos.releaseHandle(first);
+        return kerberos.initializeServerHandle('').then(second => [first, second]);
+      })
+      .then(handles => {
+        expect(handles[1]).to.not.equal(handles[0]);
+        expect(kerberos.handleInfo(handles[0])).to.be.null;
+        expect(kerberos.handleInfo(handles[1])).to.exist;
+        kerberos.releaseHandle(handles[1]);
+      });
+  });
+
+  it('should keep client and server handles apart', function() {
+    return kerberos.initializeClientHandle(`HTTP@${os.hostname()}`).then(handle => {
+      const info = kerberos.handleInfo(handle);
+      expect(info).to.have.property('responseConf');
+      expect(info).to.not.have.property('targetName');
+      expect(() => kerberos.unwrapHandle(-1, '', () => {})).to.throw();
+      expect(kerberos.releaseHandle(handle)).to.be.true;
+    });
+  });
+
+  it('should reject an operation while another is running on the same handle', function() {
+    return kerberos.initializeServerHandle('').then(handle => {
+      const first = kerberos.stepHandle(handle, 'YQ==').catch(() => {});
+      return kerberos
+        .stepHandle(handle, 'YQ==')
+        .then(
+          () => expect.fail('the second step should not start'),
+          err => expect(err.message).to.match(/operation in progress/)
+        )
+        .then(() => first)
+        .then(() => kerberos.releaseHandle(handle));
+    });
+  });
+
+  it('should reject operations on released handles', function() {
+    return kerberos.initializeServerHandle('').then(handle => {
+      kerberos.releaseHandle(handle);
+      return kerberos.stepHandle(handle, 'YQ==').then(
+        () => expect.fail('step should not succeed'),
+        err => expect(err.message).to.match(/not live/)
+      );
+    });
+  });
+});
@@ -10,6 +10,17 @@ const testMethod = defineOperation(kerberos._testMethod, [
   { name: 'callback', type: 'function', required: false }
 ]);
 
+const testMethodWithOptions = defineOperation(
+  function(string, options, callback) {
+    callback(null, { string, options });
+  },
+  [
+    { name: 'string', type: 'string' },
+    { name: 'options', type: 'object' },
+    { name: 'callback', type: 'function', required: false }
+  ]
+);
+
 describe('defineOperation', () => {
   it('should validate parameters', function() {
     expect(() => testMethod(42)).to.throw(/Invalid type for parameter/);
@@ -34,6 +45,39 @@ describe('defineOperation', () => {
     expect(promise).to.be.instanceOf(Promise);
   });
 
+  it('should pass a callback on when `options` is left out', function(done) {
+    testMethodWithOptions('testing', (err, result) => {
+      expect(err).to.not.exist;
+      expect(result).to.eql({ string: 'testing', options: {} });
+      done();
+    });
+  });
+
+  it('should apply the default `options` when a callback takes their place', function(done) {
+    const withDefault = defineOperation(
+      function(string, options, callback) {
+        callback(null, options);
+      },
+      [
+        { name: 'string', type: 'string' },
+        { name: 'options', type: 'object', default: { mechOID: 0 } },
+        { name: 'callback', type: 'function', required: false }
+      ]
+    );
+
+    withDefault('testing', (err, options) => {
+      expect(err).to.not.exist;
+      expect(options).to.eql({ mechOID: 0 });
+      done();
+    });
+  });
+
+  it('should default `options` when returning a promise', function() {
+    return testMethodWithOptions('testing').then(result => {
+      expect(result).to.eql({ string: 'testing', options: {} });
+    });
+  });
+
   it('should use a callback if provided', function(done) {
     testMethod('testing', false, 'optional', (err, result) => {
       expect(err).to.not.exist;
@@ -0,0 +1,58 @@
+'use strict';
+const kerberos = require('..');
+const expect = require('chai').expect;
+
+let diagnosticsChannel;
+try {
+  diagnosticsChannel = require('diagnostics_channel');
+} catch (err) {
+  diagnosticsChannel = null;
+}
+
+describe('diagnostics', function() {
+  before(function() {
+    if (diagnosticsChannel == null) this.skip();
+  });
+
+  it('should publish start and end events for native operations', function() {
+    const events = [];
+    const onStart = event => events.push(['start', Object.assign({}, event)]);
+    const onEnd = event => events.push(['end', Object.assign({}, event)]);
+    diagnosticsChannel.channel('kerberos:operation:start').subscribe(onStart);
+    diagnosticsChannel.channel('kerberos:operation:end').subscribe(onEnd);
+
+    return kerberos
+      .initializeServerHandle('')
+      .then(handle => {
+        kerberos.releaseHandle(handle);
+        expect(events.map(event => event[0])).to.eql(['start', 'end']);
+        expect(events[0][1]).to.include({
+          operation: 'kerberos:InitializeServerHandle',
+          service: ''
+        });
+        expect(events[1][1].duration).to.be.a('number');
+        expect(events[1][1].error).to.not.exist;
+      })
+      .finally(() => {
+        diagnosticsChannel.channel('kerberos:operation:start').unsubscribe(onStart);
+        diagnosticsChannel.channel('kerberos:operation:end').unsubscribe(onEnd);
+      });
+  });
+
+  it('should record performance entries when enabled', function() {
+    const performance = require('perf_hooks').performance;
+    kerberos.setPerformanceEntries(true);
+    return kerberos
+      .initializeServerHandle('')
+      .then(handle => {
+        kerberos.releaseHandle(handle);
+        const entries = performance.getEntriesByName('kerberos:InitializeServerHandle', 'measure');
+        expect(entries).to.have.length(1);
+        expect(entries[0].detail.service).to.equal('');
+      })
+      .finally(() => {
+        kerberos.setPerformanceEntries(false);
+        performance.clearMeasures('kerberos:InitializeServerHandle');
+      });
+  });
+});
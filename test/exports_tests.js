@@ -32,6 +32,11 @@ describe('module', function() {
     expect(api.initializeServer).to.be.a('function');
     expect(api.principalDetails).to.be.a('function');
     expect(api.checkPassword).to.be.a('function');
+    expect(api.toLocalName).to.be.a('function');
+    expect(api.stats).to.be.a('function');
+    expect(api.memoryUsage).to.be.a('function');
+    expect(api.dumpTrace).to.be.a('function');
+    expect(api.setPerformanceEntries).to.be.a('function');
   });
 
   it('should export Kerberos', () => {
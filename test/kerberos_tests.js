@@ -29,6 +29,12 @@ describe('Kerberos', function() {
     });
   });
 
+  it('should map a principal to a local name', function() {
+    expect(kerberos.toLocalName(`${username}@${realm.toUpperCase()}`)).to.equal(username);
+    // repeated lookups are served from the cache
+    expect(kerberos.toLocalName(`${username}@${realm.toUpperCase()}`)).to.equal(username);
+  });
+
   it('should check a given password against a kerberos server', function(done) {
     const service = `HTTP/${hostname}`;
     kerberos.checkPassword(username, password, service, realm.toUpperCase(), err => {
@@ -36,6 +42,8 @@ describe('Kerberos', function() {
 
       kerberos.checkPassword(username, 'incorrect-password', service, realm.toUpperCase(), err => {
         expect(err).to.exist;
+        expect(err.minorCode).to.be.a('number');
+        expect(err.retryable).to.be.false;
         done();
       });
     });
@@ -68,6 +76,7 @@ describe('Kerberos', function() {
               expect(server.username).to.equal(expectedUsername);
               expect(client.username).to.equal(expectedUsername);
               expect(server.targetName).to.not.exist;
+              expect(server.localName()).to.equal(username);
               done();
             });
           });
@@ -76,6 +85,42 @@ describe('Kerberos', function() {
     });
   });
 
+  it('should authenticate using a password instead of a credential cache', function(done) {
+    const service = `HTTP@${hostname}`;
+    const user = `${username}@${realm.toUpperCase()}`;
+
+    kerberos.initializeClient(service, { user, password }, (err, client) => {
+      expect(err).to.not.exist;
+
+      kerberos.initializeServer(service, (err, server) => {
+        expect(err).to.not.exist;
+
+        client.step('', (err, clientResponse) => {
+          expect(err).to.not.exist;
+
+          server.step(clientResponse, (err, serverResponse) => {
+            expect(err).to.not.exist;
+
+            client.step(serverResponse, err => {
+              expect(err).to.not.exist;
+              expect(client.contextComplete).to.be.true;
+              expect(client.username).to.equal(user);
+
+              kerberos.initializeClient(
+                service,
+                { user, password: 'incorrect-password' },
+                err => {
+                  expect(err).to.exist;
+                  done();
+                }
+              );
+            });
+          });
+        });
+      });
+    });
+  });
+
   it('should authenticate against a kerberos HTTP endpoint', function(done) {
     const service = `HTTP@${hostname}`;
     const url = `http://${hostname}:${port}/`;
@@ -0,0 +1,50 @@
+'use strict';
+const kerberos = require('..');
+const chai = require('chai');
+const expect = chai.expect;
+const os = require('os');
+
+describe('Memory accounting', function() {
+  before(function() {
+    if (os.type() === 'Windows_NT') this.skip();
+  });
+
+  it('should track live servers and their native memory', function() {
+    const before = kerberos.memoryUsage();
+    return kerberos.initializeServerHandle('').then(handle => {
+      const during = kerberos.memoryUsage();
+      expect(during.servers.live).to.equal(before.servers.live + 1);
+      expect(during.servers.bytes).to.be.above(before.servers.bytes);
+
+      kerberos.releaseHandle(handle);
+      const after = kerberos.memoryUsage();
+      expect(after.servers.live).to.equal(before.servers.live);
+      expect(after.servers.bytes).to.equal(before.servers.bytes);
+    });
+  });
+
+  it('should release a destroyed server without waiting for GC', function() {
+    const before = kerberos.memoryUsage();
+    return kerberos.initializeServer('').then(server => {
+      expect(kerberos.memoryUsage().servers.live).to.equal(before.servers.live + 1);
+
+      server.destroy();
+      server.destroy();
+      expect(kerberos.memoryUsage().servers.live).to.equal(before.servers.live);
+      expect(server.contextComplete).to.equal(false);
+
+      return server.step('').then(
+        () => expect.fail('step should fail after destroy'),
+        err => expect(err.message).to.match(/destroyed/)
+      );
+    });
+  });
+
+  it('should report tracked memory to V8', function() {
+    const usage = kerberos.memoryUsage();
+    const total = ['clients', 'servers', 'contexts', 'credentials']
+      .map(kind => usage[kind].bytes)
+      .reduce((sum, bytes) => sum + bytes, 0);
+    expect(usage.external).to.equal(total);
+  });
+});
@@ -0,0 +1,471 @@
+'use strict';
+const native = require('bindings')('kerberos');
+const kerberos = require('..');
+const expect = require('chai').expect;
+const Duplex = require('stream').Duplex;
+const MongoAuthProcess = require('..').processes.MongoAuthProcess;
+
+// only available when built with `node-gyp rebuild -- -Dkerberos_gss_mock=true`
+const configureMock = native._configureMock;
+
+function handshake(service) {
+  return Promise.all([
+    kerberos.initializeClient(service),
+    kerberos.initializeServer(service)
+  ]).then(contexts => {
+    const client = contexts[0];
+    const server = contexts[1];
+    return client
+      .step('')
+      .then(token => server.step(token))
+      .then(() => client.step(server.response))
+      .then(() => ({ client, server }));
+  });
+}
+
+function stepOutcomes(count) {
+  const outcomes = [];
+  let chain = Promise.resolve();
+  for (let i = 0; i < count; ++i) {
+    chain = chain
+      .then(() => kerberos.initializeClient('HTTP@localhost'))
+      .then(client => client.step(''))
+      .then(() => outcomes.push(true), () => outcomes.push(false));
+  }
+
+  return chain.then(() => outcomes);
+}
+
+describe('Mock GSSAPI backend', function() {
+  before(function() {
+    if (typeof configureMock !== 'function') this.skip();
+  });
+
+  afterEach(() => configureMock({}));
+
+  it('should establish a context without a KDC', function() {
+    return handshake('HTTP@localhost').then(contexts => {
+      expect(contexts.client.contextComplete).to.be.true;
+      expect(contexts.server.contextComplete).to.be.true;
+      expect(contexts.client.username).to.equal('user@MOCK.LOCAL');
+      expect(contexts.server.username).to.equal('user@MOCK.LOCAL');
+    });
+  });
+
+  it('should unwrap what was wrapped', function() {
+    // the SASL security layer negotiation message: no protection, a maximum size, the user
+    const challenge = Buffer.from([1, 0, 0x10, 0]).toString('base64');
+    return handshake('HTTP@localhost').then(contexts =>
+      contexts.client
+        .wrap(challenge, { user: 'user' })
+        .then(wrapped => contexts.client.unwrap(wrapped))
+        .then(unwrapped => {
+          const message = Buffer.from(unwrapped, 'base64');
+          expect(message[0]).to.equal(1);
+          expect(message.slice(4).toString()).to.equal('user');
+        })
+    );
+  });
+
+  it('should step with a callback and no options', function(done) {
+    kerberos.initializeClient('HTTP@localhost', (err, client) => {
+      if (err) return done(err);
+      client.step('', (err, token) => {
+        if (err) return done(err);
+        expect(token).to.be.a('string');
+        kerberos.initializeServer('HTTP@localhost', (err, server) => {
+          if (err) return done(err);
+          server.step(token, err => {
+            if (err) return done(err);
+            expect(server.contextComplete).to.be.true;
+            done();
+          });
+        });
+      });
+    });
+  });
+
+  it('should resolve step details in a single object', function() {
+    return Promise.all([
+      kerberos.initializeClient('HTTP@localhost'),
+      kerberos.initializeServer('HTTP@localhost')
+    ]).then(contexts => {
+      const client = contexts[0];
+      const server = contexts[1];
+      return client
+        .step('', { details: true })
+        .then(details => {
+          expect(Object.keys(details)).to.eql(['response', 'complete', 'username', 'responseConf']);
+          expect(details.response).to.equal(client.response);
+          expect(details.complete).to.be.false;
+          return server.step(details.response, { details: true });
+        })
+        .then(details => {
+          expect(Object.keys(details)).to.eql(['response', 'complete', 'username', 'targetName']);
+          expect(details.complete).to.be.true;
+          expect(details.username).to.equal('user@MOCK.LOCAL');
+          return client.step(details.response, { details: true });
+        })
+        .then(details => {
+          expect(details.complete).to.be.true;
+          expect(details.username).to.equal(client.username);
+        });
+    });
+  });
+
+  it('should accept challenges which are not flat strings', function() {
+    const challenge = Buffer.from([1, 0, 0x10, 0]).toString('base64');
+    return handshake('HTTP@localhost').then(contexts =>
+      contexts.client
+        .wrap(challenge, { user: 'user' })
+        // concatenating makes a cons string, which has no contiguous storage of its own
+        .then(wrapped => contexts.client.unwrap(wrapped.slice(0, 8) + wrapped.slice(8)))
+        .then(unwrapped => {
+          expect(Buffer.from(unwrapped, 'base64').slice(4).toString()).to.equal('user');
+        })
+    );
+  });
+
+  it('should reject an operation while another is running on the same client', function() {
+    const challenge = Buffer.from([1, 0, 0x10, 0]).toString('base64');
+    return handshake('HTTP@localhost').then(contexts => {
+      const client = contexts.client;
+      return Promise.all([
+        client.wrap(challenge, { user: 'first' }),
+        client.wrap(challenge, { user: 'second' }).then(
+          () => expect.fail('the second wrap should not start'),
+          err => err
+        )
+      ])
+        .then(results => {
+          expect(results[1].message).to.match(/operation in progress/);
+          return client.unwrap(results[0]);
+        })
+        .then(unwrapped => {
+          expect(Buffer.from(unwrapped, 'base64').slice(4).toString()).to.equal('first');
+        });
+    });
+  });
+
+  it('should not grow the arena in steady state', function() {
+    const challenge = Buffer.from([1, 0, 0x10, 0]).toString('base64');
+    const roundTrip = client =>
+      client.wrap(challenge, { user: 'user' }).then(wrapped => client.unwrap(wrapped));
+
+    return handshake('HTTP@localhost').then(contexts => {
+      const client = contexts.client;
+      return roundTrip(client).then(() => {
+        const before = kerberos.memoryUsage().arenaAllocations;
+        let chain = Promise.resolve();
+        for (let i = 0; i < 50; ++i) {
+          chain = chain.then(() => roundTrip(client));
+        }
+
+        return chain.then(() => {
+          expect(kerberos.memoryUsage().arenaAllocations).to.equal(before);
+        });
+      });
+    });
+  });
+
+  it('should unwrap with a callback and no options', function(done) {
+    const challenge = Buffer.from([1, 0, 0x10, 0]).toString('base64');
+    handshake('HTTP@localhost').then(contexts => {
+      contexts.client.wrap(challenge, { user: 'user' }, (err, wrapped) => {
+        if (err) return done(err);
+        contexts.client.unwrap(wrapped, (err, unwrapped) => {
+          if (err) return done(err);
+          expect(Buffer.from(unwrapped, 'base64').slice(4).toString()).to.equal('user');
+          done();
+        });
+      });
+    }, done);
+  });
+
+  it('should return MICs in slices of a shared slab, but nothing carrying plaintext', function() {
+    const challenge = Buffer.from([1, 0, 0x10, 0]).toString('base64');
+    return handshake('HTTP@localhost').then(contexts => {
+      const client = contexts.client;
+      let wrapped;
+      return client
+        .wrap(challenge, { user: 'user', binary: true })
+        .then(result => {
+          wrapped = result;
+          expect(Buffer.isBuffer(wrapped)).to.be.true;
+          // without confidentiality the token carries the plaintext
+          expect(wrapped.buffer.byteLength).to.equal(wrapped.length);
+          return client.wrap(challenge, { user: 'user' });
+        })
+        .then(encoded => {
+          expect(wrapped.toString('base64')).to.equal(encoded);
+          return client.unwrap(encoded, { binary: true });
+        })
+        .then(unwrapped => {
+          expect(unwrapped.slice(4).toString()).to.equal('user');
+          expect(unwrapped.buffer.byteLength).to.equal(unwrapped.length);
+          return client.getMics([Buffer.from('first'), Buffer.from('second')]);
+        })
+        .then(mics => {
+          expect(mics[0].buffer).to.equal(mics[1].buffer);
+        });
+    });
+  });
+
+  it('should make and verify MICs, one at a time or in batches', function() {
+    const messages = ['first', 'second', 'third'].map(message => Buffer.from(message));
+    return handshake('HTTP@localhost').then(contexts => {
+      const client = contexts.client;
+      let mic;
+      return client
+        .getMic(messages[0])
+        .then(result => {
+          mic = result;
+          expect(Buffer.isBuffer(mic)).to.be.true;
+          return client.verifyMic(messages[0], mic);
+        })
+        .then(valid => {
+          expect(valid).to.be.true;
+          return client.verifyMic(messages[1], mic);
+        })
+        .then(valid => {
+          expect(valid).to.be.false;
+          const calls = native._mockCalls();
+          return client.getMics(messages).then(mics => {
+            expect(native._mockCalls().wrap - calls.wrap).to.equal(messages.length);
+            expect(mics).to.have.length(messages.length);
+            return client.verifyMics(messages, [mics[0], mics[2], mics[2]]);
+          });
+        })
+        .then(results => {
+          expect(results).to.eql([true, false, true]);
+          return client.verifyMics(messages, []).then(
+            () => expect.fail('there is no MIC for each message'),
+            err => expect(err).to.be.an.instanceof(RangeError)
+          );
+        });
+    });
+  });
+
+  it('should not accept a replayed MIC', function() {
+    const message = Buffer.from('message');
+    return handshake('HTTP@localhost').then(contexts => {
+      const client = contexts.client;
+      return client.getMic(message).then(mic =>
+        client
+          .verifyMic(message, mic)
+          .then(valid => {
+            expect(valid).to.be.true;
+            return client.verifyMic(message, mic);
+          })
+          .then(valid => expect(valid).to.be.false)
+      );
+    });
+  });
+
+  it('should wrap and unwrap in place', function() {
+    return handshake('HTTP@localhost').then(contexts => {
+      const client = contexts.client;
+      return client.wrapOverhead(5).then(overhead => {
+        expect(overhead).to.eql({ header: 10, trailer: 0 });
+
+        const buffer = Buffer.alloc(32);
+        buffer.write('hello', 16);
+        return client
+          .wrapInto(buffer, 16, 5)
+          .then(token => {
+            expect(token.buffer).to.equal(buffer.buffer);
+            expect(token.byteOffset - buffer.byteOffset).to.equal(6);
+            expect(token.toString()).to.equal('mock-wrap1hello');
+            return client.unwrapInPlace(token);
+          })
+          .then(message => {
+            expect(message.toString()).to.equal('hello');
+            expect(message.byteOffset - buffer.byteOffset).to.equal(16);
+            expect(client.responseConf).to.equal(1);
+            return client.wrapInto(buffer, 4, 5);
+          })
+          .then(
+            () => expect.fail('there is no room for the header'),
+            err => expect(err.message).to.match(/no room/)
+          );
+      });
+    });
+  });
+
+  it('should negotiate the SASL security layer in one step', function() {
+    // `mock-wrap` with no confidentiality: no security layer, a 4096 byte maximum message size
+    const offer = Buffer.concat([Buffer.from('mock-wrap0'), Buffer.from([1, 0, 0x10, 0])]);
+    return handshake('HTTP@localhost').then(contexts => {
+      const calls = native._mockCalls();
+      return contexts.client.saslStep(offer.toString('base64'), { user: 'user' }).then(reply => {
+        const message = Buffer.from(reply, 'base64');
+        expect(message.slice(0, 10).toString()).to.equal('mock-wrap0');
+        expect(Array.from(message.slice(10, 14))).to.eql([1, 0, 0x10, 0]);
+        expect(message.slice(14).toString()).to.equal('user');
+
+        const after = native._mockCalls();
+        expect(after.unwrap - calls.unwrap).to.equal(1);
+        expect(after.wrap - calls.wrap).to.equal(1);
+      });
+    });
+  });
+
+  it('should authenticate a MongoAuthProcess', function(done) {
+    const auth = new MongoAuthProcess('localhost', 27017, 'mongodb');
+    // `mock-wrap` with no confidentiality: no security layer, a 4096 byte maximum message size
+    const offer = Buffer.concat([Buffer.from('mock-wrap0'), Buffer.from([1, 0, 0x10, 0])]);
+
+    auth.init('user', null, err => {
+      if (err) return done(err);
+      kerberos.initializeServer('mongodb@localhost', (err, server) => {
+        if (err) return done(err);
+        auth.transition('', (err, token) => {
+          if (err) return done(err);
+          server.step(token, err => {
+            if (err) return done(err);
+            auth.transition(server.response, err => {
+              if (err) return done(err);
+              auth.transition(offer.toString('base64'), (err, reply) => {
+                if (err) return done(err);
+                expect(Buffer.from(reply, 'base64').slice(14).toString()).to.equal('user');
+                auth.transition('', (err, complete) => {
+                  if (err) return done(err);
+                  expect(complete).to.be.true;
+                  done();
+                });
+              });
+            });
+          });
+        });
+      });
+    });
+  });
+
+  it('should only pass Buffers to the SASL security layer calls', function() {
+    return handshake('HTTP@localhost').then(contexts => {
+      const client = contexts.client;
+      expect(() => client._saslWrap('data', () => {})).to.throw(TypeError);
+      expect(() => client._saslUnwrap({ length: 4 }, () => {})).to.throw(TypeError);
+      expect(() => client._saslWrap(Buffer.from('data'))).to.throw(TypeError);
+    });
+  });
+
+  it('should reject unknown SASL security layers', function() {
+    return kerberos
+      .initializeClient('HTTP@localhost')
+      .then(client => client.saslStep('', { qop: 'auth-everything' }))
+      .then(
+        () => expect.fail('the step should fail'),
+        err => expect(err).to.be.an.instanceof(TypeError)
+      );
+  });
+
+  it('should carry data through a negotiated SASL security layer', function() {
+    // every layer offered, with a 64 byte buffer: 54 bytes of plaintext after the mock's header
+    const offer = Buffer.concat([Buffer.from('mock-wrap0'), Buffer.from([7, 0, 0, 64])]);
+    const sent = [];
+    const socket = new Duplex({
+      read() {},
+      write(chunk, encoding, callback) {
+        sent.push(chunk);
+        callback();
+      }
+    });
+
+    return handshake('HTTP@localhost').then(contexts => {
+      const options = { user: 'user', qop: 'auth-conf', maxBufferSize: 1024 };
+      return contexts.client.saslStep(offer.toString('base64'), options).then(reply => {
+        const message = Buffer.from(reply, 'base64');
+        expect(Array.from(message.slice(10, 14))).to.eql([4, 0, 4, 0]);
+
+        const layer = new kerberos.SaslSecurityLayer(contexts.client, socket, options);
+        const data = Buffer.alloc(100, 'x');
+        return new Promise(resolve => layer.write(data, resolve))
+          .then(() => {
+            const frames = Buffer.concat(sent);
+            expect(frames.readUInt32BE(0)).to.equal(64);
+            expect(frames.slice(4, 14).toString()).to.equal('mock-wrap1');
+            expect(frames.readUInt32BE(68)).to.equal(56);
+            expect(frames.length).to.equal(68 + 60);
+
+            // the server's frames arrive split at an arbitrary point
+            const received = new Promise(resolve => {
+              const chunks = [];
+              layer.on('data', chunk => {
+                chunks.push(chunk);
+                if (Buffer.concat(chunks).length === data.length) resolve(Buffer.concat(chunks));
+              });
+            });
+
+            socket.push(frames.slice(0, 30));
+            socket.push(frames.slice(30));
+            return received;
+          })
+          .then(plaintext => {
+            expect(plaintext.equals(data)).to.be.true;
+            layer.destroy();
+          });
+      });
+    });
+  });
+
+  it('should delay calls by the configured latency', function() {
+    configureMock({ calls: { acceptSecContext: { latency: 50 } } });
+    const start = Date.now();
+    return handshake('HTTP@localhost').then(() => {
+      expect(Date.now() - start).to.be.at.least(45);
+    });
+  });
+
+  it('should inject retryable failures', function() {
+    configureMock({ calls: { initSecContext: { errorRate: 1 } } });
+    return handshake('HTTP@localhost').then(
+      () => expect.fail('handshake should fail'),
+      err => expect(err).to.have.property('retryable', true)
+    );
+  });
+
+  it('should repeat the same sequence for the same seed', function() {
+    const options = { seed: 42, calls: { initSecContext: { errorRate: 0.5 } } };
+    configureMock(options);
+    return stepOutcomes(20).then(first => {
+      expect(first).to.include(true).and.to.include(false);
+      configureMock(options);
+      return stepOutcomes(20).then(second => expect(second).to.eql(first));
+    });
+  });
+
+  it('should only accept the configured password', function() {
+    const service = 'HTTP/localhost@MOCK.LOCAL';
+    configureMock({ password: 'secret' });
+    return kerberos.checkPassword('user', 'secret', service, 'MOCK.LOCAL').then(() =>
+      kerberos.checkPassword('user', 'wrong', service, 'MOCK.LOCAL').then(
+        () => expect.fail('checkPassword should fail'),
+        err => expect(err).to.be.an('error')
+      )
+    );
+  });
+
+  it('should list the configured keytab', function() {
+    configureMock({ keytab: ['HTTP/localhost@MOCK.LOCAL'] });
+    return kerberos
+      .principalDetails('HTTP', 'localhost')
+      .then(details => expect(details).to.equal('HTTP/localhost@MOCK.LOCAL'));
+  });
+
+  it('should count calls since it was configured', function() {
+    configureMock({});
+    return handshake('HTTP@localhost').then(() => {
+      const calls = native._mockCalls();
+      expect(calls.initSecContext).to.equal(1);
+      expect(calls.acceptSecContext).to.equal(1);
+      expect(calls.getInitCredsPassword).to.equal(0);
+    });
+  });
+
+  it('should reject unknown distributions', function() {
+    expect(() => configureMock({ calls: { wrap: { distribution: 'pareto' } } })).to.throw(
+      TypeError
+    );
+  });
+});
@@ -0,0 +1,62 @@
+'use strict';
+const kerberos = require('bindings')('kerberos');
+const defineOperation = require('../lib/util').defineOperation;
+const api = require('..');
+const expect = require('chai').expect;
+
+const testMethod = defineOperation(kerberos._testMethod, [
+  { name: 'string', type: 'string' },
+  { name: 'shouldError', type: 'boolean', default: false },
+  { name: 'callback', type: 'function', required: false }
+]);
+
+describe('stats', function() {
+  beforeEach(() => api.resetStats());
+
+  it('should record queue, cpu and wall time for worker operations', function() {
+    return Promise.all([testMethod('a'), testMethod('b'), testMethod('c')]).then(() => {
+      const stats = api.stats().operations['kerberos:TestMethod'];
+      expect(stats).to.exist;
+      ['queue', 'cpu', 'wall', 'completion'].forEach(phase => {
+        expect(stats[phase].count).to.equal(3);
+        expect(stats[phase].p50).to.be.at.most(stats[phase].p99);
+        expect(stats[phase].p99).to.be.at.most(stats[phase].p999);
+      });
+    });
+  });
+
+  it('should clear statistics on reset', function() {
+    return testMethod('a').then(() => {
+      api.resetStats();
+      expect(api.stats().operations).to.not.have.property('kerberos:TestMethod');
+      expect(api.stats().threadpool.dispatched).to.equal(0);
+    });
+  });
+
+  it('should track threadpool occupancy', function() {
+    const pending = [testMethod('a'), testMethod('b'), testMethod('c')];
+    const threadpool = api.stats().threadpool;
+    expect(threadpool.size).to.be.at.least(1);
+    expect(threadpool.dispatched).to.equal(3);
+    expect(threadpool.queued + threadpool.executing + threadpool.completing).to.equal(3);
+    expect(threadpool.maxQueued).to.be.at.least(1);
+
+    return Promise.all(pending).then(() => {
+      const threadpool = api.stats().threadpool;
+      expect(threadpool.completed).to.equal(3);
+      expect(threadpool.queued + threadpool.executing + threadpool.completing).to.equal(0);
+    });
+  });
+
+  it('should format statistics for prometheus', function() {
+    return testMethod('a').then(() => {
+      const text = api.stats({ format: 'prometheus' });
+      expect(text).to.contain('# TYPE kerberos_operation_duration_seconds summary');
+      expect(text).to.contain(
+        'kerberos_operation_duration_seconds_count{operation="kerberos:TestMethod",phase="wall"} 1'
+      );
+      expect(text).to.contain('# TYPE kerberos_threadpool_queued gauge');
+      expect(text).to.contain('kerberos_threadpool_completed_total 1');
+    });
+  });
+});
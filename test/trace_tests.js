@@ -0,0 +1,43 @@
+'use strict';
+const kerberos = require('bindings')('kerberos');
+const defineOperation = require('../lib/util').defineOperation;
+const api = require('..');
+const expect = require('chai').expect;
+
+const testMethod = defineOperation(kerberos._testMethod, [
+  { name: 'string', type: 'string' },
+  { name: 'shouldError', type: 'boolean', default: false },
+  { name: 'callback', type: 'function', required: false }
+]);
+
+describe('trace capture', function() {
+  beforeEach(() => api.setTraceEnabled(true));
+  afterEach(() => api.setTraceEnabled(false));
+
+  it('should tag captured lines with their operation', function() {
+    return Promise.all([testMethod('first'), testMethod('second')]).then(() => {
+      const lines = api.dumpTrace().filter(line => line.operation === 'kerberos:TestMethod');
+      expect(lines.map(line => line.message)).to.have.members(['first', 'second']);
+      expect(lines[0].operationId).to.not.equal(lines[1].operationId);
+
+      const trace = api.dumpTrace(lines[0].operationId);
+      expect(trace).to.have.length(1);
+      expect(trace[0].message).to.equal(lines[0].message);
+      expect(trace[0].elapsed).to.equal(0);
+    });
+  });
+
+  it('should discard captured lines when disabled', function() {
+    return testMethod('discarded').then(() => {
+      api.setTraceEnabled(false);
+      expect(api.dumpTrace()).to.be.empty;
+    });
+  });
+
+  it('should not capture while disabled', function() {
+    api.setTraceEnabled(false);
+    return testMethod('ignored').then(() => {
+      expect(api.dumpTrace()).to.be.empty;
+    });
+  });
+});